@@ -0,0 +1,82 @@
+/*
+ * AttackCache.cpp - The start of the most used samples, kept in RAM.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "AttackCache.h"
+#include "WavFile.h"
+#include <string.h>
+
+#ifdef ATTACK_CACHE_ENABLE
+
+static uint32_t           s_data[ATTACK_CACHE_BYTES / sizeof(uint32_t)];
+static unsigned           s_used;
+static AttackCache::Entry s_entry[ATTACK_CACHE_ENTRIES];
+static unsigned           s_nEntries;
+
+bool AttackCache::load(const TCHAR *filename, unsigned bytes)
+{
+	if(find(filename))
+		return true;
+	if(s_nEntries >= ATTACK_CACHE_ENTRIES)
+		return false;
+
+	WavFile wav;
+	if(!wav.open(filename))
+		return false;
+
+	unsigned align = wav.getGranule();
+
+	if(bytes == 0)
+		bytes = ATTACK_CACHE_SAMPLE_BYTES;
+	if(bytes > wav.getByteSize())
+		bytes = wav.getByteSize();
+	if(bytes > getFree())
+		bytes = getFree();
+	bytes -= bytes % align; // Whole samples (or ADPCM groups) only.
+	if(bytes == 0)
+		return false;
+
+	uint8_t *data = (uint8_t *)s_data + s_used;
+	if(wav.readBlock(data, bytes) != bytes)
+		return false;
+
+	Entry &e = s_entry[s_nEntries++];
+	e.filename   = filename;
+	e.data       = data;
+	e.bytes      = bytes;
+	e.dataSize   = wav.getByteSize();
+	e.format     = wav.getFormat();
+	e.blockAlign = wav.getBlockAlign();
+	e.channels   = wav.getChannels();
+	e.sampleRate = wav.getSampleRate();
+	e.whole      = (bytes == wav.getByteSize());
+
+	// Keep each one word aligned for the copy out.
+	s_used += (bytes + 3) & ~3;
+	return true;
+}
+
+const AttackCache::Entry *AttackCache::find(const TCHAR *filename)
+{
+	for(unsigned i = 0; i < s_nEntries; i++) {
+		if(s_entry[i].filename == filename || 0 == strcmp(s_entry[i].filename, filename))
+			return &s_entry[i];
+	}
+	return 0;
+}
+
+void AttackCache::clear()
+{
+	s_nEntries = 0;
+	s_used     = 0;
+}
+
+unsigned AttackCache::getFree()
+{
+	return ATTACK_CACHE_BYTES - s_used;
+}
+
+#endif // ATTACK_CACHE_ENABLE
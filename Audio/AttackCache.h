@@ -0,0 +1,62 @@
+/*
+ * AttackCache.h - The start of the most used samples, kept in RAM.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_ATTACKCACHE_H_
+#define AUDIO_ATTACKCACHE_H_
+
+#include "board.h"
+#include "Filesystem.h"
+
+// Opening a file, finding its data and getting the first sectors through
+// the StreamScheduler takes several milliseconds, which you can hear on a
+// drum hit. So the first part of each sample named with load() is kept in
+// RAM. When the VoiceManager triggers one of them the voice starts playing
+// from here straight away and the file is opened while that plays, carrying
+// on from where the cached part ends.
+//
+// Load everything at startup, before the audio is running. There is no way
+// to unload a single sample, only clear() the lot.
+//
+// Only built in when ATTACK_CACHE_ENABLE is defined in board.h. Without it
+// nothing is ever cached and find() always returns 0.
+class AttackCache
+{
+public:
+	struct Entry
+	{
+		const TCHAR   *filename;
+		const uint8_t *data;
+		unsigned       bytes;
+		unsigned       dataSize;   // Of the whole sample, and its format, so it
+		unsigned       sampleRate; // can be decoded before the file is open.
+		uint16_t       format;
+		uint16_t       blockAlign;
+		uint8_t        channels;
+		bool           whole;      // The whole sample is here, no need for the file.
+	};
+
+#ifdef ATTACK_CACHE_ENABLE
+	// Cache the first bytes of sample data (ATTACK_CACHE_SAMPLE_BYTES if 0).
+	// The filename isn't copied, it must stay around. Returns false if the
+	// file can't be read or the cache is full.
+	static bool load(const TCHAR *filename, unsigned bytes = 0);
+
+	static const Entry *find(const TCHAR *filename);
+
+	static void     clear();
+	static unsigned getFree();
+#else
+	static bool load(const TCHAR *filename, unsigned bytes = 0) { return false; }
+
+	static const Entry *find(const TCHAR *filename) { return 0; }
+
+	static void     clear() { }
+	static unsigned getFree() { return 0; }
+#endif
+};
+
+#endif /* AUDIO_ATTACKCACHE_H_ */
@@ -10,12 +10,39 @@
 #include "AudioKinetisI2S.h"
 #include "board.h"
 #include "SystemIntegration.h"
+#include "Trace.h"
 #include "fsl_flexio.h"
 
 // I divide the Core clock of 48MHz by 34 (FlexIO only does even-numbered divisors) giving
 // an I2S bit-clock of 1.412MHz. This works out to a sample rate of 44117Hz which is close
 // enough to 44100Hz.
 
+// setSampleRate() can change that divider. With 32 bits a frame the rate is
+// 48MHz / (64 x divider), 750kHz / divider, so these are the nearest to the
+// usual WAV rates:
+//
+//   WAV rate   divider   I2S rate   error
+//    8000        94       7978.7   -0.27%   -4.6 cents
+//   11025        68      11029.4   +0.04%   +0.7 cents
+//   16000        47      15957.4   -0.27%   -4.6 cents
+//   22050        34      22058.8   +0.04%   +0.7 cents
+//   24000        31      24193.5   +0.81%  +13.9 cents
+//   32000        23      32608.7   +1.90%  +32.6 cents
+//   44100        17      44117.6   +0.04%   +0.7 cents
+//   48000        16      46875.0   -2.34%  -41.1 cents
+//
+// The 11.025kHz family is as good as it gets but 32k and 48k can't be done
+// in tune, there's no divider (or standard number of bits a frame) which
+// goes into 48MHz the right number of times. WavSource resamples whatever
+// is left over, so leave those at the default rate. isInTune() says which
+// are worth switching to.
+#define I2S_FLEXIO_CLOCK    48000000
+#define I2S_FRAME_BITS      32
+#define I2S_DEFAULT_DIVIDER 17
+#define I2S_WAIT_LOOPS      16384 // Two words at the slowest rate, and then some.
+
+unsigned AudioKinetisI2S::s_sampleRate = AudioSource::kSampleRate;
+
 // According to AN4955, I2S master mode can be supported using two timers, two shifters, and four pins.
 // I want to use the DMA to shovel data to I2S
 // Since CPU clock is 48MHz, maybe it makes sense to have a 48kHz sample rate.
@@ -36,6 +63,7 @@ AudioKinetisI2S::AudioKinetisI2S()
 	: _dataSource(0)
 	, _dma(FLEXIO_DMA_CHANNEL, Dma::muxFlexIOch0)
 	, _currentBuf(_buf1)
+	, _newDivider(0)
 {
 	// Enable FLEXIO peripheral.
 	SystemIntegration::enableClock(SystemIntegration::kCLOCK_Flexio0);
@@ -87,9 +115,6 @@ AudioKinetisI2S::AudioKinetisI2S()
 			| FLEXIO_TIMCTL_PINPOL(kFLEXIO_PinActiveLow)
 			| FLEXIO_TIMCTL_TIMOD(kFLEXIO_TimerModeSingle16Bit);
 
-    // Clock divider set to 16-bit. Value is 545 to give a divide-by-1088.
-	FLEXIO->TIMCMP[I2S_WS_TMR_INDEX] = 545;
-
 	// Set up 1.412MHz clock on first timer (48MHz / 34).
 	FLEXIO->TIMCFG[I2S_CLK_TMR_INDEX] = FLEXIO_TIMCFG_TIMOUT(kFLEXIO_TimerOutputOneNotAffectedByReset)
 			| FLEXIO_TIMCFG_TIMDEC(kFLEXIO_TimerDecSrcOnFlexIOClockShiftTimerOutput)
@@ -109,14 +134,18 @@ AudioKinetisI2S::AudioKinetisI2S()
 			| FLEXIO_TIMCTL_PINPOL(kFLEXIO_PinActiveLow)
 			| FLEXIO_TIMCTL_TIMOD(kFLEXIO_TimerModeDual8BitBaudBit);
 
-	// Clock divider is 34 (0x10) and number of data bits is 32 (16 per channel) (0x3F).
-	FLEXIO->TIMCMP[I2S_CLK_TMR_INDEX] = 0x3F10;
+	// Clock divider is 34 and number of data bits is 32 (16 per channel).
+	// Frame sync toggles every half frame, 1088 / 2.
+	setDivider(I2S_DEFAULT_DIVIDER);
 
 	// TODO: Use DMA to shovel data from a buffer.
 	// TODO: Mechanism to append data to buffer and release used data (circular buffer?).
 
 	g_audio = this;
 
+	// Keep the audio interrupt below the profiler's.
+	NVIC_SetPriority(FLEXIO_DMA_IRQN, AUDIO_IRQ_PRIORITY);
+
 	// Activate!
 	FLEXIO->CTRL |= FLEXIO_CTRL_FLEXEN_MASK | FLEXIO_CTRL_DBGE_MASK;
 }
@@ -135,6 +164,63 @@ void AudioKinetisI2S::setDataSource(AudioSource *src)
 	dmaStart();
 }
 
+// Compare values for both timers. The bit clock timer's low byte is half a
+// bit less one and its high byte the clock edges in a word less one. The
+// frame sync timer toggles every half frame and the shifter resets it at
+// the start of every word.
+void AudioKinetisI2S::setDivider(unsigned divider)
+{
+	FLEXIO->TIMCMP[I2S_WS_TMR_INDEX]  = FLEXIO_TIMCMP_CMP(I2S_FRAME_BITS * divider + 1);
+	FLEXIO->TIMCMP[I2S_CLK_TMR_INDEX] = FLEXIO_TIMCMP_CMP(((I2S_FRAME_BITS * 2 - 1) << 8) | (divider - 1));
+}
+
+// The nearest divider to a sample rate.
+static unsigned dividerFor(unsigned rate)
+{
+	unsigned divider = rate ? (I2S_FLEXIO_CLOCK / (I2S_FRAME_BITS * 2) + rate / 2) / rate : I2S_DEFAULT_DIVIDER;
+	if(divider < 2)
+		divider = 2;
+	else if(divider > 256)
+		divider = 256;
+	return divider;
+}
+
+bool AudioKinetisI2S::isInTune(unsigned rate)
+{
+	unsigned actual = I2S_FLEXIO_CLOCK / (I2S_FRAME_BITS * 2) / dividerFor(rate);
+	unsigned error  = actual > rate ? actual - rate : rate - actual;
+	return rate != 0 && error * 1000 <= rate;
+}
+
+unsigned AudioKinetisI2S::setSampleRate(unsigned rate)
+{
+	unsigned divider = dividerFor(rate);
+
+	s_sampleRate = I2S_FLEXIO_CLOCK / (I2S_FRAME_BITS * 2) / divider;
+
+	if(_dataSource)
+		_newDivider = divider; // irq() does it between frames.
+	else
+		setDivider(divider);   // Nothing playing.
+	return s_sampleRate;
+}
+
+// When the DMA has finished the last word of the frame is still waiting in
+// the shifter buffer. Wait for it to go into the shifter and then out of it
+// (the bit clock timer stops at the end of every word), so the new clocks
+// start on a word boundary and the DAC never sees a word of the wrong
+// length. Gives up rather than hang if FlexIO has stopped.
+static void waitForLastWord()
+{
+	unsigned timeout = I2S_WAIT_LOOPS;
+	while(!(FLEXIO->SHIFTSTAT & (1 << I2S_SHIFTER_INDEX)) && --timeout)
+		;
+
+	FLEXIO->TIMSTAT = 1 << I2S_CLK_TMR_INDEX;
+	while(!(FLEXIO->TIMSTAT & (1 << I2S_CLK_TMR_INDEX)) && --timeout)
+		;
+}
+
 // Start a new DMA transfer.
 void AudioKinetisI2S::dmaStart()
 {
@@ -166,12 +252,29 @@ void AudioKinetisI2S::dmaStart()
 // Called when DMA transfer is complete. Loads the next buffer and starts a new DMA transfer.
 void AudioKinetisI2S::irq()
 {
+	Trace::event(kTraceAudioIrqStart);
+
 	// Clear the interrupt flag.
 	//FLEXIO_DMA->DMA[FLEXIO_DMA_CHANNEL].DSR_BCR |= DMA_DSR_BCR_DONE_MASK;
 
+	// Change the rate between frames, with FlexIO stopped so both timers
+	// start again together.
+	unsigned divider = _newDivider;
+	if(divider) {
+		_newDivider = 0;
+		waitForLastWord();
+		FLEXIO->CTRL &= ~FLEXIO_CTRL_FLEXEN_MASK;
+		setDivider(divider);
+	}
+
 	// Hopefully the buffer is full, send it.
 	_dma.startTransfer(_currentBuf, (void *)&FLEXIO->SHIFTBUFBIS[I2S_SHIFTER_INDEX], sizeof(_buf1), AUDIO_DMA_FLAGS);
 
+	if(divider) {
+		FLEXIO->CTRL |= FLEXIO_CTRL_FLEXEN_MASK;
+		Trace::event(kTraceSampleRate, s_sampleRate);
+	}
+
 	// Swap buffers.
 	if(_currentBuf == _buf1)
 		_currentBuf = _buf2;
@@ -181,6 +284,8 @@ void AudioKinetisI2S::irq()
 	// Start processing the next frame.
 	_dataSource->fillBuffer(_currentBuf);
 
+	Trace::event(kTraceAudioIrqEnd);
+
 	//unsigned xferSize;
 	//uint32_t *data = (uint32_t *)_dataSource->getBuffer(&xferSize);
 	//if(data == 0)
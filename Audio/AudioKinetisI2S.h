@@ -23,16 +23,33 @@ public:
 
 	void setDataSource(AudioSource *src);
 
+	// Run the output at the nearest rate to this that the clock allows (see
+	// the table in AudioKinetisI2S.cpp) and return it. The change happens
+	// between two frames. Everything playing changes pitch with it, and
+	// WavSources opened afterwards resample to the new rate.
+	unsigned setSampleRate(unsigned rate);
+
+	// Whether setSampleRate() gets within 0.1% (under 2 cents) of the rate,
+	// so something that can't resample can be played at it in tune. Only
+	// the 11.025kHz family are.
+	static bool isInTune(unsigned rate);
+
+	static unsigned getSampleRate() { return s_sampleRate; }
+
 	void irq();
 
 private:
-	AudioSource *_dataSource;
-	Dma          _dma;
-	AUDIOSAMPLE *_currentBuf;
-	AUDIOSAMPLE  _buf1[AudioSource::kFrameSize];
-	AUDIOSAMPLE  _buf2[AudioSource::kFrameSize];
+	AudioSource       *_dataSource;
+	Dma                _dma;
+	AUDIOSAMPLE       *_currentBuf;
+	AUDIOSAMPLE        _buf1[AudioSource::kFrameSize];
+	AUDIOSAMPLE        _buf2[AudioSource::kFrameSize];
+	volatile uint16_t  _newDivider; // For the next frame, 0 for no change.
+
+	static unsigned s_sampleRate;
 
 	void dmaStart();
+	void setDivider(unsigned divider);
 };
 
 #endif // AUDIOKINETISI2S_H_
@@ -16,14 +16,21 @@ class AudioSource
 {
 public:
 	enum {
-		kFrameSize = 256,                               // Frame size in number of samples.
+		kFrameSize = 128,                               // Frame size in number of samples, 2.9ms.
 		kFrameBytes = kFrameSize * sizeof(AUDIOSAMPLE), // Number of bytes in a frame.
+		kSampleRate = 44117,                            // Default output rate in Hz, see AudioKinetisI2S.cpp.
 	};
 
 	AudioSource() { }
 	virtual ~AudioSource() { }
 
 	virtual void fillBuffer(AUDIOSAMPLE *buffer) = 0;
+
+	// False when the source would only produce silence, so a Mixer can
+	// skip it without calling fillBuffer(). Something that plays through
+	// time (a file, a sample) has to keep its place while it's turned down,
+	// so it stays active for as long as it's playing.
+	virtual bool isActive() const { return true; }
 };
 
 #endif // AUDIOSOURCE_H_
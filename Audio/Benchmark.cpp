@@ -0,0 +1,586 @@
+/*
+ * Benchmark.cpp - Cycle counts for the audio processing code.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "Benchmark.h"
+
+#ifdef BENCHMARK_ENABLE
+
+#ifndef TRACE_ENABLE
+#error BENCHMARK_ENABLE reports its results through the trace, define TRACE_ENABLE too.
+#endif
+
+#include "AudioSource.h"
+#include "Effects.h"
+#include "FilterSource.h"
+#include "FmSource.h"
+#include "GainStage.h"
+#include "GranularSource.h"
+#include "ImaAdpcm.h"
+#include "RiceLossless.h"
+#include "Mixer.h"
+#include "OscillatorBank.h"
+#include "PluckSource.h"
+#include "Resampler.h"
+#include "SystemTick.h"
+#include "Trace.h"
+#include <new>
+#include <string.h>
+
+#define BENCHMARK_RUNS 4
+
+// The granular and pluck sources are too big for the stack under main()'s
+// frame (the granular window alone is 2k), so they take turns in here.
+// Only costs static RAM in a BENCHMARK_ENABLE build.
+static union
+{
+	uint32_t align;
+	uint8_t  granular[sizeof(GranularSource)];
+	uint8_t  pluck[sizeof(PluckSource)];
+} s_voice;
+
+static void nothing(void *)
+{
+}
+
+// Interrupts are off while timing so nothing else gets counted. Take the
+// best of a few runs and knock off the cost of calling an empty function.
+uint32_t Benchmark::measure(Function f, void *context)
+{
+	uint32_t best = 0xFFFFFFFF;
+	uint32_t overhead = 0xFFFFFFFF;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for(unsigned i = 0; i < BENCHMARK_RUNS; i++) {
+		uint32_t t = SystemTick::getCycles();
+		nothing(context);
+		t = SystemTick::getCycles() - t;
+		if(t < overhead)
+			overhead = t;
+
+		t = SystemTick::getCycles();
+		f(context);
+		t = SystemTick::getCycles() - t;
+		if(t < best)
+			best = t;
+	}
+
+	__set_PRIMASK(primask);
+
+	return best > overhead ? best - overhead : 0;
+}
+
+void Benchmark::report(BenchmarkId id, uint32_t cycles)
+{
+	Trace::event(kTraceBenchmark, id);
+	Trace::event(kTraceBenchCycles, cycles);
+}
+
+// Fill a frame with something which looks a bit like audio.
+static void makeTestFrame(AUDIOSAMPLE *buffer)
+{
+	uint32_t x = 0x12345678;
+	for(unsigned i = 0; i < AudioSource::kFrameSize; i++) {
+		x = x * 1664525 + 1013904223;
+		buffer[i] = x;
+	}
+}
+
+static void gainDivide(void *context)
+{
+	int16_t *samp = (int16_t *)context;
+	for(unsigned i = 0; i < AudioSource::kFrameSize * 2; i++)
+		samp[i] = samp[i] / 4;
+}
+
+struct GainTest
+{
+	GainStage    gain;
+	AUDIOSAMPLE *buffer;
+};
+
+static void gainProcess(void *context)
+{
+	GainTest *t = (GainTest *)context;
+	t->gain.process(t->buffer, AudioSource::kFrameSize);
+}
+
+static void gainRamp(void *context)
+{
+	GainTest *t = (GainTest *)context;
+	t->gain.jumpTo(GainStage::kUnity, GainStage::kUnity);
+	t->gain.setGain(0x1000, 0x3000);
+	t->gain.process(t->buffer, AudioSource::kFrameSize);
+}
+
+struct MixerTest
+{
+	Mixer        mixer;
+	AUDIOSAMPLE *buffer;
+};
+
+static void mixerFill(void *context)
+{
+	MixerTest *t = (MixerTest *)context;
+	t->mixer.fillBuffer(t->buffer);
+}
+
+template<class Decoder>
+struct DecodeTest
+{
+	Decoder        decoder;
+	const uint8_t *in;
+	AUDIOSAMPLE   *out;
+};
+
+// Decode a frame from the start of a block, feeding the decoder as
+// WavSource does.
+template<class Decoder>
+static void decodeFrame(void *context)
+{
+	DecodeTest<Decoder> *t = (DecodeTest<Decoder> *)context;
+	const uint8_t *in = t->in;
+	AUDIOSAMPLE *out = t->out;
+	unsigned left = AudioSource::kFrameSize;
+
+	t->decoder.reset();
+	while(left) {
+		unsigned n = t->decoder.drain(out, left);
+		out  += n;
+		left -= n;
+		if(left) {
+			t->decoder.decode(in);
+			in += t->decoder.getInputSize();
+		}
+	}
+}
+
+struct BitPacker
+{
+	uint8_t *out;
+	uint32_t acc;
+	unsigned bits;
+
+	void put(uint32_t value, unsigned n)
+	{
+		while(n--) {
+			acc = (acc << 1) | ((value >> n) & 1);
+			if(++bits == 8) {
+				*out++ = acc;
+				bits = 0;
+			}
+		}
+	}
+};
+
+// A block of Rice codes like a quiet sample would give, order 2 stereo with
+// k = 4 and errors of up to 6 bits. See RiceLossless.h for the format.
+static void makeRiceBlock(uint8_t *out, unsigned bytes)
+{
+	for(unsigned i = 0; i < bytes; i++)
+		out[i] = 0;
+
+	BitPacker p = { out, 0, 0 };
+	p.put(AudioSource::kFrameSize, 16); // Frames.
+	p.put(1, 1);                        // Left and side.
+	p.put(2, 2);                        // Order and k of each channel.
+	p.put(4, 5);
+	p.put(2, 2);
+	p.put(4, 5);
+
+	uint32_t x = 0x12345678;
+	for(unsigned i = 0; i < AudioSource::kFrameSize; i++) {
+		for(unsigned c = 0; c < 2; c++) {
+			if(i < 2) {
+				p.put(0, 16 + c); // The first two are stored as they are.
+				continue;
+			}
+			x = x * 1664525 + 1013904223;
+			unsigned u = x >> 26;
+			p.put((1 << (u >> 4)) - 1, u >> 4); // Unary, then the low 4 bits.
+			p.put(0, 1);
+			p.put(u & 0xF, 4);
+		}
+	}
+	p.put(0, 7); // Out with the last byte.
+}
+
+struct ResampleTest
+{
+	Resampler          resampler;
+	const AUDIOSAMPLE *in;
+	AUDIOSAMPLE       *out;
+};
+
+// A frame of output the way WavSource::decodeResampled() makes it, with
+// the input copied round and round the test frame in place of decoding.
+static void resampleFrame(void *context)
+{
+	ResampleTest *t = (ResampleTest *)context;
+	unsigned done = 0;
+	unsigned pos = 0;
+
+	t->resampler.startFrame();
+	while(done < AudioSource::kFrameSize) {
+		unsigned want = AudioSource::kFrameSize - done;
+		unsigned most = t->resampler.getMaxOutput();
+		if(want > most)
+			want = most;
+
+		unsigned need = t->resampler.getInputNeeded(want);
+		AUDIOSAMPLE *in = t->resampler.getInput();
+		for(unsigned i = 0; i < need; i++)
+			in[i] = t->in[(pos++) & (AudioSource::kFrameSize - 1)];
+
+		done += t->resampler.process(&t->out[done], want, need);
+	}
+}
+
+// Voices vs CPU. The same source, one sine oscillator, is added as every
+// voice, which costs just the same as that many different ones.
+static void __attribute__((noinline)) benchMixer(AUDIOSAMPLE *buffer)
+{
+	static const BenchmarkId ids[] = { kBenchMixer1, kBenchMixer2, kBenchMixer4, kBenchMixer8 };
+
+	OscillatorBank sine;
+	MixerTest      mix;
+	sine.start(0, 440 << 16);
+	mix.buffer = buffer;
+
+	unsigned nVoices = 0;
+	for(unsigned i = 0; i < sizeof(ids) / sizeof(ids[0]) && nVoices < Mixer::kMaxVoices; i++) {
+		unsigned want = 1 << i;
+		while(nVoices < want && nVoices < Mixer::kMaxVoices) {
+			mix.mixer.addVoice(&sine, GainStage::kUnity / 2, Mixer::kPanCentre + nVoices);
+			nVoices++;
+		}
+		Benchmark::report(ids[i], Benchmark::measure(mixerFill, &mix));
+	}
+}
+
+// Any bytes are valid ADPCM, so the test frame will do as the input. The
+// decoders take a second frame buffer for the output, which is why these
+// have their own stack frame like benchMixer().
+static void __attribute__((noinline)) benchAdpcm(const AUDIOSAMPLE *input)
+{
+	AUDIOSAMPLE output[AudioSource::kFrameSize];
+
+	DecodeTest<ImaAdpcmDecoder> t;
+	t.decoder.init(2, AudioSource::kFrameBytes, AudioSource::kFrameBytes);
+	t.in  = (const uint8_t *)input;
+	t.out = output;
+	Benchmark::report(kBenchAdpcm, Benchmark::measure(decodeFrame<ImaAdpcmDecoder>, &t));
+}
+
+static void __attribute__((noinline)) benchRice(AUDIOSAMPLE *input)
+{
+	AUDIOSAMPLE output[AudioSource::kFrameSize];
+
+	DecodeTest<RiceDecoder> t;
+	makeRiceBlock((uint8_t *)input, AudioSource::kFrameBytes);
+	t.decoder.init(2, AudioSource::kFrameBytes, AudioSource::kFrameBytes);
+	t.in  = (const uint8_t *)input;
+	t.out = output;
+	Benchmark::report(kBenchRice, Benchmark::measure(decodeFrame<RiceDecoder>, &t));
+}
+
+// Cost per voice for each rate which needs converting. 44.1kHz plays as it
+// is so costs nothing.
+static void __attribute__((noinline)) benchResample(const AUDIOSAMPLE *input)
+{
+	static const BenchmarkId ids[]   = { kBenchResample48k, kBenchResample32k, kBenchResample22k };
+	static const uint16_t    rates[] = { 48000, 32000, 22050 };
+
+	AUDIOSAMPLE output[AudioSource::kFrameSize];
+
+	ResampleTest t;
+	t.in  = input;
+	t.out = output;
+	for(unsigned i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		t.resampler.init(rates[i], AudioSource::kSampleRate);
+		Benchmark::report(ids[i], Benchmark::measure(resampleFrame, &t));
+	}
+}
+
+// Cost per voice of each kind of interpolation for varispeed, from 44.1kHz
+// at half as fast again. Faster than that uses more input per frame but
+// the same sums per output.
+static void __attribute__((noinline)) benchVarispeed(const AUDIOSAMPLE *input)
+{
+	static const BenchmarkId ids[] = { kBenchVarispeedFir, kBenchVarispeedLinear, kBenchVarispeedHermite };
+	static const Resampler::Interpolation kinds[] = { Resampler::kPolyphase, Resampler::kLinear, Resampler::kHermite };
+
+	AUDIOSAMPLE output[AudioSource::kFrameSize];
+
+	ResampleTest t;
+	t.in  = input;
+	t.out = output;
+	t.resampler.setSpeed(Resampler::kUnitySpeed * 3 / 2);
+	for(unsigned i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		t.resampler.init(44100, AudioSource::kSampleRate);
+		t.resampler.setInterpolation(kinds[i]);
+		Benchmark::report(ids[i], Benchmark::measure(resampleFrame, &t));
+	}
+
+	// Audio rate, a triangle from normal speed to twice as fast and back
+	// over the frame.
+	static uint32_t speeds[AudioSource::kFrameSize];
+	for(unsigned i = 0; i < AudioSource::kFrameSize; i++) {
+		unsigned up = i < AudioSource::kFrameSize / 2 ? i : AudioSource::kFrameSize - i;
+		speeds[i] = Resampler::kUnitySpeed + up * (2 * Resampler::kUnitySpeed / AudioSource::kFrameSize);
+	}
+	t.resampler.init(44100, AudioSource::kSampleRate);
+	t.resampler.setSpeedInput(speeds);
+	Benchmark::report(kBenchVarispeedInput, Benchmark::measure(resampleFrame, &t));
+}
+
+struct GranularTest
+{
+	GranularSource *granular;
+	AUDIOSAMPLE    *buffer;
+};
+
+static void granularFill(void *context)
+{
+	GranularTest *t = (GranularTest *)context;
+	t->granular->fillBuffer(t->buffer);
+}
+
+// Grains vs CPU. They start so close together that the limit is always
+// reached, and are as long as the window allows, so nearly all of them play
+// all through the frame. The window is the test frame.
+static void __attribute__((noinline)) benchGranular(AUDIOSAMPLE *buffer)
+{
+	static const BenchmarkId ids[] = { kBenchGranular1, kBenchGranular2, kBenchGranular4, kBenchGranular8 };
+
+	GranularSource &granular = *new(s_voice.granular) GranularSource;
+	granular.setWindow((const int16_t *)buffer, AudioSource::kFrameSize * 2);
+	granular.setDensity(4000);
+	granular.setLength(GranularSource::kWindowFrames);
+	granular.setPitch(GranularSource::kUnitySpeed * 3 / 2);
+	granular.play();
+
+	GranularTest t = { &granular, buffer };
+	for(unsigned i = 0; i < sizeof(ids) / sizeof(ids[0]) && (1u << i) <= GranularSource::kMaxGrains; i++) {
+		granular.setMaxGrains(1 << i);
+		for(unsigned j = 0; j < 4; j++)
+			granular.fillBuffer(buffer); // Get them all going.
+		Benchmark::report(ids[i], Benchmark::measure(granularFill, &t));
+	}
+	granular.~GranularSource();
+}
+
+struct FilterTest
+{
+	FilterSource filter;
+	AUDIOSAMPLE *buffer;
+	unsigned     sweep; // Cutoff steps to move by each time, 0 to stay put.
+	unsigned     cutoff;
+};
+
+static void filterProcess(void *context)
+{
+	FilterTest *t = (FilterTest *)context;
+	if(t->sweep) {
+		t->cutoff = (t->cutoff + t->sweep) % FilterSource::kCutoffSteps;
+		t->filter.setCutoff(t->cutoff);
+	}
+	t->filter.process(t->buffer, AudioSource::kFrameSize);
+}
+
+// Each structure at a fixed setting, then being swept so the coefficients
+// are worked out and glide every frame. The type makes no difference to the
+// biquad and hardly any to the state variable filter.
+static void __attribute__((noinline)) benchFilter(AUDIOSAMPLE *buffer)
+{
+	static const BenchmarkId ids[] = { kBenchFilterBiquad, kBenchFilterBiquadSweep, kBenchFilterSvf, kBenchFilterSvfSweep };
+
+	FilterTest t;
+	t.buffer = buffer;
+	t.cutoff = 60;
+	for(unsigned i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		t.filter.setType(FilterSource::kLowPass, i < 2 ? FilterSource::kBiquad : FilterSource::kStateVariable);
+		t.filter.setUpdate(FilterSource::kPerSample);
+		t.filter.setCutoff(t.cutoff);
+		t.filter.process(buffer, AudioSource::kFrameSize); // Settle on the new filter.
+		t.sweep = i & 1 ? 7 : 0;
+		Benchmark::report(ids[i], Benchmark::measure(filterProcess, &t));
+	}
+}
+
+// Plays the test frame, so each way of chaining effects starts the same.
+class FrameSource
+	: public AudioSource
+{
+public:
+	const AUDIOSAMPLE *frame;
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer) { memcpy(buffer, frame, kFrameBytes); }
+};
+
+// Any AudioSource, a frame at a time.
+struct SourceTest
+{
+	AudioSource *source;
+	AUDIOSAMPLE *buffer;
+};
+
+static void sourceFill(void *context)
+{
+	SourceTest *t = (SourceTest *)context;
+	t->source->fillBuffer(t->buffer);
+}
+
+// The same four effects put together three ways: fused into one loop at
+// compile time, as a list decided at run time, and as AudioSources each
+// filtering the one before like FilterSource does.
+static void __attribute__((noinline)) benchChain(AUDIOSAMPLE *buffer)
+{
+	AUDIOSAMPLE input[AudioSource::kFrameSize];
+	memcpy(input, buffer, sizeof(input));
+
+	FrameSource frame;
+	frame.frame = input;
+
+	SourceTest t;
+	t.buffer = buffer;
+
+	EffectSource<EffectChain<GainEffect, DcBlockEffect, DriveEffect, WidthEffect> > fused(&frame);
+	fused.chain.stage<0>().setGain(GainStage::kUnity / 2);
+	fused.chain.stage<2>().setDrive(2 * DriveEffect::kUnity);
+	t.source = &fused;
+	Benchmark::report(kBenchChainFused, Benchmark::measure(sourceFill, &t));
+
+	VirtualEffect<EffectChain<GainEffect> >    gain;
+	VirtualEffect<EffectChain<DcBlockEffect> > dcBlock;
+	VirtualEffect<EffectChain<DriveEffect> >   drive;
+	VirtualEffect<EffectChain<WidthEffect> >   width;
+	gain.chain.stage<0>().setGain(GainStage::kUnity / 2);
+	drive.chain.stage<0>().setDrive(2 * DriveEffect::kUnity);
+
+	EffectSource<EffectList> list(&frame);
+	list.chain.add(&gain);
+	list.chain.add(&dcBlock);
+	list.chain.add(&drive);
+	list.chain.add(&width);
+	t.source = &list;
+	Benchmark::report(kBenchChainList, Benchmark::measure(sourceFill, &t));
+
+	EffectSource<EffectChain<GainEffect> >    gainSource(&frame);
+	EffectSource<EffectChain<DcBlockEffect> > dcBlockSource(&gainSource);
+	EffectSource<EffectChain<DriveEffect> >   driveSource(&dcBlockSource);
+	EffectSource<EffectChain<WidthEffect> >   widthSource(&driveSource);
+	gainSource.chain.stage<0>().setGain(GainStage::kUnity / 2);
+	driveSource.chain.stage<0>().setDrive(2 * DriveEffect::kUnity);
+	t.source = &widthSource;
+	Benchmark::report(kBenchChainSources, Benchmark::measure(sourceFill, &t));
+}
+
+struct OscillatorTest
+{
+	OscillatorBank bank;
+	AUDIOSAMPLE   *buffer;
+};
+
+static void oscillatorFill(void *context)
+{
+	OscillatorTest *t = (OscillatorTest *)context;
+	t->bank.fillBuffer(t->buffer);
+}
+
+// Oscillators vs CPU. The bank's own cost is timed with nothing playing,
+// then each waveform with every oscillator playing it, less that, shared
+// out. They cost the same at any frequency so there's no point in trying
+// more than one.
+static void __attribute__((noinline)) benchOscillators(AUDIOSAMPLE *buffer)
+{
+	static const BenchmarkId ids[] = { kBenchOscSine, kBenchOscSaw, kBenchOscSquare };
+	static const OscillatorBank::Waveform waves[] = { OscillatorBank::kSine, OscillatorBank::kSaw, OscillatorBank::kSquare };
+
+	OscillatorTest t;
+	t.buffer = buffer;
+	uint32_t bank = Benchmark::measure(oscillatorFill, &t);
+	Benchmark::report(kBenchOscBank, bank);
+
+	for(unsigned i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		for(unsigned j = 0; j < OscillatorBank::kMaxOscillators; j++)
+			t.bank.start(j, (220 + 110 * j) << 16, waves[i], GainStage::kUnity / OscillatorBank::kMaxOscillators);
+		uint32_t all = Benchmark::measure(oscillatorFill, &t);
+		Benchmark::report(ids[i], all > bank ? (all - bank) / OscillatorBank::kMaxOscillators : 0);
+	}
+}
+
+// One of each synth voice, playing. They cost the same whatever the note so
+// "fit" is how many could play at once. Take off a WAV voice's decode,
+// resample and Mixer times from above to see how many fit alongside one.
+static void __attribute__((noinline)) benchSynth(AUDIOSAMPLE *buffer)
+{
+	SourceTest t;
+	t.buffer = buffer;
+
+	PluckSource &pluck = *new(s_voice.pluck) PluckSource;
+	pluck.pluck(110 << 16);
+	pluck.fillBuffer(buffer); // Fill the string first.
+	t.source = &pluck;
+	Benchmark::report(kBenchPluck, Benchmark::measure(sourceFill, &t));
+	pluck.~PluckSource();
+
+	FmSource fm;
+	fm.setRatio(FmSource::kUnityRatio * 7 / 2);
+	fm.setIndex(4 * FmSource::kIndexOne);
+	fm.noteOn(440 << 16);
+	t.source = &fm;
+	Benchmark::report(kBenchFm, Benchmark::measure(sourceFill, &t));
+}
+
+void Benchmark::run()
+{
+	AUDIOSAMPLE buffer[AudioSource::kFrameSize];
+
+	makeTestFrame(buffer);
+	report(kBenchGainDivide, measure(gainDivide, buffer));
+
+	GainTest gain;
+	gain.buffer = buffer;
+
+	makeTestFrame(buffer);
+	gain.gain.jumpTo(0x2000, 0x2000);
+	report(kBenchGainConstant, measure(gainProcess, &gain));
+
+	makeTestFrame(buffer);
+	gain.gain.jumpTo(0xC000, 0xC000);
+	report(kBenchGainBoost, measure(gainProcess, &gain));
+
+	makeTestFrame(buffer);
+	report(kBenchGainRamp, measure(gainRamp, &gain));
+
+	benchMixer(buffer);
+
+	makeTestFrame(buffer);
+	benchAdpcm(buffer);
+	benchRice(buffer);
+
+	makeTestFrame(buffer);
+	benchResample(buffer);
+	benchVarispeed(buffer);
+
+	makeTestFrame(buffer);
+	benchGranular(buffer);
+	makeTestFrame(buffer);
+	benchFilter(buffer);
+	makeTestFrame(buffer);
+	benchChain(buffer);
+	benchOscillators(buffer);
+	benchSynth(buffer);
+
+	// All done, the trace has the results.
+	while(1)
+		;
+}
+
+#endif // BENCHMARK_ENABLE
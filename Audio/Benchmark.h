@@ -0,0 +1,120 @@
+/*
+ * Benchmark.h - Cycle counts for the audio processing code.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_BENCHMARK_H_
+#define AUDIO_BENCHMARK_H_
+
+#include "board.h"
+#include <stdint.h>
+
+// Times each piece of audio code on one frame with the core cycle counter
+// and sends the results out as trace events (a kTraceBenchmark with the
+// benchmark ID then a kTraceBenchCycles with the count). Run it at the start
+// of main() before the audio starts, then look at the summary from
+// tools/trace_decode.py which gives each one as a percentage of the frame
+// period. When it's built in, run() doesn't return, so the compiler leaves
+// out everything main() would have done after it. The player and the
+// benchmarks don't both fit in flash.
+//
+// Only built in when BENCHMARK_ENABLE is defined in board.h, it needs
+// TRACE_ENABLE as well.
+//
+// tools/trace_decode.py reads the names from this enum so keep one per line.
+enum BenchmarkId
+{
+	kBenchGainDivide = 1,   // Old WavSource volume loop, divide every sample by 4.
+	kBenchGainConstant = 2, // GainStage at a fixed gain below unity.
+	kBenchGainBoost = 3,    // GainStage at a fixed gain above unity (saturating).
+	kBenchGainRamp = 4,     // GainStage ramping to a new gain.
+	kBenchMixer1 = 5,       // Mixer with 1 OscillatorBank voice.
+	kBenchMixer2 = 6,       // Mixer with 2 OscillatorBank voices.
+	kBenchMixer4 = 7,       // Mixer with 4 OscillatorBank voices.
+	kBenchMixer8 = 8,       // Mixer with 8 OscillatorBank voices.
+	kBenchAdpcm = 9,        // ImaAdpcmDecoder, one frame of stereo.
+	kBenchRice = 10,        // RiceDecoder, one frame of stereo.
+	kBenchResample48k = 11, // Resampler, one frame of output from 48kHz.
+	kBenchResample32k = 12, // Resampler, one frame of output from 32kHz.
+	kBenchResample22k = 13, // Resampler, one frame of output from 22.05kHz.
+	kBenchVarispeedFir = 14,     // Resampler at 1.5x speed, the FIR.
+	kBenchVarispeedLinear = 15,  // Resampler at 1.5x speed, linear interpolation.
+	kBenchVarispeedHermite = 16, // Resampler at 1.5x speed, 4-point Hermite.
+	kBenchGranular1 = 17,        // GranularSource with 1 grain playing all through the frame.
+	kBenchGranular2 = 18,        // GranularSource with 2 grains.
+	kBenchGranular4 = 19,        // GranularSource with 4 grains.
+	kBenchGranular8 = 20,        // GranularSource with 8 grains.
+	kBenchFilterBiquad = 21,     // FilterSource biquad low pass, one frame of stereo.
+	kBenchFilterBiquadSweep = 22, // The same with the cutoff moving, gliding every sample.
+	kBenchFilterSvf = 23,        // FilterSource state variable low pass.
+	kBenchFilterSvfSweep = 24,   // The same with the cutoff moving, gliding every sample.
+	kBenchChainFused = 25,       // Gain, DC block, drive and width as one EffectChain.
+	kBenchChainList = 26,        // The same four as VirtualEffects in an EffectList.
+	kBenchChainSources = 27,     // The same four as a chain of EffectSources, one stage each.
+	kBenchOscBank = 28,          // OscillatorBank with nothing playing, the cost of the bank itself.
+	kBenchOscSine = 29,          // Each sine oscillator in an OscillatorBank, "fit" is how many a frame has time for.
+	kBenchOscSaw = 30,           // Each band-limited saw oscillator.
+	kBenchOscSquare = 31,        // Each band-limited square oscillator.
+	kBenchPluck = 32,            // One PluckSource string ringing, "fit" is how many a frame has time for.
+	kBenchFm = 33,               // One FmSource voice playing.
+	kBenchVarispeedInput = 34,   // Resampler Hermite with a speed for every output (setSpeedInput()), 1x to 2x.
+};
+
+class Benchmark
+{
+public:
+	typedef void (*Function)(void *context);
+
+#ifdef BENCHMARK_ENABLE
+	static void     run() __attribute__((noreturn));
+	static uint32_t measure(Function f, void *context); // Fewest cycles of a few runs.
+	static void     report(BenchmarkId id, uint32_t cycles);
+#else
+	static void run() { }
+#endif
+};
+
+// Figures so far. Nothing here has run on a board yet, these are from a
+// Cortex-M0+ instruction set simulator running a clang -Os build, with no
+// flash wait states and 50 cycles for a divide. memcpy() and memset() are
+// byte loops in it, so anything clearing or copying frames comes out slow.
+// Treat them as a guide and replace them with the trace_decode.py summary
+// from the board. Cycles per frame, share of the 139266 cycle frame at
+// 48MHz, and fit.
+//
+// Sample rate conversion (Resampler), per voice:
+//   kBenchResample48k       26927   19.3%  fit 5
+//   kBenchResample32k       26413   19.0%  fit 5
+//   kBenchResample22k       26105   18.7%  fit 5
+//
+// Varispeed at 1.5x, per voice:
+//   kBenchVarispeedFir      29451   21.1%  fit 4
+//   kBenchVarispeedLinear   14085   10.1%  fit 9
+//   kBenchVarispeedHermite  25882   18.6%  fit 5
+//   kBenchVarispeedInput    31401   22.5%  fit 4
+//
+// GranularSource, with every grain playing all through the frame:
+//   kBenchGranular1         10996    7.9%  fit 12
+//   kBenchGranular2         17038   12.2%  fit 8
+//   kBenchGranular4         25252   18.1%  fit 5
+//   kBenchGranular8         41576   29.9%  fit 3
+//
+// OscillatorBank, the bank on its own and then each oscillator:
+//   kBenchOscBank            5189    3.7%
+//   kBenchOscSine            4129    3.0%  fit 33
+//   kBenchOscSaw             4136    3.0%  fit 33
+//   kBenchOscSquare          6311    4.5%  fit 22
+//
+// Synth voices, one playing:
+//   kBenchPluck              7847    5.6%  fit 17
+//   kBenchFm                10031    7.2%  fit 13
+//
+// SD streaming (StreamScheduler) has no figure, the simulator has no card.
+// A host model of the card commands had one 16-bit stereo stream doing
+// 262 single and 260 multi-sector reads in 390 frames. The card's real
+// throughput and how many voices it keeps fed want the "SD reads" line
+// from trace_decode.py on a board.
+
+#endif /* AUDIO_BENCHMARK_H_ */
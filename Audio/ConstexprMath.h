@@ -0,0 +1,80 @@
+/*
+ * ConstexprMath.h - Maths the compiler can do, for building tables.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_CONSTEXPRMATH_H_
+#define AUDIO_CONSTEXPRMATH_H_
+
+#include <stdint.h>
+
+// Enough floating point to work out filter coefficients and wave tables at
+// compile time, so they go in flash already done and no floating point code
+// gets linked in. The standard library ones aren't constexpr. Not for use
+// at run time, they're slow.
+struct ConstexprMath
+{
+	static constexpr double kPi = 3.14159265358979323846;
+
+	static constexpr double abs(double x) { return x < 0 ? -x : x; }
+
+	// Taylor series, after bringing x into -pi to pi.
+	static constexpr double sin(double x)
+	{
+		x -= 2 * kPi * (int32_t)(x / (2 * kPi));
+		if(x > kPi)
+			x -= 2 * kPi;
+		else if(x < -kPi)
+			x += 2 * kPi;
+
+		double term = x;
+		double sum  = x;
+		for(unsigned n = 3; n < 30; n += 2) {
+			term *= -x * x / ((n - 1) * n);
+			sum  += term;
+		}
+		return sum;
+	}
+
+	static constexpr double cos(double x) { return sin(x + kPi / 2); }
+
+	// sin(pi x) / (pi x), the ideal low pass filter.
+	static constexpr double sinc(double x) { return abs(x) < 1e-9 ? 1 : sin(kPi * x) / (kPi * x); }
+
+	// 2^x, as a whole power of two times a Taylor series for the rest.
+	static constexpr double exp2(double x)
+	{
+		double whole = 1;
+		while(x >= 1) {
+			whole *= 2;
+			x -= 1;
+		}
+		while(x < 0) {
+			whole /= 2;
+			x += 1;
+		}
+
+		double term = 1;
+		double sum  = 1;
+		for(unsigned n = 1; n < 20; n++) {
+			term *= x * 0.69314718055994530942 / n;
+			sum  += term;
+		}
+		return whole * sum;
+	}
+
+	// Newton's method, for x >= 0.
+	static constexpr double sqrt(double x)
+	{
+		double r = x > 1 ? x : 1;
+		for(unsigned n = 0; n < 40; n++)
+			r = (r + x / r) / 2;
+		return r;
+	}
+
+	static constexpr int32_t round(double x) { return x < 0 ? (int32_t)(x - 0.5) : (int32_t)(x + 0.5); }
+};
+
+#endif /* AUDIO_CONSTEXPRMATH_H_ */
@@ -0,0 +1,191 @@
+/*
+ * EffectChain.h - Effects put together at compile time, run in one loop.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_EFFECTCHAIN_H_
+#define AUDIO_EFFECTCHAIN_H_
+
+#include "AudioSource.h"
+
+// An effect stage (see Effects.h) works on one stereo sample at a time, as
+// two ints so it doesn't unpack and repack them, and has something to do at
+// the start of each frame:
+//
+//	void begin(unsigned count);                  // Pick up new settings.
+//	void process(int32_t &left, int32_t &right); // One sample, 16-bit in and out.
+//
+// EffectChain<A, B, C> runs a sample through A, then B, then C. process()
+// inlines all of them into one loop over the frame, so the whole chain
+// unpacks and packs each sample once and keeps it in registers in between,
+// with no virtual calls and no more buffers. The stages are members, get at
+// them with stage<N>().
+//
+// When the order has to be decided at run time, put each stage (or any
+// chain) in a VirtualEffect and add them to an EffectList. That costs a
+// virtual call and a pass over the frame for each, like a chain of
+// AudioSources, but no more buffers either. EffectSource puts either on the
+// end of an AudioSource.
+template<class... Stages>
+class EffectChain;
+
+// Finds the type of stage kIndex of a chain, and gets it.
+template<unsigned kIndex, class Chain>
+struct EffectChainStage;
+
+template<>
+class EffectChain<>
+{
+public:
+	void begin(unsigned) { }
+	void process(int32_t &, int32_t &) { }
+};
+
+template<class First, class... Rest>
+class EffectChain<First, Rest...>
+{
+public:
+	template<unsigned kIndex>
+	typename EffectChainStage<kIndex, EffectChain>::Type &stage()
+	{
+		return EffectChainStage<kIndex, EffectChain>::get(*this);
+	}
+
+	void begin(unsigned count)
+	{
+		_first.begin(count);
+		_rest.begin(count);
+	}
+
+	inline __attribute__((always_inline)) void process(int32_t &left, int32_t &right)
+	{
+		_first.process(left, right);
+		_rest.process(left, right);
+	}
+
+	void process(AUDIOSAMPLE *buffer, unsigned count)
+	{
+		begin(count);
+		for(unsigned i = 0; i < count; i++) {
+			uint32_t s = buffer[i];
+			int32_t  l = (int16_t)s;
+			int32_t  r = (int32_t)s >> 16;
+			process(l, r);
+			buffer[i] = ((uint32_t)r << 16) | ((uint32_t)l & 0xFFFF);
+		}
+	}
+
+private:
+	First                _first;
+	EffectChain<Rest...> _rest;
+
+	template<unsigned kIndex, class Chain> friend struct EffectChainStage;
+};
+
+template<class First, class... Rest>
+struct EffectChainStage<0, EffectChain<First, Rest...> >
+{
+	typedef First Type;
+	static Type &get(EffectChain<First, Rest...> &chain) { return chain._first; }
+};
+
+template<unsigned kIndex, class First, class... Rest>
+struct EffectChainStage<kIndex, EffectChain<First, Rest...> >
+{
+	typedef EffectChainStage<kIndex - 1, EffectChain<Rest...> > Next;
+	typedef typename Next::Type Type;
+	static Type &get(EffectChain<First, Rest...> &chain) { return Next::get(chain._rest); }
+};
+
+// The run time version, one pass over the buffer each.
+class Effect
+{
+public:
+	virtual ~Effect() { }
+	virtual void process(AUDIOSAMPLE *buffer, unsigned count) = 0;
+};
+
+template<class Chain>
+class VirtualEffect
+	: public Effect
+{
+public:
+	Chain chain;
+
+	virtual void process(AUDIOSAMPLE *buffer, unsigned count) { chain.process(buffer, count); }
+};
+
+// Runs its effects in the order they were added. Add and remove them from
+// the main loop only while it isn't being processed, or with interrupts off.
+class EffectList
+{
+public:
+	enum {
+		kMaxEffects = 8
+	};
+
+	EffectList() : _count(0) { }
+
+	bool add(Effect *effect)
+	{
+		if(_count >= kMaxEffects)
+			return false;
+		_effects[_count++] = effect;
+		return true;
+	}
+
+	void remove(Effect *effect)
+	{
+		for(unsigned i = 0; i < _count; i++) {
+			if(_effects[i] == effect) {
+				for(_count--; i < _count; i++)
+					_effects[i] = _effects[i + 1];
+				return;
+			}
+		}
+	}
+
+	void process(AUDIOSAMPLE *buffer, unsigned count)
+	{
+		for(unsigned i = 0; i < _count; i++)
+			_effects[i]->process(buffer, count);
+	}
+
+private:
+	Effect  *_effects[kMaxEffects];
+	unsigned _count;
+};
+
+// An AudioSource with effects on the end, either an EffectChain or an
+// EffectList. Silence in if there's no source.
+template<class Chain>
+class EffectSource
+	: public AudioSource
+{
+public:
+	Chain chain;
+
+	EffectSource(AudioSource *source = 0) : _source(source) { }
+
+	void setSource(AudioSource *source) { _source = source; }
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer)
+	{
+		if(_source) {
+			_source->fillBuffer(buffer);
+		} else {
+			for(unsigned i = 0; i < kFrameSize; i++)
+				buffer[i] = 0;
+		}
+		chain.process(buffer, kFrameSize);
+	}
+
+	virtual bool isActive() const { return _source && _source->isActive(); }
+
+private:
+	AudioSource *_source;
+};
+
+#endif /* AUDIO_EFFECTCHAIN_H_ */
@@ -0,0 +1,141 @@
+/*
+ * Effects.h - Effect stages for EffectChain.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_EFFECTS_H_
+#define AUDIO_EFFECTS_H_
+
+#include "EffectChain.h"
+#include "GainStage.h"
+
+// Each of these is a stage for an EffectChain (see EffectChain.h), so it
+// all goes in the header where the chain can inline it. The settings can be
+// changed from the main loop at any time, they're picked up by begin() at
+// the start of the next frame.
+
+// Volume in GainStage units, gliding to a new setting over a frame. It's
+// the same in both channels. Saturates over unity.
+class GainEffect
+{
+public:
+	GainEffect(unsigned gain = GainStage::kUnity) : _target(gain), _next(gain), _gain(gain << 8), _step(0) { }
+
+	void setGain(unsigned gain) { _target = gain < GainStage::kMaxGain ? gain : GainStage::kMaxGain; }
+
+	// Starts where the last glide should have got to, so rounding the step
+	// down doesn't leave it short.
+	void begin(unsigned count)
+	{
+		_gain = _next << 8;
+		_next = _target;
+		_step = count ? (int32_t)((_next << 8) - _gain) / (int32_t)count : 0;
+	}
+
+	void process(int32_t &left, int32_t &right)
+	{
+		int32_t gain = _gain >> 8;
+		left   = saturate16((left * gain) >> 15);
+		right  = saturate16((right * gain) >> 15);
+		_gain += _step;
+	}
+
+private:
+	volatile uint32_t _target;
+	uint32_t          _next;
+	int32_t           _gain; // Q8 above the GainStage units, for a smooth glide.
+	int32_t           _step;
+};
+
+// Takes off DC, with a one pole high pass at about 55Hz (1 - 2^-7 for the
+// pole). No multiplies. The output is kept with 8 more bits so it settles
+// right down to 0.
+class DcBlockEffect
+{
+public:
+	DcBlockEffect() : _xl(0), _xr(0), _yl(0), _yr(0) { }
+
+	void begin(unsigned) { }
+
+	void process(int32_t &left, int32_t &right)
+	{
+		_yl += (left - _xl) * 256 - (_yl >> 7);
+		_yr += (right - _xr) * 256 - (_yr >> 7);
+		_xl = left;
+		_xr = right;
+		left  = saturate16(_yl >> 8);
+		right = saturate16(_yr >> 8);
+	}
+
+private:
+	int32_t _xl, _xr;
+	int32_t _yl, _yr;
+};
+
+// Overdrive: a gain (Q12) then the cubic 1.5x - 0.5x^3, which rounds off
+// smoothly into full scale instead of clipping. The gain is taken down by
+// 2/3 to make up for the cubic's, so at kUnity quiet signals come through
+// as they were and only the peaks get rounded off.
+class DriveEffect
+{
+public:
+	enum {
+		kUnity    = 0x1000,
+		kMaxDrive = 16 * kUnity
+	};
+
+	DriveEffect() : _drive(kUnity), _now(kUnity) { }
+
+	void setDrive(unsigned drive) { _drive = drive < kMaxDrive ? drive : kMaxDrive; }
+
+	void begin(unsigned) { _now = (_drive * 2731) >> 12; }
+
+	void process(int32_t &left, int32_t &right)
+	{
+		left  = shape(saturate16((left * _now) >> 12));
+		right = shape(saturate16((right * _now) >> 12));
+	}
+
+private:
+	volatile int32_t _drive;
+	int32_t          _now;
+
+	static int32_t shape(int32_t x)
+	{
+		int32_t cube = (((x * x) >> 15) * x) >> 15;
+		return saturate16((3 * x - cube) >> 1);
+	}
+};
+
+// Stereo width through mid and side. Q14: 0 is mono, kNormal leaves it as
+// it is and 2 * kNormal doubles the side.
+class WidthEffect
+{
+public:
+	enum {
+		kNormal   = 0x4000,
+		kMaxWidth = 2 * kNormal
+	};
+
+	WidthEffect() : _width(kNormal), _now(kNormal) { }
+
+	void setWidth(unsigned width) { _width = width < kMaxWidth ? width : kMaxWidth; }
+
+	void begin(unsigned) { _now = _width; }
+
+	void process(int32_t &left, int32_t &right)
+	{
+		int32_t mid  = left + right; // Both twice over, so kNormal is exact.
+		int32_t side = ((left - right) * _now) >> 14;
+		left  = saturate16((mid + side) >> 1);
+		right = saturate16((mid - side) >> 1);
+	}
+
+private:
+	volatile int32_t _width;
+	int32_t          _now;
+};
+
+#endif /* AUDIO_EFFECTS_H_ */
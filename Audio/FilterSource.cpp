@@ -0,0 +1,287 @@
+/*
+ * FilterSource.cpp - Resonant filters for another audio source.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "FilterSource.h"
+#include "ConstexprMath.h"
+#include "GainStage.h"
+#include "board.h"
+#include <string.h>
+
+#define BIQUAD_BITS 13 // Fraction bits of the biquad's sums, Q29 coefficients times 16-bit samples >> 16.
+#define SVF_BITS    10 // Fraction bits of the state variable filter's state.
+
+// How close the state variable filter gets to going unstable, which is when
+// f * f + 2 * f * q reaches 4.
+#define SVF_MARGIN 0.9
+
+// Everything the coefficients are made from, by cutoff and resonance step.
+struct FilterTables
+{
+	int32_t  cosine[FilterSource::kCutoffSteps];     // cos(w0), Q30.
+	int32_t  sine[FilterSource::kCutoffSteps];       // sin(w0), Q30.
+	uint16_t svf[FilterSource::kCutoffSteps];        // 2 sin(w0 / 2), Q15.
+	uint16_t damping[FilterSource::kResonanceSteps]; // 1 / Q, Q15.
+	uint16_t svfMax[FilterSource::kResonanceSteps];  // Highest stable svf[] at that damping.
+
+	constexpr FilterTables()
+		: cosine()
+		, sine()
+		, svf()
+		, damping()
+		, svfMax()
+	{
+		for(unsigned c = 0; c < FilterSource::kCutoffSteps; c++) {
+			double w0 = 2 * ConstexprMath::kPi * 20 * ConstexprMath::exp2(c / 12.0) / AudioSource::kSampleRate;
+			cosine[c] = ConstexprMath::round(ConstexprMath::cos(w0) * (1 << 30));
+			sine[c]   = ConstexprMath::round(ConstexprMath::sin(w0) * (1 << 30));
+			svf[c]    = ConstexprMath::round(2 * ConstexprMath::sin(w0 / 2) * 32768);
+		}
+		for(unsigned r = 0; r < FilterSource::kResonanceSteps; r++) {
+			double q = 2 / ConstexprMath::exp2(r / 4.0);
+			damping[r] = q < 2 ? ConstexprMath::round(q * 32768) : 0xFFFF;
+			svfMax[r]  = ConstexprMath::round(SVF_MARGIN * (ConstexprMath::sqrt(q * q + 4) - q) * 32768);
+		}
+	}
+};
+
+static constexpr FilterTables s_tables;
+
+static inline uint32_t pack(int32_t left, int32_t right)
+{
+	return ((uint32_t)right << 16) | ((uint32_t)left & 0xFFFF);
+}
+
+// x * c as two 16x16 multiplies, which the M0 does in a cycle each: the
+// high half of c times x, and the low half (which is unsigned, so the
+// product still fits in 32 bits) times x >> 3. Five of the low ones can be
+// added up without overflowing, and only rounded once at the end.
+static inline int32_t mulHigh(int32_t x, int32_t c) { return x * (c >> 16); }
+static inline int32_t mulLow(int32_t x, int32_t c)  { return (x * (int32_t)(c & 0xFFFF)) >> 3; }
+
+// s * c >> 15 for c up to 0xFFFF and s up to 2^28, the same way.
+static inline int32_t mulQ15(int32_t s, int32_t c)
+{
+	return (s >> 16) * (c << 1) + (int32_t)((((uint32_t)s & 0xFFFF) * (uint32_t)c) >> 15);
+}
+
+// Robert Bristow-Johnson's cookbook filters. They all have the same poles
+// and these work the zeros out from them, so each one needs just the one
+// divide.
+static void designBiquad(int32_t *coef, unsigned type, unsigned cutoff, unsigned resonance)
+{
+	int64_t cosw  = s_tables.cosine[cutoff];
+	int64_t alpha = (s_tables.sine[cutoff] * (int64_t)s_tables.damping[resonance]) >> 16; // sin(w0) / 2Q, Q30.
+	int64_t k     = ((int64_t)1 << 60) / ((1 << 30) + alpha);                                // 1 / a0, Q30.
+
+	// The products are rounded, a low cutoff's b0 is only a thousand or so.
+	const int64_t kHalf30 = (int64_t)1 << 29;
+	const int64_t kHalf31 = (int64_t)1 << 30;
+	const int64_t kHalf32 = (int64_t)1 << 31;
+
+	int32_t b0, b1, b2;
+	switch(type) {
+	case FilterSource::kLowPass:
+		b0 = b2 = (((1 << 30) - cosw) * k + kHalf32) >> 32;
+		b1 = 2 * b0;
+		break;
+	case FilterSource::kHighPass:
+		b0 = b2 = (((1 << 30) + cosw) * k + kHalf32) >> 32;
+		b1 = -2 * b0;
+		break;
+	case FilterSource::kBandPass:
+		b0 = (alpha * k + kHalf31) >> 31;
+		b1 = 0;
+		b2 = -b0;
+		break;
+	default:
+		b0 = b2 = k >> 1;
+		b1 = -((cosw * k + kHalf30) >> 30);
+		break;
+	}
+
+	coef[0] = b0;
+	coef[1] = b1;
+	coef[2] = b2;
+	coef[3] = (cosw * k + kHalf30) >> 30;                    // -a1 = 2 cos(w0) / a0
+	coef[4] = -((((1 << 30) - alpha) * k + kHalf31) >> 31);  // -a2 = -(1 - alpha) / a0
+}
+
+static void designStateVariable(int32_t *coef, unsigned cutoff, unsigned resonance)
+{
+	unsigned f = s_tables.svf[cutoff];
+	if(f > s_tables.svfMax[resonance])
+		f = s_tables.svfMax[resonance];
+
+	coef[0] = f;
+	coef[1] = s_tables.damping[resonance];
+	coef[2] = coef[3] = coef[4] = 0;
+}
+
+// What rounding each output loses is put back into the next two, as k e1 -
+// e2 where k is -a1 rounded to a whole number (second order error
+// feedback). That nearly cancels the poles for the rounding, which matters
+// at the ends where they'd otherwise turn it into hundreds of LSBs.
+// Everything is rounded to nearest rather than down. At the bottom the
+// poles have a gain of 100000 at DC, so even the 1/16384 of an LSB that
+// rounding the low halves down loses each sample came out as an offset of
+// several LSBs.
+static inline int32_t biquad(int32_t x, int32_t *s, const int32_t *c)
+{
+	int32_t low = mulLow(x, c[0]) + mulLow(s[0], c[1]) + mulLow(s[1], c[2])
+	            + mulLow(s[2], c[3]) + mulLow(s[3], c[4]);
+	int32_t acc = mulHigh(x, c[0]) + mulHigh(s[0], c[1]) + mulHigh(s[1], c[2])
+	            + mulHigh(s[2], c[3]) + mulHigh(s[3], c[4]) + ((low + (1 << 12)) >> 13)
+	            + ((c[3] + (1 << 28)) >> 29) * s[4] - s[5] + (1 << (BIQUAD_BITS - 1));
+	int32_t y = saturate16(acc >> BIQUAD_BITS);
+	s[5] = s[4];
+	s[4] = (acc & ((1 << BIQUAD_BITS) - 1)) - (1 << (BIQUAD_BITS - 1));
+	s[1] = s[0];
+	s[0] = x;
+	s[3] = s[2];
+	s[2] = y;
+	return y;
+}
+
+// Chamberlin's, low then high then band. Band is scaled by the damping to
+// peak at 0dB like the biquad's, and notch is low plus high.
+template<unsigned kType>
+static inline int32_t stateVariable(int32_t x, int32_t *s, const int32_t *c)
+{
+	int32_t lp = s[0] + mulQ15(s[1], c[0]);
+	int32_t hp = x * (1 << SVF_BITS) - lp - mulQ15(s[1], c[1]);
+	int32_t bp = s[1] + mulQ15(hp, c[0]);
+	s[0] = lp;
+	s[1] = bp;
+
+	int32_t y;
+	if(kType == FilterSource::kLowPass)
+		y = lp;
+	else if(kType == FilterSource::kHighPass)
+		y = hp;
+	else if(kType == FilterSource::kBandPass)
+		y = mulQ15(bp, c[1]);
+	else
+		y = lp + hp;
+	return saturate16((y + (1 << (SVF_BITS - 1))) >> SVF_BITS);
+}
+
+// Each coefficient steps by step[] after every sample when kRamp is set.
+template<int32_t (*kFilter)(int32_t, int32_t *, const int32_t *), unsigned kRamped, bool kRamp>
+static void runFrame(AUDIOSAMPLE *buffer, unsigned count, int32_t *coef, const int32_t *step,
+                     int32_t *left, int32_t *right)
+{
+	for(unsigned i = 0; i < count; i++) {
+		uint32_t s = buffer[i];
+		int32_t  l = kFilter((int16_t)s, left, coef);
+		int32_t  r = kFilter((int32_t)s >> 16, right, coef);
+		buffer[i] = pack(l, r);
+
+		if(kRamp) {
+			for(unsigned j = 0; j < kRamped; j++)
+				coef[j] += step[j];
+		}
+	}
+}
+
+template<int32_t (*kFilter)(int32_t, int32_t *, const int32_t *), unsigned kRamped>
+static void run(AUDIOSAMPLE *buffer, unsigned count, int32_t *coef, const int32_t *step,
+                int32_t *left, int32_t *right)
+{
+	if(step)
+		runFrame<kFilter, kRamped, true>(buffer, count, coef, step, left, right);
+	else
+		runFrame<kFilter, kRamped, false>(buffer, count, coef, step, left, right);
+}
+
+FilterSource::FilterSource(AudioSource *source)
+	: _source(source)
+	, _type(kLowPass)
+	, _structure(kBiquad)
+	, _cutoff(kCutoffSteps - 1)
+	, _resonance(kButterworth)
+	, _update(kPerSample)
+	, _typeNow(kLowPass)
+	, _structureNow(kBiquad)
+	, _cutoffNow(0xFF)
+	, _resonanceNow(kButterworth)
+{
+	memset(_coef, 0, sizeof(_coef));
+	memset(_state, 0, sizeof(_state));
+}
+
+FilterSource::~FilterSource()
+{
+}
+
+void FilterSource::setType(Type type, Structure structure)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_type      = type;
+	_structure = structure;
+	__set_PRIMASK(primask);
+}
+
+void FilterSource::process(AUDIOSAMPLE *buffer, unsigned count)
+{
+	unsigned type      = _type;
+	unsigned structure = _structure;
+	unsigned cutoff    = _cutoff;
+	unsigned resonance = _resonance;
+
+	// A new filter starts from scratch, with no glide.
+	if(type != _typeNow || structure != _structureNow) {
+		memset(_state, 0, sizeof(_state));
+		_typeNow      = type;
+		_structureNow = structure;
+		_cutoffNow    = 0xFF;
+	}
+
+	int32_t  target[kCoefficients];
+	int32_t  step[kCoefficients];
+	int32_t *ramp = 0;
+	if(cutoff != _cutoffNow || resonance != _resonanceNow) {
+		if(structure == kStateVariable)
+			designStateVariable(target, cutoff, resonance);
+		else
+			designBiquad(target, type, cutoff, resonance);
+
+		// Any remainder is made up after the last sample.
+		if(_update == kPerSample && _cutoffNow != 0xFF && count > 1) {
+			for(unsigned j = 0; j < kCoefficients; j++)
+				step[j] = (target[j] - _coef[j]) / (int32_t)count;
+			ramp = step;
+		} else {
+			memcpy(_coef, target, sizeof(_coef));
+		}
+		_cutoffNow    = cutoff;
+		_resonanceNow = resonance;
+	}
+
+	if(structure == kBiquad)
+		run<biquad, 5>(buffer, count, _coef, ramp, _state[0], _state[1]);
+	else if(type == kLowPass)
+		run<stateVariable<kLowPass>, 2>(buffer, count, _coef, ramp, _state[0], _state[1]);
+	else if(type == kHighPass)
+		run<stateVariable<kHighPass>, 2>(buffer, count, _coef, ramp, _state[0], _state[1]);
+	else if(type == kBandPass)
+		run<stateVariable<kBandPass>, 2>(buffer, count, _coef, ramp, _state[0], _state[1]);
+	else
+		run<stateVariable<kNotch>, 2>(buffer, count, _coef, ramp, _state[0], _state[1]);
+
+	if(ramp)
+		memcpy(_coef, target, sizeof(_coef));
+}
+
+void FilterSource::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	if(_source)
+		_source->fillBuffer(buffer);
+	else
+		memset(buffer, 0, kFrameBytes);
+	process(buffer, kFrameSize);
+}
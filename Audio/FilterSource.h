@@ -0,0 +1,114 @@
+/*
+ * FilterSource.h - Resonant filters for another audio source.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_FILTERSOURCE_H_
+#define AUDIO_FILTERSOURCE_H_
+
+#include "AudioSource.h"
+
+// Filters the frames from another source in place: low pass, high pass,
+// band pass (0dB at the peak) or notch. Either structure does any of them:
+//
+// kBiquad is a direct form I biquad with the usual bilinear transform
+// responses. The coefficients are Q29 and each multiply is split into two
+// 16x16 ones, which the M0 does in a cycle, so it stays accurate right down
+// at the bottom where the poles are almost on the unit circle. What's lost
+// rounding the output is added back next time round (error feedback) so
+// there's no low frequency noise or limit cycles either.
+//
+// kStateVariable is a Chamberlin state variable filter. It's about half
+// the cost and its coefficients hardly change with resonance, but it can't
+// go much over fs/6 without going unstable, so the cutoff is kept below
+// that for low resonance (and the response gets bent up there anyway).
+//
+// The cutoff is in semitone steps from 20Hz (step 0) to 19.4kHz (step 119)
+// and the resonance in quarter octave steps of Q from 0.5 (step 0) to 6.7
+// (step 15). Step kButterworth is a Q of 0.707. The coefficients are worked
+// out from tables the compiler made, with no trig or floating point at run
+// time, so they can be changed every frame. The steps are for the default
+// output rate and move with it if that is changed.
+//
+// With kPerSample the coefficients glide from the old setting to the new
+// one across the frame, which stops zipper noise when it's being swept.
+// kPerFrame changes them at the start of the frame, which is cheaper. A big
+// jump in cutoff at high resonance can make that click.
+//
+// The settings can be changed from the main loop while the audio interrupt
+// is running, they're picked up at the start of the next frame. The peaks of
+// a resonant filter can be 16dB over the input, which is saturated rather
+// than wrapping, so keep the input down when the resonance is up.
+//
+// Budget, stereo at the default rate: 120 cycles a sample for kBiquad and
+// 80 for kStateVariable, 8 more with kPerSample. See Benchmark for what they
+// really take.
+class FilterSource
+	: public AudioSource
+{
+public:
+	enum Type {
+		kLowPass,
+		kHighPass,
+		kBandPass,
+		kNotch
+	};
+
+	enum Structure {
+		kBiquad,
+		kStateVariable
+	};
+
+	enum Update {
+		kPerFrame,
+		kPerSample
+	};
+
+	enum {
+		kCutoffSteps    = 120,
+		kResonanceSteps = 16,
+		kButterworth    = 2
+	};
+
+	FilterSource(AudioSource *source = 0);
+	virtual ~FilterSource();
+
+	void setSource(AudioSource *source) { _source = source; }
+
+	// Starts from silence.
+	void setType(Type type, Structure structure = kBiquad);
+
+	void setCutoff(unsigned step)    { _cutoff = step < kCutoffSteps ? step : kCutoffSteps - 1; }
+	void setResonance(unsigned step) { _resonance = step < kResonanceSteps ? step : kResonanceSteps - 1; }
+	void setUpdate(Update update)    { _update = update; }
+
+	// Filter some samples that are already there. Called by fillBuffer(),
+	// or use it on its own.
+	void process(AUDIOSAMPLE *buffer, unsigned count);
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const { return _source && _source->isActive(); }
+
+private:
+	enum {
+		kCoefficients = 5,
+		kState        = 6
+	};
+
+	AudioSource     *_source;
+	int32_t          _coef[kCoefficients];     // b0, b1, b2, -a1, -a2 for kBiquad, f and q for kStateVariable.
+	int32_t          _state[2][kState];        // Each channel's x1, x2, y1, y2 and last two errors, or low and band.
+	volatile uint8_t _type;
+	volatile uint8_t _structure;
+	volatile uint8_t _cutoff;
+	volatile uint8_t _resonance;
+	volatile uint8_t _update;
+	uint8_t          _typeNow;
+	uint8_t          _structureNow;
+	uint8_t          _cutoffNow;    // What _coef is for, 0xFF before the first frame.
+	uint8_t          _resonanceNow;
+};
+
+#endif /* AUDIO_FILTERSOURCE_H_ */
@@ -0,0 +1,92 @@
+/*
+ * FlashSampleSource.cpp - Plays samples built into the firmware.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "FlashSampleSource.h"
+#include "board.h"
+#include <string.h>
+
+FlashSampleSource::FlashSampleSource()
+	: _sample(0)
+	, _pos(0)
+	, _left(0)
+	, _loop(false)
+	, _isPlaying(false)
+	, _gain(GainStage::kUnity)
+{
+}
+
+FlashSampleSource::~FlashSampleSource()
+{
+}
+
+const FlashSample *FlashSampleSource::find(const char *name)
+{
+	for(unsigned i = 0; i < g_sampleBankSize; i++) {
+		if(0 == strcmp(g_sampleBank[i].name, name))
+			return &g_sampleBank[i];
+	}
+	return 0;
+}
+
+void FlashSampleSource::play(const FlashSample *sample, bool loop)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	_sample    = sample;
+	_pos       = sample ? sample->data : 0;
+	_left      = sample ? sample->frames : 0;
+	_loop      = loop;
+	_isPlaying = (_left > 0);
+
+	__set_PRIMASK(primask);
+}
+
+void FlashSampleSource::stop()
+{
+	_isPlaying = false;
+}
+
+void FlashSampleSource::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	unsigned i = 0;
+
+	while(i < kFrameSize && _isPlaying) {
+		unsigned n = kFrameSize - i;
+		if(n > _left)
+			n = _left;
+
+		if(_sample->channels == 2) {
+			memcpy(&buffer[i], _pos, n * sizeof(AUDIOSAMPLE));
+			_pos += n * 2;
+		} else {
+			// Same in both channels.
+			for(unsigned j = 0; j < n; j++) {
+				uint32_t s = (uint16_t)_pos[j];
+				buffer[i + j] = (s << 16) | s;
+			}
+			_pos += n;
+		}
+
+		i     += n;
+		_left -= n;
+
+		if(_left == 0) {
+			if(_loop) {
+				_pos  = _sample->data;
+				_left = _sample->frames;
+			} else {
+				_isPlaying = false;
+			}
+		}
+	}
+
+	if(i < kFrameSize)
+		memset(&buffer[i], 0, (kFrameSize - i) * sizeof(AUDIOSAMPLE));
+
+	_gain.process(buffer, kFrameSize);
+}
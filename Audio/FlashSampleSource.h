@@ -0,0 +1,68 @@
+/*
+ * FlashSampleSource.h - Plays samples built into the firmware.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_FLASHSAMPLESOURCE_H_
+#define AUDIO_FLASHSAMPLESOURCE_H_
+
+#include "AudioSource.h"
+#include "GainStage.h"
+
+// A sample in the flash sample bank. The bank is Audio/SampleBank.cpp,
+// which tools/wav2flash.py writes from the WAV files listed in SAMPLE_BANK
+// in the Makefile. The data goes into its own .samplebank section in the
+// flash that the code doesn't use.
+struct FlashSample
+{
+	const char    *name;       // "/" and the WAV file name, like a path on the card.
+	const int16_t *data;       // Signed 16-bit, left then right if stereo.
+	uint32_t       frames;
+	uint16_t       sampleRate; // Plays at the I2S rate, set that to match if it can be (see main.cpp).
+	uint8_t        channels;   // 1 or 2.
+};
+
+extern const FlashSample g_sampleBank[];
+extern const unsigned    g_sampleBankSize;
+
+// Plays a FlashSample. There is no SD card access at all, so it starts at
+// the next frame and can't run out of data, which makes it good for short
+// one-shots (clicks, rim shots, a metronome) and as something to play when
+// the card is missing or too busy.
+class FlashSampleSource
+	: public AudioSource
+{
+public:
+	FlashSampleSource();
+	virtual ~FlashSampleSource();
+
+	// Look up a sample by name, 0 if it isn't in the bank.
+	static const FlashSample *find(const char *name);
+
+	static unsigned           getBankSize() { return g_sampleBankSize; }
+	static const FlashSample *getSample(unsigned i) { return i < g_sampleBankSize ? &g_sampleBank[i] : 0; }
+
+	// Can be called at any time, it takes effect at the next frame.
+	void play(const FlashSample *sample, bool loop = false);
+	void stop();
+
+	bool isPlaying() const { return _isPlaying; }
+
+	// Volume, see GainStage for the units.
+	void setGain(unsigned gain) { _gain.setGain(gain); }
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const { return _isPlaying; } // Even when turned down, see AudioSource.
+
+private:
+	const FlashSample *_sample;
+	const int16_t     *_pos;
+	unsigned           _left; // Frames to go.
+	bool               _loop;
+	volatile bool      _isPlaying;
+	GainStage          _gain;
+};
+
+#endif /* AUDIO_FLASHSAMPLESOURCE_H_ */
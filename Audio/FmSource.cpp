@@ -0,0 +1,123 @@
+/*
+ * FmSource.cpp - Two operator FM voice.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "FmSource.h"
+#include "board.h"
+#include "AudioKinetisI2S.h"
+#include "Wavetable.h"
+#include <string.h>
+
+// Phase for one radian per unit of modulator output, 2^32 / (2 pi 32767).
+// The index times this times the modulator can go well past 32 bits, but
+// that's fine, it's a phase so it's meant to wrap.
+#define FM_RADIAN 20861
+
+// The note is over once the level (1.15) is under this, -78dB.
+#define FM_SILENCE 4
+
+// v * scale >> 16 without needing 64 bits.
+static inline uint32_t scale(uint32_t v, uint32_t scale)
+{
+	return (v >> 16) * scale + (((v & 0xFFFF) * scale) >> 16);
+}
+
+FmSource::FmSource()
+	: _gain(GainStage::kUnity)
+	, _carrier(0)
+	, _modulator(0)
+	, _carrierStep(0)
+	, _modulatorStep(0)
+	, _level(0)
+	, _depth(0)
+	, _levelDecay(0xFF00)
+	, _depthDecay(0xF800)
+	, _releaseDecay(0xE000)
+	, _ratio(kUnityRatio)
+	, _index(2 * kIndexOne)
+	, _releasing(false)
+	, _isPlaying(false)
+{
+}
+
+FmSource::~FmSource()
+{
+}
+
+void FmSource::setDecay(unsigned level, unsigned index, unsigned release)
+{
+	_levelDecay   = level < kNoDecay ? level : kNoDecay;
+	_depthDecay   = index < kNoDecay ? index : kNoDecay;
+	_releaseDecay = release < kNoDecay ? release : kNoDecay;
+}
+
+// Both phases start from 0 so the note starts from silence, there's no click.
+void FmSource::noteOn(uint32_t frequency, unsigned level)
+{
+	uint32_t carrierStep   = Wavetable::increment(frequency, AudioKinetisI2S::getSampleRate());
+	uint32_t modulatorStep = (uint32_t)(((uint64_t)carrierStep * _ratio) >> 8);
+	int32_t  depth         = (uint32_t)_index * FM_RADIAN >> 8;
+	if(level > GainStage::kUnity)
+		level = GainStage::kUnity;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_carrier       = 0;
+	_modulator     = 0;
+	_carrierStep   = carrierStep;
+	_modulatorStep = modulatorStep;
+	_level         = level << 8;
+	_depth         = depth;
+	_releasing     = false;
+	_isPlaying     = level != 0;
+	__set_PRIMASK(primask);
+}
+
+void FmSource::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	if(!_isPlaying) {
+		memset(buffer, 0, kFrameBytes);
+		return;
+	}
+
+	const int16_t *sine = g_wavetable.sine;
+
+	// Where the level and index will have got to by the end of the frame.
+	// The steps are rounded off, so the ends are set exactly afterwards or
+	// a quiet note would never get any quieter.
+	int32_t level       = _level;
+	int32_t levelTarget = scale(level, _releasing ? _releaseDecay : _levelDecay);
+	int32_t levelStep   = (levelTarget - level) / (int32_t)kFrameSize;
+	int32_t depth       = _depth;
+	int32_t depthTarget = scale(depth, _depthDecay);
+	int32_t depthStep   = (depthTarget - depth) / (int32_t)kFrameSize;
+
+	uint32_t carrier       = _carrier;
+	uint32_t modulator     = _modulator;
+	uint32_t carrierStep   = _carrierStep;
+	uint32_t modulatorStep = _modulatorStep;
+
+	for(unsigned i = 0; i < kFrameSize; i++) {
+		int32_t m = Wavetable::lookup(sine, modulator);
+		int32_t c = Wavetable::lookup(sine, carrier + (uint32_t)m * (uint32_t)depth);
+		uint32_t s = (uint16_t)((c * (level >> 8)) >> 15);
+		buffer[i] = (s << 16) | s;
+
+		carrier   += carrierStep;
+		modulator += modulatorStep;
+		level     += levelStep;
+		depth     += depthStep;
+	}
+
+	_carrier   = carrier;
+	_modulator = modulator;
+	_level     = levelTarget;
+	_depth     = depthTarget;
+	if((levelTarget >> 8) < FM_SILENCE)
+		_isPlaying = false;
+
+	_gain.process(buffer, kFrameSize);
+}
@@ -0,0 +1,79 @@
+/*
+ * FmSource.h - Two operator FM voice.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_FMSOURCE_H_
+#define AUDIO_FMSOURCE_H_
+
+#include "AudioSource.h"
+#include "GainStage.h"
+
+// One sine (the modulator) pushing the phase of another (the carrier) about,
+// the way the old Yamaha chips did it. The modulator runs at a fixed ratio
+// to the carrier. Whole number ratios give harmonic sounds (organs, brass,
+// electric piano), odd ones like 3.5:1 are bells and clangs. How far it
+// pushes is the index, in radians: 0 is a plain sine, the higher it is the
+// more harmonics there are.
+//
+// Both come out of the shared g_wavetable.sine (see Wavetable.h). The
+// loudness and the index each decay by a fixed amount a frame, ramped across
+// the frame so there are no steps, so the sound gets darker as it dies away.
+// A note plays until it's too quiet to hear, after which isActive() is false
+// and a Mixer skips it.
+//
+// Everything can be set from the main loop at any time. The ratio, index and
+// decays are picked up by the next note.
+class FmSource
+	: public AudioSource
+{
+public:
+	enum {
+		kUnityRatio = 0x100,  // Ratios are Q8.
+		kIndexOne   = 0x100,  // Indexes are Q8 radians.
+		kNoDecay    = 0x10000 // Decays are a Q16 multiplier per frame.
+	};
+
+	FmSource();
+	virtual ~FmSource();
+
+	// Frequency is Q16.16 Hz, level is 1.15.
+	void noteOn(uint32_t frequency, unsigned level = GainStage::kUnity);
+
+	// Die away quickly, at the release rate rather than the decay.
+	void noteOff() { _releasing = true; }
+
+	void setRatio(unsigned ratio) { _ratio = ratio; }
+	void setIndex(unsigned index) { _index = index; }
+
+	// Per frame, so 0xFF00 halves in 177 frames (half a second at 44.1kHz,
+	// a frame is 2.9ms) and 0xF000 in 11. 0xFF80 takes about a second. The
+	// index decay is how quickly it gets darker.
+	void setDecay(unsigned level, unsigned index, unsigned release = 0xE000);
+
+	// Volume, see GainStage for the units.
+	void setGain(unsigned gain) { _gain.setGain(gain); }
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const { return _isPlaying; }
+
+private:
+	GainStage         _gain;
+	uint32_t          _carrier;       // Phases.
+	uint32_t          _modulator;
+	volatile uint32_t _carrierStep;   // Phase increments.
+	volatile uint32_t _modulatorStep;
+	int32_t           _level;         // Q23, 1.15 with 8 more bits for the ramp.
+	int32_t           _depth;         // Index as phase per unit of modulator.
+	volatile uint32_t _levelDecay;
+	volatile uint32_t _depthDecay;
+	volatile uint32_t _releaseDecay;
+	volatile uint16_t _ratio;
+	volatile uint16_t _index;
+	volatile bool     _releasing;
+	volatile bool     _isPlaying;
+};
+
+#endif /* AUDIO_FMSOURCE_H_ */
@@ -0,0 +1,127 @@
+/*
+ * GainStage.cpp - Stereo volume control working on packed samples.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "GainStage.h"
+#include <string.h>
+
+// Add two pairs of 16-bit lanes without the carry out of the low lane
+// spilling into the high one. Negative steps are just two's complement
+// lanes, so this handles ramping down as well as up.
+static inline uint32_t laneAdd(uint32_t a, uint32_t b)
+{
+	return ((a & 0x7FFF7FFF) + (b & 0x7FFF7FFF)) ^ ((a ^ b) & 0x80008000);
+}
+
+static inline uint32_t pack(int32_t left, int32_t right)
+{
+	return ((uint32_t)right << 16) | ((uint32_t)left & 0xFFFF);
+}
+
+// Work out how much to step each gain per sample to get from one packed gain
+// to another in count samples. Any remainder is made up after the last sample.
+static uint32_t rampStep(uint32_t from, uint32_t to, unsigned count)
+{
+	int32_t stepL = ((int32_t)(to & 0xFFFF) - (int32_t)(from & 0xFFFF)) / (int32_t)count;
+	int32_t stepR = ((int32_t)(to >> 16)    - (int32_t)(from >> 16))    / (int32_t)count;
+	return pack(stepL, stepR);
+}
+
+GainStage::GainStage(unsigned gain)
+	: _target(pack(gain, gain))
+	, _gain(pack(gain, gain))
+{
+}
+
+void GainStage::setGain(unsigned left, unsigned right)
+{
+	_target = pack(left, right);
+}
+
+void GainStage::jumpTo(unsigned left, unsigned right)
+{
+	_gain = _target = pack(left, right);
+}
+
+void GainStage::process(AUDIOSAMPLE *buffer, unsigned count)
+{
+	uint32_t target = _target;
+	uint32_t gain   = _gain;
+
+	if(gain == target) {
+		if(gain == pack(kUnity, kUnity))
+			return; // Nothing to do.
+
+		if(gain == 0) {
+			memset(buffer, 0, count * sizeof(AUDIOSAMPLE));
+			return;
+		}
+
+		int32_t gainL = gain & 0xFFFF;
+		int32_t gainR = gain >> 16;
+
+		if(gainL <= kUnity && gainR <= kUnity) {
+			// Can't overflow so no need to saturate.
+			for(unsigned i = 0; i < count; i++) {
+				uint32_t s = buffer[i];
+				int32_t  l = ((int32_t)(int16_t)s * gainL) >> 15;
+				int32_t  r = ((int32_t)s >> 16) * gainR >> 15;
+				buffer[i] = pack(l, r);
+			}
+			return;
+		}
+
+		for(unsigned i = 0; i < count; i++) {
+			uint32_t s = buffer[i];
+			int32_t  l = saturate16(((int32_t)(int16_t)s * gainL) >> 15);
+			int32_t  r = saturate16(((int32_t)s >> 16) * gainR >> 15);
+			buffer[i] = pack(l, r);
+		}
+		return;
+	}
+
+	// Ramping towards a new gain.
+	uint32_t step = rampStep(gain, target, count);
+	for(unsigned i = 0; i < count; i++) {
+		uint32_t s = buffer[i];
+		int32_t  l = saturate16(((int32_t)(int16_t)s * (int32_t)(gain & 0xFFFF)) >> 15);
+		int32_t  r = saturate16(((int32_t)s >> 16) * (int32_t)(gain >> 16) >> 15);
+		buffer[i] = pack(l, r);
+		gain = laneAdd(gain, step);
+	}
+	_gain = target;
+}
+
+void GainStage::accumulate(int32_t *mix, const AUDIOSAMPLE *buffer, unsigned count)
+{
+	uint32_t target = _target;
+	uint32_t gain   = _gain;
+
+	if(gain == target) {
+		if(gain == 0)
+			return;
+
+		int32_t gainL = gain & 0xFFFF;
+		int32_t gainR = gain >> 16;
+		for(unsigned i = 0; i < count; i++) {
+			uint32_t s = buffer[i];
+			mix[0] += ((int32_t)(int16_t)s * gainL) >> 15;
+			mix[1] += ((int32_t)s >> 16) * gainR >> 15;
+			mix += 2;
+		}
+		return;
+	}
+
+	uint32_t step = rampStep(gain, target, count);
+	for(unsigned i = 0; i < count; i++) {
+		uint32_t s = buffer[i];
+		mix[0] += ((int32_t)(int16_t)s * (int32_t)(gain & 0xFFFF)) >> 15;
+		mix[1] += ((int32_t)s >> 16) * (int32_t)(gain >> 16) >> 15;
+		mix += 2;
+		gain = laneAdd(gain, step);
+	}
+	_gain = target;
+}
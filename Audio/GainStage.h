@@ -0,0 +1,67 @@
+/*
+ * GainStage.h - Stereo volume control working on packed samples.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_GAINSTAGE_H_
+#define AUDIO_GAINSTAGE_H_
+
+#include "AudioSource.h"
+
+// Clamp to 16 bits. The M0 has no SSAT instruction. Everything that
+// saturates samples uses this one.
+static inline int32_t saturate16(int32_t v)
+{
+	if((v >> 15) != (v >> 31))
+		v = (v >> 31) ^ 0x7FFF;
+	return v;
+}
+
+// Gains are unsigned 1.15 fixed point, so kUnity (0x8000) leaves the signal
+// alone and the maximum (0xFFFF) is just under +6dB. Anything over unity
+// saturates rather than wrapping.
+//
+// A new gain doesn't take effect straight away. It ramps there over the next
+// frame so there is no zipper noise. The left and right gains are kept packed
+// in one word (like the samples are) so one add steps both of them along the
+// ramp.
+//
+// setGain() can be called from the main loop while the audio interrupt is
+// running process(), the new gain is picked up at the start of the next frame.
+class GainStage
+{
+public:
+	enum {
+		kUnity   = 0x8000,
+		kMaxGain = 0xFFFF
+	};
+
+	GainStage(unsigned gain = kUnity);
+
+	void setGain(unsigned left, unsigned right);
+	void setGain(unsigned gain) { setGain(gain, gain); }
+
+	// Change the gain without a ramp.
+	void jumpTo(unsigned left, unsigned right);
+
+	unsigned getLeft()  const { return _target & 0xFFFF; }
+	unsigned getRight() const { return _target >> 16; }
+
+	// True once the gain has settled at zero, output is just silence.
+	bool isSilent() const { return _gain == 0 && _target == 0; }
+
+	void process(AUDIOSAMPLE *buffer, unsigned count);
+
+	// Add the samples with the gain applied onto a 32-bit mix buffer holding
+	// left and right alternately. Nothing is saturated, that is left until
+	// the mix is complete.
+	void accumulate(int32_t *mix, const AUDIOSAMPLE *buffer, unsigned count);
+
+private:
+	volatile uint32_t _target; // Gain we are heading for, right << 16 | left.
+	uint32_t          _gain;   // Gain applied to the next sample.
+};
+
+#endif /* AUDIO_GAINSTAGE_H_ */
@@ -0,0 +1,297 @@
+/*
+ * GranularSource.cpp - Granular synthesis from a window of a sample.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "GranularSource.h"
+#include "AudioKinetisI2S.h"
+#include "ConstexprMath.h"
+#include "Trace.h"
+#include <string.h>
+
+#define WINDOW_MASK (GranularSource::kWindowFrames - 1)
+
+// Part of the grain at each end that kTukey fades over.
+#define TAPER 0.25
+
+// Each step is taken at its middle, so the envelopes are symmetrical and
+// the ends are quiet but not quite 0.
+struct EnvelopeTables
+{
+	int16_t e[2][GranularSource::kEnvelopeSize];
+
+	constexpr EnvelopeTables()
+		: e()
+	{
+		for(unsigned i = 0; i < GranularSource::kEnvelopeSize; i++) {
+			double x = (i + 0.5) / GranularSource::kEnvelopeSize;
+			double t = x < TAPER ? x / TAPER : x > 1 - TAPER ? (1 - x) / TAPER : 1;
+			e[GranularSource::kHann][i]  = ConstexprMath::round((0.5 - 0.5 * ConstexprMath::cos(2 * ConstexprMath::kPi * x)) * 32767);
+			e[GranularSource::kTukey][i] = ConstexprMath::round((0.5 - 0.5 * ConstexprMath::cos(ConstexprMath::kPi * t)) * 32767);
+		}
+	}
+};
+
+static constexpr EnvelopeTables s_envelope;
+
+GranularSource::GranularSource()
+	: _gain(GainStage::kUnity / 4)
+	, _head(0)
+	, _scanFrac(0)
+	, _random(0x12345678)
+	, _nextGrain(0)
+	, _interval(0)
+	, _position(kWindowFrames / 2)
+	, _spread(0)
+	, _length(kWindowFrames / 4)
+	, _pitch(kUnitySpeed)
+	, _scan(kUnitySpeed)
+	, _envelope(kHann)
+	, _maxGrains(kMaxGrains)
+	, _isPlaying(false)
+	, _streamed(false)
+	, _scanMax(0)
+{
+	memset(_grains, 0, sizeof(_grains));
+	memset(_window, 0, sizeof(_window));
+	setDensity(40);
+}
+
+GranularSource::~GranularSource()
+{
+}
+
+bool GranularSource::open(const TCHAR *filename, unsigned start, unsigned end)
+{
+	close();
+	if(!_wav.open(filename))
+		return false;
+
+	unsigned blockAlign = _wav.getBlockAlign();
+	unsigned frames     = _wav.getFormat() == WavFile::kFormatPcm ? _wav.getByteSize() / blockAlign : 0;
+	if(end == 0 || end > frames)
+		end = frames;
+
+	if(_wav.getNumBits() != 16 || start >= end ||
+	   !_wav.startStream(true, start * blockAlign, start * blockAlign, end * blockAlign)) {
+		_wav.close();
+		return false;
+	}
+
+	// As much as fits in the frame buffer, which scan() reads into, and
+	// leaves the grains half the window.
+	_scanMax = kFrameBytes / blockAlign;
+	if(_scanMax > kWindowFrames / 2)
+		_scanMax = kWindowFrames / 2;
+
+	_streamed = true;
+	return true;
+}
+
+void GranularSource::close()
+{
+	_isPlaying = false;
+	_streamed  = false;
+	_wav.close();
+}
+
+void GranularSource::setWindow(const int16_t *samples, unsigned frames)
+{
+	_streamed = false;
+	_wav.close();
+
+	if(frames > kWindowFrames) {
+		samples += frames - kWindowFrames;
+		frames   = kWindowFrames;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memset(_window, 0, sizeof(_window));
+	memcpy(_window, samples, frames * sizeof(int16_t));
+	_head = frames;
+	__set_PRIMASK(primask);
+}
+
+void GranularSource::play()
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for(unsigned i = 0; i < kMaxGrains; i++)
+		_grains[i].left = 0;
+	_nextGrain = 0;
+	_isPlaying = true;
+	__set_PRIMASK(primask);
+}
+
+void GranularSource::stop()
+{
+	_isPlaying = false;
+}
+
+void GranularSource::setDensity(unsigned grainsPerSecond)
+{
+	unsigned interval = 0;
+	if(grainsPerSecond) {
+		interval = AudioKinetisI2S::getSampleRate() / grainsPerSecond;
+		if(interval == 0)
+			interval = 1;
+	}
+	_interval = interval;
+}
+
+unsigned GranularSource::getActiveGrains() const
+{
+	unsigned n = 0;
+	for(unsigned i = 0; i < kMaxGrains; i++) {
+		if(_grains[i].left)
+			n++;
+	}
+	return n;
+}
+
+// Move the window on through the file by this frame's share of the scan.
+// The frame buffer isn't in use yet, so the file is read into that.
+void GranularSource::scan(uint8_t *scratch)
+{
+	uint32_t advance = _scanFrac + kFrameSize * _scan;
+	unsigned frames  = advance >> 16;
+	_scanFrac = advance & 0xFFFF;
+	if(frames > _scanMax)
+		frames = _scanMax;
+	if(frames == 0)
+		return;
+
+	unsigned blockAlign = _wav.getBlockAlign();
+	unsigned got        = _wav.readBlock(scratch, frames * blockAlign) / blockAlign;
+	if(got < frames)
+		Trace::event(kTraceStreamUnderrun, got);
+
+	const int16_t *in   = (const int16_t *)scratch;
+	uint32_t       head = _head;
+	if(blockAlign == 4) {
+		for(unsigned i = 0; i < got; i++)
+			_window[(head + i) & WINDOW_MASK] = (in[2 * i] + in[2 * i + 1]) >> 1;
+	} else {
+		for(unsigned i = 0; i < got; i++)
+			_window[(head + i) & WINDOW_MASK] = in[i];
+	}
+	_head = head + got;
+}
+
+// Set a grain going delay frames into this frame, from around position
+// back from the newest frame in the window.
+void GranularSource::start(Grain &grain, unsigned delay)
+{
+	uint32_t pitch  = _pitch;
+	uint32_t scan   = _streamed ? _scan : 0;
+	unsigned length = _length;
+
+	// How far the scan can get ahead of the frame being played.
+	unsigned ahead = (kFrameSize * scan) >> 16;
+	if(ahead > _scanMax)
+		ahead = _scanMax;
+
+	// It mustn't read past the newest frame, or get to frames the scan has
+	// written over before it finishes. Shorten it if it can't help both.
+	unsigned most = ((kWindowFrames - 4 - ahead) << 16) / (pitch + scan + 1);
+	if(length > most)
+		length = most;
+	if(length == 0)
+		return;
+
+	_random = _random * 1664525 + 1013904223;
+	unsigned back   = _position + (((_random >> 16) * (_spread + 1)) >> 16);
+	unsigned newest = ((length * pitch) >> 16) + 2;
+	unsigned oldest = kWindowFrames - 2 - ahead - ((length * scan) >> 16);
+	if(back < newest)
+		back = newest;
+	if(back > oldest)
+		back = oldest;
+
+	grain.pos      = (_head - back) << 16;
+	grain.step     = pitch;
+	grain.envPos   = 0;
+	grain.envStep  = (kEnvelopeSize << 16) / length;
+	grain.envelope = s_envelope.e[_envelope];
+	grain.delay    = delay;
+	grain.left     = length;
+}
+
+// Add as much of the grain as falls in this frame onto the mix, linearly
+// interpolated from the window.
+void GranularSource::render(Grain &grain, int32_t *mix)
+{
+	unsigned n = kFrameSize - grain.delay;
+	if(n > grain.left)
+		n = grain.left;
+
+	const int16_t *envelope = grain.envelope;
+	uint32_t       pos      = grain.pos;
+	uint32_t       step     = grain.step;
+	uint32_t       envPos   = grain.envPos;
+	uint32_t       envStep  = grain.envStep;
+
+	mix += grain.delay;
+	for(unsigned i = 0; i < n; i++) {
+		unsigned j = pos >> 16;
+		int32_t  a = _window[j & WINDOW_MASK];
+		int32_t  b = _window[(j + 1) & WINDOW_MASK];
+		int32_t  s = a + (((b - a) * (int32_t)((pos >> 1) & 0x7FFF)) >> 15);
+		mix[i] += (s * envelope[envPos >> 16]) >> 15;
+		pos    += step;
+		envPos += envStep;
+	}
+
+	grain.pos    = pos;
+	grain.envPos = envPos;
+	grain.left  -= n;
+	grain.delay  = 0;
+}
+
+void GranularSource::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	if(!_isPlaying) {
+		memset(buffer, 0, kFrameBytes);
+		_gain.process(buffer, kFrameSize);
+		return;
+	}
+
+	if(_streamed)
+		scan((uint8_t *)buffer);
+
+	// Start the grains due in this frame, if not too many are playing.
+	unsigned interval = _interval;
+	while(interval != 0 && _nextGrain < kFrameSize) {
+		unsigned active = 0;
+		Grain   *free   = 0;
+		for(unsigned i = 0; i < kMaxGrains; i++) {
+			if(_grains[i].left)
+				active++;
+			else if(free == 0)
+				free = &_grains[i];
+		}
+		if(free && active < _maxGrains)
+			start(*free, _nextGrain);
+		_nextGrain += interval;
+	}
+	if(_nextGrain >= kFrameSize)
+		_nextGrain -= kFrameSize;
+
+	// Mono in 32 bits, then back to packed stereo in the same buffer.
+	int32_t *mix = (int32_t *)buffer;
+	memset(mix, 0, kFrameBytes);
+	for(unsigned i = 0; i < kMaxGrains; i++) {
+		if(_grains[i].left)
+			render(_grains[i], mix);
+	}
+
+	for(unsigned i = 0; i < kFrameSize; i++) {
+		int32_t s = saturate16(mix[i]);
+		buffer[i] = ((uint32_t)(uint16_t)s << 16) | (uint16_t)s;
+	}
+
+	_gain.process(buffer, kFrameSize);
+}
@@ -0,0 +1,122 @@
+/*
+ * GranularSource.h - Granular synthesis from a window of a sample.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_GRANULARSOURCE_H_
+#define AUDIO_GRANULARSOURCE_H_
+
+#include "AudioSource.h"
+#include "GainStage.h"
+#include "WavFile.h"
+#include "board.h"
+
+// Plays lots of short overlapping grains of a sample, each read from a
+// window of it in RAM at its own pitch and shaped by an envelope. The
+// window is the last kWindowFrames frames of a 16-bit PCM file (mixed down
+// to mono), which the StreamScheduler reads from the card in the main
+// loop. The window moves through the file at the scan speed, or stays where
+// it is if that's 0. It can also be loaded from RAM or flash with
+// setWindow() instead.
+//
+// Grains start density times a second, as long as fewer than the grain
+// limit are already playing, so the CPU it takes has a ceiling (see
+// Benchmark for what each grain costs). Each one starts position frames
+// back from the newest frame in the window, plus a random amount up to
+// spread, and is moved in if it would run off either end of the window
+// before it finishes. The envelopes are tables worked out by the compiler.
+//
+// The controls can be changed from the main loop at any time. Grains
+// already playing carry on as they started, new ones get the new settings.
+class GranularSource
+	: public AudioSource
+{
+public:
+	enum Envelope {
+		kHann,  // Smooth all the way, for dense clouds.
+		kTukey  // Flat in the middle with short fades, for more of the sample.
+	};
+
+	enum {
+		kWindowFrames = GRANULAR_WINDOW_FRAMES,
+		kMaxGrains    = GRANULAR_MAX_GRAINS,
+		kEnvelopeBits = 8,
+		kEnvelopeSize = 1 << kEnvelopeBits,
+		kUnitySpeed   = 0x10000,         // Q16.16
+		kMaxSpeed     = 4 * kUnitySpeed
+	};
+
+	GranularSource();
+	virtual ~GranularSource();
+
+	// Stream frames start to end (0 for the end) of a 16-bit PCM file, round
+	// and round. Needs a stream (see STREAM_COUNT in board.h). Main loop only.
+	bool open(const TCHAR *filename, unsigned start = 0, unsigned end = 0);
+	void close();
+
+	// Or take the window from memory: up to kWindowFrames frames of mono,
+	// the newest last. It stays as it is.
+	void setWindow(const int16_t *samples, unsigned frames);
+
+	void play();
+	void stop();
+	bool isPlaying() const { return _isPlaying; }
+
+	void setDensity(unsigned grainsPerSecond);
+	void setPosition(unsigned frames) { _position = frames < kWindowFrames ? frames : kWindowFrames - 1; }
+	void setSpread(unsigned frames)   { _spread = frames < kWindowFrames ? frames : kWindowFrames - 1; }
+	void setLength(unsigned frames)   { _length = frames < kWindowFrames ? frames : kWindowFrames; }
+	void setPitch(uint32_t speed)     { _pitch = speed < kMaxSpeed ? speed : kMaxSpeed; }
+	void setScan(uint32_t speed)      { _scan = speed < kMaxSpeed ? speed : kMaxSpeed; }
+	void setEnvelope(Envelope envelope) { _envelope = envelope; }
+	void setMaxGrains(unsigned grains)  { _maxGrains = grains < kMaxGrains ? grains : kMaxGrains; }
+
+	// Volume, see GainStage for the units. Grains add up, so the more of
+	// them overlap the lower this wants to be.
+	void setGain(unsigned gain) { _gain.setGain(gain); }
+
+	unsigned getActiveGrains() const;
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const { return _isPlaying; } // Even when turned down, see AudioSource.
+
+private:
+	struct Grain
+	{
+		uint32_t       pos;    // In the window, Q16 frames. Wraps round.
+		uint32_t       step;   // Q16.
+		uint32_t       envPos; // In the envelope table, Q16.
+		uint32_t       envStep;
+		const int16_t *envelope;
+		uint16_t       left;   // Frames to go, 0 if it isn't playing.
+		uint16_t       delay;  // Frames into this frame before it starts.
+	};
+
+	WavFile           _wav;
+	GainStage         _gain;
+	Grain             _grains[kMaxGrains];
+	int16_t           _window[kWindowFrames];
+	uint32_t          _head;      // Frames ever written into the window.
+	uint32_t          _scanFrac;  // Part of a frame the scan is ahead by, Q16.
+	uint32_t          _random;
+	unsigned          _nextGrain; // Frames till the next one starts.
+	volatile unsigned _interval;  // Frames between grains, 0 for none.
+	volatile unsigned _position;
+	volatile unsigned _spread;
+	volatile unsigned _length;
+	volatile uint32_t _pitch;
+	volatile uint32_t _scan;
+	volatile uint8_t  _envelope;
+	volatile uint8_t  _maxGrains;
+	volatile bool     _isPlaying;
+	bool              _streamed;
+	unsigned          _scanMax;   // Most frames scan() reads in a frame.
+
+	void scan(uint8_t *scratch);
+	void start(Grain &grain, unsigned delay);
+	void render(Grain &grain, int32_t *mix);
+};
+
+#endif /* AUDIO_GRANULARSOURCE_H_ */
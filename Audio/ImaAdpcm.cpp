@@ -0,0 +1,154 @@
+/*
+ * ImaAdpcm.cpp - IMA ADPCM decoder for WAV files (format 0x11).
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "ImaAdpcm.h"
+
+// How far to move the step index for each code.
+static const int8_t IMA_INDEX[16] =
+{
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Step size for each index.
+static const uint16_t IMA_STEP[89] =
+{
+	    7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+	   19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+	   50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+	  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+	  337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+	  876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+	 2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+	 5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+void ImaAdpcmDecoder::init(unsigned channels, unsigned blockAlign, unsigned dataSize)
+{
+	_channels   = channels == 1 ? 1 : 2;
+	_inputSize  = _channels * 4;
+	_blockAlign = blockAlign;
+	_dataSize   = dataSize;
+	reset();
+}
+
+void ImaAdpcmDecoder::reset()
+{
+	for(unsigned c = 0; c < 2; c++) {
+		_ch[c].predictor = 0;
+		_ch[c].index     = 0;
+	}
+	_blockLeft = 0;
+	_dataLeft  = _dataSize;
+	_pos       = 0;
+	_frames    = 0;
+}
+
+unsigned ImaAdpcmDecoder::samplesPerBlock(unsigned channels, unsigned blockAlign)
+{
+	if(channels == 0 || blockAlign < channels * 4)
+		return 0;
+	return (blockAlign / channels - 4) * 2 + 1;
+}
+
+// Decode samples from..from+count-1 of a group of one channel (4 bytes, low
+// nibble first) into one half of each output frame.
+void ImaAdpcmDecoder::decodeChannel(Channel &ch, const uint8_t *in, unsigned from, unsigned count,
+                                    AUDIOSAMPLE *out, unsigned shift)
+{
+	int32_t predictor = ch.predictor;
+	int32_t index     = ch.index;
+
+	for(unsigned i = from; i < from + count; i++) {
+		unsigned code = (in[i >> 1] >> ((i & 1) << 2)) & 0xF;
+		int32_t  step = IMA_STEP[index];
+
+		int32_t diff = step >> 3;
+		if(code & 1) diff += step >> 2;
+		if(code & 2) diff += step >> 1;
+		if(code & 4) diff += step;
+		if(code & 8)
+			predictor -= diff;
+		else
+			predictor += diff;
+
+		if(predictor > 32767)
+			predictor = 32767;
+		else if(predictor < -32768)
+			predictor = -32768;
+
+		index += IMA_INDEX[code];
+		if(index < 0)
+			index = 0;
+		else if(index > 88)
+			index = 88;
+
+		*out++ |= (uint32_t)(uint16_t)predictor << shift;
+	}
+
+	ch.predictor = predictor;
+	ch.index     = index;
+}
+
+void ImaAdpcmDecoder::decode(const uint8_t *in)
+{
+	if(_blockLeft == 0) {
+		// Block header, the first sample of the block as it is.
+		for(unsigned c = 0; c < _channels; c++) {
+			const uint8_t *h = &in[c * 4];
+			_ch[c].predictor = (int16_t)(h[0] | (h[1] << 8));
+			_ch[c].index     = h[2] > 88 ? 88 : h[2];
+		}
+		_frames    = 1;
+		_blockLeft = _blockAlign - _inputSize;
+	} else {
+		for(unsigned i = 0; i < _inputSize; i++)
+			_in[i] = in[i];
+		_frames     = kGroupFrames;
+		_blockLeft -= _inputSize;
+	}
+	_pos = 0;
+
+	// At the end of the data the next thing is a loop back to the start, so
+	// a new block whether or not the last one was full.
+	_dataLeft -= _inputSize;
+	if(_dataLeft < _inputSize) {
+		_dataLeft  = _dataSize;
+		_blockLeft = 0;
+	}
+}
+
+unsigned ImaAdpcmDecoder::drain(AUDIOSAMPLE *out, unsigned count)
+{
+	unsigned n = _frames - _pos;
+	if(n > count)
+		n = count;
+	if(n == 0)
+		return 0;
+
+	if(_frames == 1) {
+		// A header, the sample is already in the predictors.
+		uint32_t left  = (uint16_t)_ch[0].predictor;
+		uint32_t right = (uint16_t)_ch[_channels - 1].predictor;
+		out[0] = (right << 16) | left;
+	} else {
+		for(unsigned i = 0; i < n; i++)
+			out[i] = 0;
+
+		decodeChannel(_ch[0], _in, _pos, n, out, 0);
+		if(_channels == 2) {
+			decodeChannel(_ch[1], &_in[4], _pos, n, out, 16);
+		} else {
+			for(unsigned i = 0; i < n; i++)
+				out[i] |= out[i] << 16;
+		}
+	}
+
+	_pos += n;
+	return n;
+}
@@ -0,0 +1,79 @@
+/*
+ * ImaAdpcm.h - IMA ADPCM decoder for WAV files (format 0x11).
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_IMAADPCM_H_
+#define AUDIO_IMAADPCM_H_
+
+#include "AudioSource.h"
+
+// IMA ADPCM packs each 16-bit sample into 4 bits, so a file takes a quarter
+// of the card bandwidth of the same thing in PCM. Decoding is a table lookup
+// and a few adds and shifts per sample.
+//
+// A WAV file's ADPCM data is a series of blocks of blockAlign bytes. Each
+// block starts with a 4-byte header per channel (the first sample and the
+// step index), followed by groups of 4 bytes per channel, each group being
+// 8 samples of that channel, channels alternating.
+//
+// The decoder takes one header or group at a time (getInputSize() bytes,
+// the same for both) and decodes it straight into the output frame with
+// drain(), so it can be fed in whatever amounts come off the card and
+// never needs a whole block in RAM. A group can be split over two frames.
+//
+// There is no constructor so it can share space with the other decoders in
+// a union, call init() first.
+class ImaAdpcmDecoder
+{
+public:
+	// dataSize is the size of the data chunk, so the decoder knows where the
+	// blocks start again when a stream loops back to the beginning.
+	void init(unsigned channels, unsigned blockAlign, unsigned dataSize);
+
+	// The next input is the start of a block (after a rewind or seek).
+	void reset();
+
+	unsigned getInputSize() const { return _inputSize; }
+
+	// Take one header or group, getInputSize() bytes. Only call this when
+	// drain() has decoded everything from the last one.
+	void decode(const uint8_t *in);
+
+	// Decode up to count frames into out, returns how many there were.
+	unsigned drain(AUDIOSAMPLE *out, unsigned count);
+
+	bool isDrained() const { return _pos >= _frames; }
+
+	// Samples in a block of blockAlign bytes.
+	static unsigned samplesPerBlock(unsigned channels, unsigned blockAlign);
+
+private:
+	enum {
+		kGroupFrames = 8
+	};
+
+	struct Channel
+	{
+		int16_t predictor;
+		uint8_t index;
+	};
+
+	Channel  _ch[2];
+	uint8_t  _in[8];     // The group being decoded.
+	uint8_t  _channels;
+	uint8_t  _inputSize;
+	uint8_t  _pos;       // Frames of it decoded so far.
+	uint8_t  _frames;    // Frames in it, 1 for a header.
+	uint16_t _blockAlign;
+	uint16_t _blockLeft; // Bytes to the end of this block, 0 if the next input is a header.
+	unsigned _dataSize;
+	unsigned _dataLeft;
+
+	void decodeChannel(Channel &ch, const uint8_t *in, unsigned from, unsigned count, AUDIOSAMPLE *out,
+	                   unsigned shift);
+};
+
+#endif /* AUDIO_IMAADPCM_H_ */
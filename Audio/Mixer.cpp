@@ -0,0 +1,128 @@
+/*
+ * Mixer.cpp - Mix several audio sources down to one.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "Mixer.h"
+#include <string.h>
+
+// cos() over a quarter turn in 1.15 fixed point, for constant power panning.
+static const uint16_t PAN_LAW[Mixer::kPanRight + 1] =
+{
+	0x8000, 0x7FF6, 0x7FD9, 0x7FA7, 0x7F62, 0x7F0A, 0x7E9D, 0x7E1E,
+	0x7D8A, 0x7CE4, 0x7C2A, 0x7B5D, 0x7A7D, 0x798A, 0x7885, 0x776C,
+	0x7642, 0x7505, 0x73B6, 0x7255, 0x70E3, 0x6F5F, 0x6DCA, 0x6C24,
+	0x6A6E, 0x68A7, 0x66D0, 0x64E9, 0x62F2, 0x60EC, 0x5ED7, 0x5CB4,
+	0x5A82, 0x5843, 0x55F6, 0x539B, 0x5134, 0x4EC0, 0x4C40, 0x49B4,
+	0x471D, 0x447B, 0x41CE, 0x3F17, 0x3C57, 0x398D, 0x36BA, 0x33DF,
+	0x30FC, 0x2E11, 0x2B1F, 0x2827, 0x2528, 0x2224, 0x1F1A, 0x1C0C,
+	0x18F9, 0x15E2, 0x12C8, 0x0FAB, 0x0C8C, 0x096B, 0x0648, 0x0324,
+	0x0000
+};
+
+static void panGains(unsigned gain, unsigned pan, unsigned &left, unsigned &right)
+{
+	if(pan > Mixer::kPanRight)
+		pan = Mixer::kPanRight;
+
+	left  = (gain * PAN_LAW[pan]) >> 15;
+	right = (gain * PAN_LAW[Mixer::kPanRight - pan]) >> 15;
+}
+
+Mixer::Mixer()
+	: _nActive(0)
+{
+	for(unsigned i = 0; i < kMaxVoices; i++)
+		_voice[i].source = 0;
+}
+
+Mixer::~Mixer()
+{
+}
+
+int Mixer::addVoice(AudioSource *src, unsigned gain, unsigned pan)
+{
+	for(unsigned i = 0; i < kMaxVoices; i++) {
+		if(_voice[i].source == 0) {
+			// Set the gain first, the audio interrupt can pick the voice up
+			// as soon as the source is set.
+			unsigned left, right;
+			panGains(gain, pan, left, right);
+			_voice[i].gain.jumpTo(left, right);
+			_voice[i].source = src;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void Mixer::removeVoice(AudioSource *src)
+{
+	for(unsigned i = 0; i < kMaxVoices; i++) {
+		if(_voice[i].source == src)
+			_voice[i].source = 0;
+	}
+}
+
+void Mixer::setGain(unsigned voice, unsigned gain, unsigned pan, bool ramp)
+{
+	if(voice >= kMaxVoices)
+		return;
+
+	unsigned left, right;
+	panGains(gain, pan, left, right);
+	if(ramp)
+		_voice[voice].gain.setGain(left, right);
+	else
+		_voice[voice].gain.jumpTo(left, right);
+}
+
+bool Mixer::isActive() const
+{
+	for(unsigned i = 0; i < kMaxVoices; i++) {
+		AudioSource *src = _voice[i].source;
+		if(src && src->isActive())
+			return true;
+	}
+	return false;
+}
+
+void Mixer::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	unsigned nActive = 0;
+
+	for(unsigned i = 0; i < kMaxVoices; i++) {
+		Voice       &v   = _voice[i];
+		AudioSource *src = v.source;
+		if(src == 0 || !src->isActive())
+			continue;
+
+		// The output buffer doubles as scratch space for each voice. A
+		// silent one still has to move on.
+		src->fillBuffer(buffer);
+		if(v.gain.isSilent())
+			continue;
+
+		if(nActive == 0)
+			memset(_mix, 0, sizeof(_mix));
+		v.gain.accumulate(_mix, buffer, kFrameSize);
+		nActive++;
+	}
+
+	_nActive = nActive;
+
+	if(nActive == 0) {
+		memset(buffer, 0, kFrameBytes);
+		return;
+	}
+
+	const int32_t *mix = _mix;
+	for(unsigned i = 0; i < kFrameSize; i++) {
+		int32_t l = saturate16(mix[0]);
+		int32_t r = saturate16(mix[1]);
+		buffer[i] = ((uint32_t)r << 16) | ((uint32_t)l & 0xFFFF);
+		mix += 2;
+	}
+}
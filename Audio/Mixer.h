@@ -0,0 +1,67 @@
+/*
+ * Mixer.h - Mix several audio sources down to one.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_MIXER_H_
+#define AUDIO_MIXER_H_
+
+#include "board.h"
+#include "AudioSource.h"
+#include "GainStage.h"
+
+// Each voice is an AudioSource with its own gain and pan. Every frame the
+// active voices render one at a time into the output buffer, get their gain
+// applied and are added into a 32-bit accumulator, which is then saturated
+// back down to 16 bits at the end. So the mix can go well over full scale
+// part way through without wrapping.
+//
+// A voice whose source says it isn't active (see AudioSource::isActive())
+// costs nothing, its fillBuffer() isn't called at all. A voice turned right
+// down still has its fillBuffer() called, so a file carries on (muting
+// doesn't pause it), but isn't added into the mix.
+//
+// The accumulator is 1k of RAM, so there should only be one of these.
+class Mixer
+	: public AudioSource
+{
+public:
+	enum {
+		kMaxVoices = MIXER_MAX_VOICES,
+		kPanLeft   = 0,
+		kPanCentre = 32,
+		kPanRight  = 64
+	};
+
+	Mixer();
+	virtual ~Mixer();
+
+	// Returns the voice number, or -1 if there are no free voices.
+	int  addVoice(AudioSource *src, unsigned gain = GainStage::kUnity, unsigned pan = kPanCentre);
+	void removeVoice(AudioSource *src);
+
+	// Gain is as for GainStage. Pan is constant power, so a centred voice is
+	// 3dB down in each channel. Changes ramp over a frame unless ramp is false
+	// (for a voice which is just starting).
+	void setGain(unsigned voice, unsigned gain, unsigned pan = kPanCentre, bool ramp = true);
+
+	unsigned getActiveVoices() const { return _nActive; } // How many were mixed in the last frame.
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const;
+
+private:
+	struct Voice
+	{
+		AudioSource *volatile source;
+		GainStage             gain;
+	};
+
+	Voice    _voice[kMaxVoices];
+	unsigned _nActive;
+	int32_t  _mix[kFrameSize * 2]; // Left and right alternately.
+};
+
+#endif /* AUDIO_MIXER_H_ */
@@ -0,0 +1,124 @@
+/*
+ * OscillatorBank.cpp - Oscillators playing the wave tables, mixed together.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "OscillatorBank.h"
+#include "AudioKinetisI2S.h"
+#include "Wavetable.h"
+#include <string.h>
+
+// Add a frame of one oscillator onto the mix. A square is its saw less the
+// same saw half a cycle on.
+template<unsigned kWaveform>
+static uint32_t render(int32_t *mix, const int16_t *table, uint32_t phase, uint32_t increment, int32_t level)
+{
+	for(unsigned i = 0; i < AudioSource::kFrameSize; i++) {
+		int32_t s = Wavetable::lookup(table, phase);
+		if(kWaveform == OscillatorBank::kSquare)
+			s -= Wavetable::lookup(table, phase + 0x80000000u);
+		mix[i] += (s * level) >> 15;
+		phase  += increment;
+	}
+	return phase;
+}
+
+OscillatorBank::OscillatorBank()
+	: _gain(GainStage::kUnity)
+{
+	memset(_osc, 0, sizeof(_osc));
+	for(unsigned i = 0; i < kMaxOscillators; i++)
+		_osc[i].table = g_wavetable.sine;
+}
+
+OscillatorBank::~OscillatorBank()
+{
+}
+
+void OscillatorBank::start(unsigned osc, uint32_t frequency, Waveform waveform, unsigned level)
+{
+	if(osc >= kMaxOscillators)
+		return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_osc[osc].waveform = waveform;
+	setFrequency(osc, frequency);
+	_osc[osc].phase = 0;
+	_osc[osc].level = level;
+	__set_PRIMASK(primask);
+}
+
+void OscillatorBank::stop(unsigned osc)
+{
+	if(osc < kMaxOscillators)
+		_osc[osc].level = 0;
+}
+
+// The increment and the table go together, so they're changed with the
+// audio interrupt held off.
+void OscillatorBank::setFrequency(unsigned osc, uint32_t frequency)
+{
+	if(osc >= kMaxOscillators)
+		return;
+
+	uint32_t       increment = Wavetable::increment(frequency, AudioKinetisI2S::getSampleRate());
+	const int16_t *table     = _osc[osc].waveform == kSine ? g_wavetable.sine : Wavetable::sawFor(increment);
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_osc[osc].increment = increment;
+	_osc[osc].table     = table;
+	__set_PRIMASK(primask);
+}
+
+void OscillatorBank::setLevel(unsigned osc, unsigned level)
+{
+	if(osc < kMaxOscillators)
+		_osc[osc].level = level;
+}
+
+unsigned OscillatorBank::getPlaying() const
+{
+	unsigned n = 0;
+	for(unsigned i = 0; i < kMaxOscillators; i++) {
+		if(_osc[i].level)
+			n++;
+	}
+	return n;
+}
+
+bool OscillatorBank::isActive() const
+{
+	return getPlaying() != 0 && !_gain.isSilent();
+}
+
+void OscillatorBank::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	// Mono in 32 bits, then back to packed stereo in the same buffer.
+	int32_t *mix = (int32_t *)buffer;
+	memset(mix, 0, kFrameBytes);
+
+	for(unsigned i = 0; i < kMaxOscillators; i++) {
+		Oscillator &o = _osc[i];
+		int32_t level = o.level;
+		if(level == 0)
+			continue;
+
+		if(o.waveform == kSine)
+			o.phase = render<kSine>(mix, o.table, o.phase, o.increment, level);
+		else if(o.waveform == kSaw)
+			o.phase = render<kSaw>(mix, o.table, o.phase, o.increment, level);
+		else
+			o.phase = render<kSquare>(mix, o.table, o.phase, o.increment, level);
+	}
+
+	for(unsigned i = 0; i < kFrameSize; i++) {
+		uint32_t s = (uint16_t)saturate16(mix[i]);
+		buffer[i] = (s << 16) | s;
+	}
+
+	_gain.process(buffer, kFrameSize);
+}
@@ -0,0 +1,74 @@
+/*
+ * OscillatorBank.h - Oscillators playing the wave tables, mixed together.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_OSCILLATORBANK_H_
+#define AUDIO_OSCILLATORBANK_H_
+
+#include "AudioSource.h"
+#include "GainStage.h"
+#include "board.h"
+
+// Up to kMaxOscillators oscillators, each at any frequency with its own
+// waveform and level, added together in mono. Each one is a 32-bit phase
+// accumulator (direct digital synthesis) reading one of the Wavetable
+// tables with linear interpolation, so the pitch is exact to a few
+// microhertz and it costs the same at any frequency. Saws and squares read
+// the band-limited table for their octave (see Wavetable.h), picked when
+// the frequency is set.
+//
+// Everything can be changed from the main loop at any time. A new frequency
+// carries on from the same phase so there's no click. It's worked out for
+// the output rate when it's set. See Benchmark for how many of each
+// waveform fit in a frame.
+class OscillatorBank
+	: public AudioSource
+{
+public:
+	enum Waveform {
+		kSine,
+		kSaw,
+		kSquare
+	};
+
+	enum {
+		kMaxOscillators = OSCILLATOR_COUNT
+	};
+
+	OscillatorBank();
+	virtual ~OscillatorBank();
+
+	// Frequency is Q16.16 Hz. Level is 1.15, the oscillators add up so
+	// several of them at kUnity can saturate.
+	void start(unsigned osc, uint32_t frequency, Waveform waveform = kSine, unsigned level = GainStage::kUnity);
+	void stop(unsigned osc);
+	void setFrequency(unsigned osc, uint32_t frequency);
+	void setLevel(unsigned osc, unsigned level);
+
+	bool     isPlaying(unsigned osc) const { return osc < kMaxOscillators && _osc[osc].level != 0; }
+	unsigned getPlaying() const;
+
+	// Volume of the whole bank, see GainStage for the units.
+	void setGain(unsigned gain) { _gain.setGain(gain); }
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const;
+
+private:
+	struct Oscillator
+	{
+		uint32_t                phase;
+		volatile uint32_t       increment;
+		const int16_t *volatile table;
+		volatile uint16_t       level; // 0 when it's off.
+		volatile uint8_t        waveform;
+	};
+
+	Oscillator _osc[kMaxOscillators];
+	GainStage  _gain;
+};
+
+#endif /* AUDIO_OSCILLATORBANK_H_ */
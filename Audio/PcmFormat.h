@@ -0,0 +1,45 @@
+/*
+ * PcmFormat.h - Convert PCM samples from WAV files to 16-bit stereo.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_PCMFORMAT_H_
+#define AUDIO_PCMFORMAT_H_
+
+#include "AudioSource.h"
+
+// One sample of kBits as a signed 16-bit value. 8-bit WAV samples are
+// unsigned, 24-bit ones just lose their low byte.
+template<unsigned kBits> inline int32_t pcmSample(const uint8_t *p);
+
+template<> inline int32_t pcmSample<8>(const uint8_t *p)  { return (int16_t)((p[0] ^ 0x80) << 8); }
+template<> inline int32_t pcmSample<16>(const uint8_t *p) { return (int16_t)(p[0] | (p[1] << 8)); }
+template<> inline int32_t pcmSample<24>(const uint8_t *p) { return (int16_t)(p[1] | (p[2] << 8)); }
+
+// A kernel for each format, so the compiler makes a tight loop of each
+// with the bit depth and channel count built in. WavSource picks the one it
+// needs when the file is opened. Mono is played in both channels.
+template<unsigned kBits, unsigned kChannels>
+struct PcmFormat
+{
+	enum {
+		kBytes = kBits / 8 * kChannels // One frame in the file.
+	};
+
+	// Works in place if the input is at the end of the output buffer, as
+	// long as kBytes isn't more than an AUDIOSAMPLE. Each frame is read
+	// before anything is written over it.
+	static void convert(AUDIOSAMPLE *out, const uint8_t *in, unsigned frames)
+	{
+		for(unsigned i = 0; i < frames; i++) {
+			uint32_t left  = (uint16_t)pcmSample<kBits>(in);
+			uint32_t right = kChannels == 2 ? (uint16_t)pcmSample<kBits>(in + kBits / 8) : left;
+			out[i] = (right << 16) | left;
+			in += kBytes;
+		}
+	}
+};
+
+#endif /* AUDIO_PCMFORMAT_H_ */
@@ -0,0 +1,154 @@
+/*
+ * PluckSource.cpp - Plucked string voice, Karplus-Strong.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "PluckSource.h"
+#include "AudioKinetisI2S.h"
+#include <string.h>
+
+// Damping while muted, the string loses a quarter each time round.
+#define PLUCK_MUTE_DAMPING 0x6000
+
+// Once the output has been under this for the whole loop the string is
+// stopped. The loop filter's rounding leaves it sitting at a count or so
+// rather than dying right away to nothing.
+#define PLUCK_SILENCE 16
+
+PluckSource::PluckSource()
+	: _gain(GainStage::kUnity)
+	, _length(2)
+	, _pos(0)
+	, _last(0)
+	, _apIn(0)
+	, _apOut(0)
+	, _apCoef(0)
+	, _random(0x12345678)
+	, _frequency(0)
+	, _level(0)
+	, _brightness(kMaxBrightness)
+	, _damping(0x7FF0)
+	, _pending(false)
+	, _mute(false)
+	, _isRinging(false)
+	, _quiet(0)
+{
+	memset(_delay, 0, sizeof(_delay));
+}
+
+PluckSource::~PluckSource()
+{
+}
+
+void PluckSource::pluck(uint32_t frequency, unsigned level, unsigned brightness)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_frequency  = frequency;
+	_level      = level < GainStage::kUnity ? level : GainStage::kUnity;
+	_brightness = brightness < kMaxBrightness ? brightness : kMaxBrightness;
+	_mute       = false;
+	_pending    = true;
+	__set_PRIMASK(primask);
+}
+
+// Called from fillBuffer() so the delay line only ever belongs to the audio
+// interrupt.
+//
+// The loop is _length samples of delay line, half a sample more from the
+// averaging filter and whatever's left over of the period from the all pass,
+// which is kept between half and one and a half samples. At low frequencies
+// an all pass with coefficient (1 - d) / (1 + d) delays by d.
+void PluckSource::start()
+{
+	unsigned rate   = AudioKinetisI2S::getSampleRate();
+	uint32_t period = _frequency ? (uint32_t)(((uint64_t)rate << 32) / _frequency) : 0; // Q16 samples.
+
+	unsigned length = (period >> 16) - 1;
+	if(period < (3 << 16)) {
+		length = 2;
+		period = 3 << 16;
+	} else if(length > kDelayFrames) {
+		length = kDelayFrames;
+		period = (kDelayFrames + 1) << 16;
+	}
+
+	int32_t d = period - (length << 16) - 0x8000; // Q16, 0.5 to 1.5.
+	_apCoef = ((0x10000 - d) * 0x8000) / (0x10000 + d);
+	_length = length;
+	_pos    = 0;
+	_last   = 0;
+	_apIn   = 0;
+	_apOut  = 0;
+	_quiet  = 0;
+
+	// Noise, low passed as much as the brightness says.
+	int32_t  level  = _level;
+	int32_t  bright = _brightness;
+	int32_t  lp     = 0;
+	uint32_t random = _random;
+	for(unsigned i = 0; i < length; i++) {
+		random = random * 1664525 + 1013904223;
+		int32_t noise = ((int32_t)random >> 16) * level >> 15;
+		lp += ((noise - lp) * bright) >> 15;
+		_delay[i] = lp;
+	}
+	_random = random;
+
+	_pending   = false;
+	_isRinging = true;
+}
+
+void PluckSource::fillBuffer(AUDIOSAMPLE *buffer)
+{
+	if(_pending)
+		start();
+
+	if(!_isRinging) {
+		memset(buffer, 0, kFrameBytes);
+		return;
+	}
+
+	int32_t  damping = _mute ? PLUCK_MUTE_DAMPING : _damping;
+	int32_t  coef    = _apCoef;
+	int32_t  last    = _last;
+	int32_t  apIn    = _apIn;
+	int32_t  apOut   = _apOut;
+	unsigned pos     = _pos;
+	unsigned length  = _length;
+	int32_t  peak    = 0;
+
+	for(unsigned i = 0; i < kFrameSize; i++) {
+		int32_t x = _delay[pos];
+
+		// Average with the one before and lose a little, then the all pass.
+		int32_t y = ((x + last) * damping) >> 16;
+		last  = x;
+		apOut = (((y - apOut) * coef) >> 15) + apIn;
+		apIn  = y;
+		_delay[pos] = saturate16(apOut);
+		if(++pos == length)
+			pos = 0;
+
+		peak |= x ^ (x >> 31);
+		uint32_t s = (uint16_t)x;
+		buffer[i] = (s << 16) | s;
+	}
+
+	_last  = last;
+	_apIn  = apIn;
+	_apOut = apOut;
+	_pos   = pos;
+
+	// Stop once a whole trip round the loop has been quiet.
+	if(peak < PLUCK_SILENCE) {
+		_quiet += kFrameSize;
+		if(_quiet >= length)
+			_isRinging = false;
+	} else
+		_quiet = 0;
+
+	_gain.process(buffer, kFrameSize);
+}
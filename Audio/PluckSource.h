@@ -0,0 +1,83 @@
+/*
+ * PluckSource.h - Plucked string voice, Karplus-Strong.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_PLUCKSOURCE_H_
+#define AUDIO_PLUCKSOURCE_H_
+
+#include "AudioSource.h"
+#include "GainStage.h"
+#include "board.h"
+
+// A burst of noise goes round a delay line one period of the note long, and
+// each time round it's averaged with the sample before (a gentle low pass)
+// and turned down a little, so it settles into a decaying, darkening string
+// sound. Nothing is read from the card, it's all integer maths on the delay
+// line.
+//
+// The delay line is a whole number of samples, so the rest of the period
+// is made up by a first order all pass filter, which keeps high notes in
+// tune (a whole sample is 39 cents at 1kHz). The lowest note is where the
+// period fills the delay line, 86Hz with the default PLUCK_DELAY_FRAMES.
+//
+// pluck() can be called from the main loop at any time, the string is
+// filled at the start of the next frame. Once it has died away isActive()
+// is false, so a Mixer skips it until it's plucked again.
+class PluckSource
+	: public AudioSource
+{
+public:
+	enum {
+		kDelayFrames   = PLUCK_DELAY_FRAMES,
+		kMaxDamping    = 0x8000, // Q15, 1.0 means the averaging filter only.
+		kMaxBrightness = 0x8000
+	};
+
+	PluckSource();
+	virtual ~PluckSource();
+
+	// Frequency is Q16.16 Hz. Brightness (Q15) is how much of the noise is
+	// left unfiltered: kMaxBrightness is all of it, lower is a softer pluck.
+	void pluck(uint32_t frequency, unsigned level = GainStage::kUnity, unsigned brightness = kMaxBrightness);
+
+	// How much is kept each time round (Q15). 0x7FF0 rings for seconds at
+	// the bottom, lower is a shorter string. High notes go round more often
+	// so they die away quicker, like a real one. Takes effect at the next
+	// frame.
+	void setDamping(unsigned damping) { _damping = damping < kMaxDamping ? damping : kMaxDamping; }
+
+	// Damp the string, it dies away in a few frames.
+	void mute() { _mute = true; }
+
+	// Volume, see GainStage for the units.
+	void setGain(unsigned gain) { _gain.setGain(gain); }
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const { return _isRinging || _pending; }
+
+private:
+	int16_t           _delay[kDelayFrames];
+	GainStage         _gain;
+	unsigned          _length;     // Of the loop, in samples.
+	unsigned          _pos;
+	int32_t           _last;       // The sample before, for the averaging filter.
+	int32_t           _apIn;       // All pass filter state.
+	int32_t           _apOut;
+	int32_t           _apCoef;     // Q15, from the fraction of a sample.
+	uint32_t          _random;
+	volatile uint32_t _frequency;  // Of the pending pluck.
+	volatile uint16_t _level;
+	volatile uint16_t _brightness;
+	volatile uint16_t _damping;
+	volatile bool     _pending;
+	volatile bool     _mute;
+	bool              _isRinging;
+	unsigned          _quiet;      // Samples in a row that were nearly silent.
+
+	void start();
+};
+
+#endif /* AUDIO_PLUCKSOURCE_H_ */
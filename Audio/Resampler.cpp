@@ -0,0 +1,270 @@
+/*
+ * Resampler.cpp - Sample rate converter for WAV files not at the output rate.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "Resampler.h"
+#include "ConstexprMath.h"
+#include "GainStage.h"
+#include <string.h>
+
+#define HALF_TAPS (Resampler::kTaps / 2)
+
+// Pass band as a fraction of the input's Nyquist frequency. It has to stop
+// short of the output's Nyquist frequency for 48k files, which are the only
+// ones going down. The others lose a little at the very top, above 14kHz
+// for 32k material.
+#define CUTOFF 0.9
+
+// Blackman window over the kTaps frames around the output.
+static constexpr double window(double d)
+{
+	return 0.42 + 0.5 * ConstexprMath::cos(ConstexprMath::kPi * d / HALF_TAPS)
+	            + 0.08 * ConstexprMath::cos(2 * ConstexprMath::kPi * d / HALF_TAPS);
+}
+
+// Row p is for an output p / kPhases of the way from input i to i + 1, and
+// its taps are for inputs i - 3 to i + 4. Each row adds up to unity so there
+// is no ripple at DC between phases.
+struct ResamplerCoefficients
+{
+	int16_t c[Resampler::kPhases][Resampler::kTaps];
+
+	constexpr ResamplerCoefficients()
+		: c()
+	{
+		for(unsigned p = 0; p < Resampler::kPhases; p++) {
+			double h[Resampler::kTaps] = { };
+			double sum = 0;
+			for(unsigned t = 0; t < Resampler::kTaps; t++) {
+				double d = (HALF_TAPS - 1.0 - t) + (double)p / Resampler::kPhases;
+				h[t] = CUTOFF * ConstexprMath::sinc(CUTOFF * d) * window(d);
+				sum += h[t];
+			}
+			for(unsigned t = 0; t < Resampler::kTaps; t++)
+				c[p][t] = ConstexprMath::round(h[t] / sum * 32767);
+		}
+	}
+};
+
+static constexpr ResamplerCoefficients s_coef;
+
+AUDIOSAMPLE Resampler::s_input[kTaps + kMaxInput];
+
+bool Resampler::isNeeded(unsigned rate, unsigned outRate)
+{
+	unsigned diff = rate > outRate ? rate - outRate : outRate - rate;
+	return diff * 1000 > outRate;
+}
+
+Resampler::Resampler()
+	: _pos(kTaps << 16)
+	, _step(0x10000)
+	, _rate(0x10000)
+	, _speed(kUnitySpeed)
+	, _speeds(0)
+	, _speedIndex(0)
+	, _interpolation(kPolyphase)
+{
+}
+
+void Resampler::init(unsigned rate, unsigned outRate)
+{
+	setRate(rate, outRate);
+	reset();
+}
+
+// Carries straight on from the old input, for one file following another.
+void Resampler::setRate(unsigned rate, unsigned outRate)
+{
+	if(rate > kMaxRate)
+		rate = kMaxRate;
+	_rate = (rate << 16) / outRate;
+	if(_rate > kMaxStep)
+		_rate = kMaxStep;
+	_step = getTarget();
+}
+
+// 0 stops it dead, which is allowed.
+void Resampler::setSpeed(uint32_t speed)
+{
+	_speed = speed < kMaxSpeed ? speed : kMaxSpeed;
+}
+
+// The first output lands on the first input, with silence before it.
+void Resampler::reset()
+{
+	memset(_history, 0, sizeof(_history));
+	_pos = kTaps << 16;
+}
+
+uint32_t Resampler::getStep(unsigned n) const
+{
+	uint32_t speed = _speeds[_speedIndex + n];
+	if(speed > kMaxSpeed)
+		speed = kMaxSpeed;
+	return (_rate * (speed >> 4)) >> 12;
+}
+
+// As many outputs as the window has room for the input of. That's kChunk
+// unless it's going faster than kMaxStep. With setSpeedInput() the steps
+// all differ, so it walks through them, and stops at the end of the frame's
+// speeds.
+unsigned Resampler::getMaxOutput() const
+{
+	if(_speeds) {
+		unsigned most = AudioSource::kFrameSize - _speedIndex;
+		if(most > kChunk)
+			most = kChunk;
+
+		uint32_t pos  = _pos;
+		unsigned last = kMaxInput + kTaps - HALF_TAPS - 1; // The furthest output the window reaches.
+		unsigned n;
+		for(n = 0; n < most && (pos >> 16) <= last; n++)
+			pos += getStep(n);
+		return n;
+	}
+
+	if(_step <= kMaxStep)
+		return kChunk;
+	return ((kMaxInput - 2) << 16) / _step;
+}
+
+// Up to the last input the last output's taps reach.
+unsigned Resampler::getInputNeeded(unsigned count) const
+{
+	uint32_t pos = _pos;
+	if(!_speeds)
+		pos += (count - 1) * _step;
+	else for(unsigned n = 0; n + 1 < count; n++)
+		pos += getStep(n);
+
+	unsigned need = (pos >> 16) + HALF_TAPS + 1 - kTaps;
+	return need < kMaxInput ? need : kMaxInput;
+}
+
+static inline int32_t left(AUDIOSAMPLE x)  { return (int16_t)x; }
+static inline int32_t right(AUDIOSAMPLE x) { return (int32_t)x >> 16; }
+
+static inline AUDIOSAMPLE stereo(int32_t l, int32_t r)
+{
+	return ((uint32_t)(uint16_t)r << 16) | (uint16_t)l;
+}
+
+// Each of these makes the output pos (Q16) of the way from x[0] to x[1].
+
+static inline AUDIOSAMPLE polyphase(const AUDIOSAMPLE *x, uint32_t pos)
+{
+	const int16_t *h = s_coef.c[(pos >> (16 - Resampler::kPhaseBits)) & (Resampler::kPhases - 1)];
+	x -= HALF_TAPS - 1;
+
+	int32_t l = 0x4000; // Round.
+	int32_t r = 0x4000;
+	for(unsigned t = 0; t < Resampler::kTaps; t++) {
+		l += left(x[t]) * h[t];
+		r += right(x[t]) * h[t];
+	}
+	return stereo(saturate16(l >> 15), saturate16(r >> 15));
+}
+
+// Q14 so the difference times the fraction fits in 32 bits.
+static inline AUDIOSAMPLE linear(const AUDIOSAMPLE *x, uint32_t pos)
+{
+	int32_t t = (pos & 0xFFFF) >> 2;
+	int32_t l = left(x[0]) + (((left(x[1]) - left(x[0])) * t) >> 14);
+	int32_t r = right(x[0]) + (((right(x[1]) - right(x[0])) * t) >> 14);
+	return stereo(l, r);
+}
+
+// 4-point, 3rd-order Hermite through x[-1] to x[2]. The coefficients are
+// twice the usual ones to keep them whole, and t is Q10 so nothing
+// overflows even at full scale.
+static inline int32_t hermite1(int32_t xm1, int32_t x0, int32_t x1, int32_t x2, int32_t t)
+{
+	int32_t c1 = x1 - xm1;
+	int32_t c2 = 2 * xm1 - 5 * x0 + 4 * x1 - x2;
+	int32_t c3 = x2 - xm1 + 3 * (x0 - x1);
+	return saturate16(x0 + ((((((((c3 * t) >> 10) + c2) * t) >> 10) + c1) * t) >> 11));
+}
+
+static inline AUDIOSAMPLE hermite(const AUDIOSAMPLE *x, uint32_t pos)
+{
+	int32_t t = (pos & 0xFFFF) >> 6;
+	return stereo(hermite1(left(x[-1]), left(x[0]), left(x[1]), left(x[2]), t),
+	              hermite1(right(x[-1]), right(x[0]), right(x[1]), right(x[2]), t));
+}
+
+// Every kind has the same window, kTaps/2 inputs either side, whether it
+// uses them all or not. With speeds, each output has its own step, worked
+// out the same as getTarget(), and step is left at the last one.
+template<AUDIOSAMPLE (*kInterpolate)(const AUDIOSAMPLE *, uint32_t), bool kSpeeds>
+static unsigned run(AUDIOSAMPLE *out, unsigned count, const AUDIOSAMPLE *in, unsigned avail,
+                    uint32_t &pos, uint32_t &step, const uint32_t *speeds, uint32_t rate)
+{
+	unsigned n;
+	for(n = 0; n < count; n++) {
+		unsigned i = pos >> 16;
+		if(i + HALF_TAPS >= avail)
+			break;
+
+		out[n] = kInterpolate(&in[i], pos);
+		if(kSpeeds) {
+			uint32_t speed = speeds[n];
+			if(speed > Resampler::kMaxSpeed)
+				speed = Resampler::kMaxSpeed;
+			step = (rate * (speed >> 4)) >> 12;
+		}
+		pos += step;
+	}
+	return n;
+}
+
+template<AUDIOSAMPLE (*kInterpolate)(const AUDIOSAMPLE *, uint32_t)>
+static unsigned run(AUDIOSAMPLE *out, unsigned count, const AUDIOSAMPLE *in, unsigned avail,
+                    uint32_t &pos, uint32_t &step, const uint32_t *speeds, uint32_t rate)
+{
+	if(speeds)
+		return run<kInterpolate, true>(out, count, in, avail, pos, step, speeds, rate);
+	return run<kInterpolate, false>(out, count, in, avail, pos, step, speeds, rate);
+}
+
+unsigned Resampler::process(AUDIOSAMPLE *out, unsigned count, unsigned got)
+{
+	memcpy(s_input, _history, sizeof(_history));
+
+	unsigned avail = kTaps + got;
+	uint32_t pos   = _pos;
+	unsigned n;
+
+	// getMaxOutput() keeps a run inside the frame's speeds.
+	const uint32_t *speeds = _speeds ? &_speeds[_speedIndex] : 0;
+
+	if(_interpolation == kLinear)
+		n = run<linear>(out, count, s_input, avail, pos, _step, speeds, _rate);
+	else if(_interpolation == kHermite)
+		n = run<hermite>(out, count, s_input, avail, pos, _step, speeds, _rate);
+	else
+		n = run<polyphase>(out, count, s_input, avail, pos, _step, speeds, _rate);
+
+	// The newest kTaps frames are what the next outputs start from.
+	memcpy(_history, &s_input[got], sizeof(_history));
+	_pos = pos - (got << 16);
+
+	if(_speeds) {
+		_speedIndex += n;
+		if(_speedIndex == AudioSource::kFrameSize)
+			_speedIndex = 0; // Round again if nobody calls startFrame().
+		return n;
+	}
+
+	// Glide a quarter of the way to the new speed each run.
+	uint32_t target = getTarget();
+	if(_step < target)
+		_step += (target - _step + 3) >> 2;
+	else
+		_step -= (_step - target + 3) >> 2;
+
+	return n;
+}
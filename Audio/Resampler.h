@@ -0,0 +1,121 @@
+/*
+ * Resampler.h - Sample rate converter for WAV files not at the output rate.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_RESAMPLER_H_
+#define AUDIO_RESAMPLER_H_
+
+#include "AudioSource.h"
+
+// Converts 16-bit stereo at a file's sample rate to the output rate so 48k,
+// 32k and 22.05k files play at the right pitch. It's a polyphase FIR: each
+// output is kTaps input frames times one of kPhases sets of windowed sinc
+// coefficients, picked by where the output falls between two inputs. The
+// coefficients are Q15, worked out by the compiler (see Resampler.cpp) and
+// kept in flash. The position is a Q16 fraction of an
+// input frame, so the ratio comes out right to a few parts per million.
+//
+// The input is pulled through a small window rather than pushed: ask
+// getInputNeeded() how many frames it takes to make count outputs, decode
+// that many into getInput() and then process() them. Only the last kTaps
+// input frames are kept between calls, the rest of the window is static and
+// shared by all the voices, which is fine since the audio interrupt fills
+// one voice at a time. Outputs go in runs of up to getMaxOutput() so the
+// window stays small.
+//
+// It also does varispeed, playing faster or slower (pitch and all) at any
+// speed up to kMaxSpeed. setSpeed() is control rate: every output in a run
+// of up to kChunk (0.7ms) uses the same step, and after each run the step
+// moves a quarter of the way to the new setting, so it gets within 1% in
+// about 16 runs (12ms). That's smooth enough to change every frame for
+// bends and slow vibrato. For anything faster, audio rate FM say, give it
+// a speed for every output with setSpeedInput() instead.
+// Linear or 4-point Hermite interpolation can be used instead of the FIR
+// for varispeed. They're cheaper, and going any faster than 48k to 44.1k
+// the FIR doesn't stop aliasing properly either.
+// The input is used up speed times faster, so a streamed file needs that
+// much more card bandwidth and room in its ring. 48k 16-bit stereo at
+// normal speed fits the default ring (see STREAM_RING_SECTORS).
+class Resampler
+{
+public:
+	enum Interpolation {
+		kPolyphase, // The FIR, best quality.
+		kLinear,
+		kHermite
+	};
+
+	enum {
+		kTaps      = 8,
+		kPhaseBits = 6,
+		kPhases    = 1 << kPhaseBits,
+		kChunk     = 32,    // Most outputs one process() makes.
+		kMaxRate   = 48000, // Fastest input rate, at the default output rate.
+		kMaxStep   = kMaxRate * 0x10000u / AudioSource::kSampleRate, // Most inputs per output, Q16.
+		kMaxInput  = kChunk * kMaxRate / AudioSource::kSampleRate + 3,
+		kUnitySpeed = 0x10000,         // Q16.16
+		kMaxSpeed   = 4 * kUnitySpeed  // Two octaves up.
+	};
+
+	// False for rates close enough to the output rate to play as they are
+	// (44.1kHz is 0.04% out of 44117Hz, under a cent).
+	static bool isNeeded(unsigned rate, unsigned outRate);
+
+	// False if the input is too fast for the window. The output rate can be
+	// changed (see AudioKinetisI2S::setSampleRate()).
+	static bool isSupported(unsigned rate, unsigned outRate)
+	{
+		return rate <= kMaxRate && (rate << 16) / outRate <= kMaxStep;
+	}
+
+	Resampler();
+
+	// The speed and interpolation stay as they were.
+	void init(unsigned rate, unsigned outRate);
+	void setRate(unsigned rate, unsigned outRate); // Without reset().
+	void reset(); // Forget the old input, for a new start.
+
+	void     setSpeed(uint32_t speed);
+	uint32_t getSpeed() const { return _speed; }
+
+	// Audio rate speed. speeds is kFrameSize Q16.16 speeds, one for each
+	// output from startFrame() on, used instead of setSpeed()'s with no
+	// glide. The caller fills it in before each frame, from an oscillator
+	// say. 0 goes back to setSpeed(), gliding from wherever it got to.
+	// Each speed costs a multiply and runs are worked out a step at a time,
+	// so it's dearer than setSpeed() (see Benchmark).
+	void            setSpeedInput(const uint32_t *speeds) { _speeds = speeds; _speedIndex = 0; }
+	const uint32_t *getSpeedInput() const { return _speeds; }
+	void            startFrame() { _speedIndex = 0; }
+
+	void     setInterpolation(Interpolation interpolation) { _interpolation = interpolation; }
+
+	unsigned     getMaxOutput() const;
+	unsigned     getInputNeeded(unsigned count) const;
+	AUDIOSAMPLE *getInput() const { return &s_input[kTaps]; }
+
+	// Make up to count frames of output from got frames of input (which
+	// should be what getInputNeeded() said). Fewer than count if got was
+	// short; whatever input is left over still gets used next time.
+	unsigned process(AUDIOSAMPLE *out, unsigned count, unsigned got);
+
+private:
+	AUDIOSAMPLE _history[kTaps]; // The last input frames.
+	uint32_t    _pos;            // Of the next output, Q16 frames from _history[0].
+	uint32_t    _step;           // Input frames per output now, Q16.
+	uint32_t    _rate;           // Input rate / output rate, Q16.
+	uint32_t    _speed;
+	const uint32_t *_speeds;     // From setSpeedInput(), or 0.
+	uint8_t     _speedIndex;     // Of the next output's speed.
+	uint8_t     _interpolation;
+
+	uint32_t getTarget() const { return (_rate * (_speed >> 4)) >> 12; }
+	uint32_t getStep(unsigned n) const; // The step after output n with setSpeedInput().
+
+	static AUDIOSAMPLE s_input[kTaps + kMaxInput];
+};
+
+#endif /* AUDIO_RESAMPLER_H_ */
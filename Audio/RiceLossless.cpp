@@ -0,0 +1,174 @@
+/*
+ * RiceLossless.cpp - Lossless sample decoder, fixed prediction plus Rice codes.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "RiceLossless.h"
+
+#define BUF_MASK (kBufSize - 1)
+
+void RiceDecoder::init(unsigned channels, unsigned blockAlign, unsigned dataSize)
+{
+	_channels   = channels == 1 ? 1 : 2;
+	_blockAlign = blockAlign;
+	_dataSize   = dataSize;
+	reset();
+}
+
+void RiceDecoder::reset()
+{
+	_dataLeft = _dataSize;
+	startBlock();
+}
+
+void RiceDecoder::startBlock()
+{
+	_acc       = 0;
+	_accBits   = 0;
+	_rd        = 0;
+	_wr        = 0;
+	_header    = true;
+	_skip      = false;
+	_frames    = 0;
+	_pos       = 0;
+	_blockLeft = _blockAlign;
+}
+
+void RiceDecoder::decode(const uint8_t *in)
+{
+	_blockLeft -= 4;
+
+	// At the end of the data the next thing is a loop back to the start,
+	// so a new block whether or not the last one was full.
+	_dataLeft -= 4;
+	if(_dataLeft < 4) {
+		_dataLeft  = _dataSize;
+		_blockLeft = 0;
+	}
+
+	if(_skip) {
+		// Padding at the end of the block.
+		if(_blockLeft == 0)
+			startBlock();
+		return;
+	}
+
+	for(unsigned i = 0; i < 4; i++)
+		_buf[(_wr++) & BUF_MASK] = in[i];
+}
+
+// Take n bits (up to 20). Past the end of what has been fed in they are
+// zeros, which only happens with a broken file.
+uint32_t RiceDecoder::readBits(unsigned n)
+{
+	while(_accBits <= 24 && _rd != _wr) {
+		_acc |= (uint32_t)_buf[(_rd++) & BUF_MASK] << (24 - _accBits);
+		_accBits += 8;
+	}
+	if(_accBits < n)
+		_accBits = n;
+
+	uint32_t v = _acc >> (32 - n);
+	_acc <<= n;
+	_accBits -= n;
+	return v;
+}
+
+int32_t RiceDecoder::readSample(Channel &ch, unsigned rawBits)
+{
+	int32_t x;
+
+	if(ch.order == kOrderRaw || _pos < ch.order) {
+		// Stored as it is, sign extend it.
+		x = (int32_t)(readBits(rawBits) << (32 - rawBits)) >> (32 - rawBits);
+	} else {
+		unsigned q = 0;
+		while(q < kEscape && readBits(1))
+			q++;
+
+		uint32_t u;
+		if(q == kEscape)
+			u = readBits(kEscapeBits);
+		else
+			u = (q << ch.k) | (ch.k ? readBits(ch.k) : 0);
+
+		int32_t err = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+
+		if(ch.order == 0)
+			x = err;
+		else if(ch.order == 1)
+			x = ch.h1 + err;
+		else
+			x = 2 * ch.h1 - ch.h2 + err;
+	}
+
+	ch.h2 = ch.h1;
+	ch.h1 = x;
+	return x;
+}
+
+void RiceDecoder::readHeader()
+{
+	_frames = readBits(16);
+	_side   = readBits(1) && _channels == 2;
+	for(unsigned c = 0; c < 2; c++) {
+		_ch[c].order = readBits(2);
+		_ch[c].k     = readBits(5);
+		if(_ch[c].k > kEscapeBits)
+			_ch[c].k = kEscapeBits;
+		_ch[c].h1 = 0;
+		_ch[c].h2 = 0;
+	}
+	_pos    = 0;
+	_header = false;
+}
+
+// All the frames are out, the rest of the block is padding.
+void RiceDecoder::endBlock()
+{
+	if(_blockLeft == 0) {
+		startBlock();
+	} else {
+		_skip    = true;
+		_acc     = 0;
+		_accBits = 0;
+		_rd      = _wr;
+	}
+}
+
+unsigned RiceDecoder::drain(AUDIOSAMPLE *out, unsigned count)
+{
+	unsigned n = 0;
+
+	while(n < count && !_skip) {
+		if(_header) {
+			if(!hasBits(kHeaderBits))
+				break;
+			readHeader();
+		}
+
+		if(_frames == 0) {
+			endBlock();
+			continue;
+		}
+
+		if(!hasBits(kMaxFrameBits))
+			break;
+
+		int32_t left  = readSample(_ch[0], 16);
+		int32_t right = left;
+		if(_channels == 2) {
+			right = readSample(_ch[1], _side ? 17 : 16);
+			if(_side)
+				right = left - right;
+		}
+		out[n++] = ((uint32_t)(uint16_t)right << 16) | (uint16_t)left;
+
+		_pos++;
+		_frames--;
+	}
+
+	return n;
+}
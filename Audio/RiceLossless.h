@@ -0,0 +1,112 @@
+/*
+ * RiceLossless.h - Lossless sample decoder, fixed prediction plus Rice codes.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_RICELOSSLESS_H_
+#define AUDIO_RICELOSSLESS_H_
+
+#include "AudioSource.h"
+
+// 16-bit samples compressed without loss to about half the size, for when
+// ADPCM doesn't sound good enough. tools/wav2rice.py makes the files. They
+// are WAV files with format tag kFormatRice (see WavFile.h), so they are
+// opened, streamed and cached just like any other.
+//
+// The data is a series of blocks of blockAlign bytes (512 by default, and
+// the encoder puts the data chunk on a sector boundary so each block is one
+// sector on the card). Every block stands alone, so playback can start or
+// loop at any block. A block is a bitstream, most significant bit first:
+//
+//   16 bits   frames in the block
+//    1 bit    stereo mode, 0 = left and right, 1 = left and side (L - R)
+//   per channel:
+//    2 bits   predictor order 0 to 2, or 3 for samples stored as they are
+//    5 bits   Rice parameter k
+//   then the frames, each channel in turn within a frame
+//
+// Within a block each channel predicts each sample from the last one or two
+// (order 1 is x[n-1], order 2 is 2x[n-1] - x[n-2]) and stores the error
+// zigzagged to unsigned and Rice coded: the value >> k in unary (ones ended
+// by a zero), then the low k bits. 15 ones with no zero is an escape and
+// the value follows in full. The first order samples of the block are
+// stored as they are, 16 bits (17 for a side channel). The rest of the
+// block after the last frame is padding, except that the last block of the
+// data is cut short after its last whole word, so a loop back to the start
+// doesn't have to get through a block of padding.
+//
+// Like ImaAdpcmDecoder, it is fed getInputSize() bytes at a time and
+// decodes straight into the output frame, so a block is never held in RAM.
+// The decoder holds just enough bits for the biggest possible frame. No
+// constructor either, call init() first.
+class RiceDecoder
+{
+public:
+	enum {
+		kMinBlockAlign = 16
+	};
+
+	// dataSize is the size of the data chunk, so the decoder knows where the
+	// blocks start again when a stream loops back to the beginning.
+	void init(unsigned channels, unsigned blockAlign, unsigned dataSize);
+
+	// The next input is the start of a block (after a rewind or seek).
+	void reset();
+
+	unsigned getInputSize() const { return 4; }
+
+	// Take the next getInputSize() bytes. Only call this when drain() has
+	// decoded as much as it can.
+	void decode(const uint8_t *in);
+
+	// Decode up to count frames into out, returns how many there were.
+	// Fewer than count means it needs more input.
+	unsigned drain(AUDIOSAMPLE *out, unsigned count);
+
+private:
+	enum {
+		kBufSize      = 16,                // Bytes, a power of two.
+		kMaxFrameBits = 2 * (15 + 20),     // Two escaped samples.
+		kHeaderBits   = 16 + 1 + 2 * 7,
+		kOrderRaw     = 3,
+		kEscape       = 15,
+		kEscapeBits   = 20
+	};
+
+	struct Channel
+	{
+		int32_t h1; // Last sample.
+		int32_t h2; // The one before.
+		uint8_t order;
+		uint8_t k;
+	};
+
+	Channel  _ch[2];
+	uint32_t _acc;       // Bits not yet used, top aligned.
+	uint8_t  _accBits;
+	uint8_t  _buf[kBufSize];
+	uint8_t  _rd;        // Bytes ever taken from _buf and put in _acc.
+	uint8_t  _wr;        // Bytes ever put in _buf.
+	uint8_t  _channels;
+	bool     _header;    // Next thing in the block is its header.
+	bool     _skip;      // All the frames decoded, throwing away the padding.
+	bool     _side;
+	uint16_t _frames;    // Frames left in the block.
+	uint16_t _pos;       // Frames decoded from the block so far.
+	uint16_t _blockAlign;
+	uint16_t _blockLeft; // Bytes of the block not yet fed in.
+	unsigned _dataSize;
+	unsigned _dataLeft;
+
+	unsigned getAvailable() const { return _accBits + ((uint8_t)(_wr - _rd) << 3); }
+	bool     hasBits(unsigned bits) const { return _blockLeft == 0 || getAvailable() >= bits; }
+	uint32_t readBits(unsigned n);
+	int32_t  readSample(Channel &ch, unsigned rawBits);
+	void     readHeader();
+	void     startBlock();
+	void     endBlock();
+};
+
+#endif /* AUDIO_RICELOSSLESS_H_ */
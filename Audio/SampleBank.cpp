@@ -0,0 +1,17 @@
+/*
+ * SampleBank.cpp - Samples built into flash.
+ *
+ * Generated by tools/wav2flash.py, don't edit. List the WAV files in
+ * SAMPLE_BANK in the Makefile and run "make samplebank" instead.
+ */
+
+#include "FlashSampleSource.h"
+
+#define SAMPLEBANK __attribute__((section(".samplebank"), aligned(4)))
+
+const FlashSample g_sampleBank[] =
+{
+	{ 0, 0, 0, 0, 0 }, // Empty, but C++ doesn't allow an array of none.
+};
+
+const unsigned g_sampleBankSize = 0;
@@ -0,0 +1,413 @@
+/*
+ * VoiceManager.cpp - Polyphonic sample player.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "VoiceManager.h"
+#include "AttackCache.h"
+#include "Trace.h"
+#include <string.h>
+
+// One voice. The file is opened and started in poll(), in the main loop,
+// and then the StreamScheduler keeps it fed. fillBuffer() in the audio
+// interrupt only ever copies out of the stream or the AttackCache. The
+// VoiceManager sets up what to play next with interrupts masked.
+class VoiceManager::Voice
+	: public AudioSource
+{
+public:
+	enum State {
+		kIdle,     // On the free list.
+		kStarting, // File to be opened by the next poll().
+		kAttack,   // Playing from the AttackCache while poll() opens the file.
+		kPlaying,
+		kFading    // Fading out, then either idle or starting the pending file.
+	};
+
+	Voice(VoiceManager &vm, unsigned index)
+		: _vm(vm)
+		, _index(index)
+		, _slot(-1)
+		, _state(kIdle)
+		, _group(0)
+		, _pending(0)
+		, _gain(GainStage::kUnity)
+		, _pan(Mixer::kPanCentre)
+		, _loop(false)
+		, _triggered(false)
+		, _level(0)
+		, _attack(0)
+	{
+	}
+
+	void setSlot(int slot) { _slot = slot; }
+
+	State    getState() const { return (State)_state; }
+	unsigned getGroup() const { return _group; }
+	unsigned getLevel() const { return _level; }
+
+	// Interrupts must be masked when calling these two.
+	void start(const TCHAR *filename, unsigned gain, unsigned pan, unsigned group, bool loop)
+	{
+		_pending = filename;
+		_gain    = gain;
+		_pan     = pan;
+		_group   = group;
+		_loop    = loop;
+		_level   = (0x7FFF * gain) >> 15; // Assume it's loud until we know.
+		_attack  = AttackCache::find(filename);
+
+		_triggered = true;
+
+		if(_state == kPlaying || _state == kAttack)
+			fadeOut();
+		else if(_state == kIdle)
+			begin();
+		// Already starting or fading, the new file just replaces the pending one.
+	}
+
+	void fadeOut()
+	{
+		if(_state == kPlaying || _state == kAttack) {
+			_wav.setGain(0);
+			_state = kFading;
+		}
+		_level = 0; // Best voice to steal now.
+	}
+
+	void cancel()
+	{
+		_pending   = 0;
+		_triggered = false;
+		if(_state == kStarting) {
+			_state = kIdle;
+			_vm.release(_index);
+		} else {
+			fadeOut();
+		}
+	}
+
+	// Main loop. Opens the pending file, or closes the last one once the
+	// voice has gone idle.
+	void poll()
+	{
+		_wav.poll();
+
+		if(_state == kIdle) {
+			if(_wav.isOpen())
+				_wav.close();
+			return;
+		}
+
+		if(_state != kStarting && !(_state == kAttack && _pending))
+			return;
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		const TCHAR *filename = _pending;
+		bool         attack   = (_state == kAttack);
+		_pending = 0;
+		__set_PRIMASK(primask);
+
+		// Nothing else touches the file while the voice is starting or
+		// playing its attack, so the slow filesystem work can be done with
+		// interrupts on.
+		if(!attack)
+			_wav.close();
+		bool ok = filename && _wav.open(filename, true);
+		if(ok) {
+			if(!attack) {
+				_vm._mixer.setGain(_slot, _gain, _pan, false);
+				_wav.setGainNow(GainStage::kUnity);
+			}
+			ok = _wav.play(_loop); // Fails if the card can't keep up with another stream.
+		}
+
+		__disable_irq();
+		if(_state != kStarting && _state != kAttack) {
+			// Cancelled or stolen while we were opening it.
+		} else if(_pending) {
+			// Triggered again while we were opening it, go round again.
+		} else if(ok) {
+			_state = kPlaying;
+		} else if(_state == kAttack) {
+			fadeOut(); // Can't carry on past the cached part.
+		} else {
+			_state = kIdle;
+			_vm.release(_index);
+		}
+		__set_PRIMASK(primask);
+	}
+
+	virtual bool isActive() const { return _state == kAttack || _state == kPlaying || _state == kFading; }
+
+	virtual void fillBuffer(AUDIOSAMPLE *buffer)
+	{
+		if(!isActive()) {
+			memset(buffer, 0, kFrameBytes);
+			return;
+		}
+
+		_wav.fillBuffer(buffer);
+
+		if(_state == kFading) {
+			// The fade took exactly this frame.
+			if(_pending) {
+				begin();
+			} else {
+				_state = kIdle;
+				_vm.release(_index);
+			}
+			return;
+		}
+
+		if(_triggered) {
+			Trace::event(kTraceVoiceSound, _index);
+			_triggered = false;
+		}
+
+		if(!_wav.isPlaying()) {
+			// Got to the end of a one-shot.
+			_state = kIdle;
+			_vm.release(_index);
+		} else if(_vm._steal == kStealQuietest) {
+			_level = (peak(buffer) * _gain) >> 15;
+		}
+	}
+
+private:
+	VoiceManager         &_vm;
+	uint8_t               _index;
+	int8_t                _slot;    // Our voice number in the Mixer.
+	volatile uint8_t      _state;
+	uint8_t               _group;
+	const TCHAR *volatile _pending; // File to play next.
+	unsigned              _gain;
+	unsigned              _pan;
+	bool                  _loop;
+	volatile bool         _triggered; // Not made a sound since trigger() yet.
+	unsigned              _level;     // Loudest sample in the last frame, after the gain.
+	const AttackCache::Entry *_attack;
+	WavSource             _wav;
+
+	// Start the pending file. If the start of it is in the AttackCache play
+	// that right away, otherwise wait for poll() to open it. Called from
+	// the audio interrupt or with interrupts masked.
+	void begin()
+	{
+		if(_attack == 0) {
+			_state = kStarting;
+			return;
+		}
+
+		_vm._mixer.setGain(_slot, _gain, _pan, false);
+		_wav.setGainNow(GainStage::kUnity);
+		_wav.playAttack(_attack, _loop);
+		if(_attack->whole && !_loop)
+			_pending = 0; // It's all in RAM, no file needed.
+		_state = kAttack;
+	}
+
+	static unsigned peak(const AUDIOSAMPLE *buffer)
+	{
+		int32_t hi = 0;
+		int32_t lo = 0;
+		for(unsigned i = 0; i < kFrameSize; i++) {
+			int32_t l = (int16_t)buffer[i];
+			int32_t r = (int32_t)buffer[i] >> 16;
+			if(l > hi) hi = l;
+			if(l < lo) lo = l;
+			if(r > hi) hi = r;
+			if(r < lo) lo = r;
+		}
+		return hi > -lo ? hi : -lo;
+	}
+};
+
+VoiceManager::VoiceManager(Mixer &mixer, StealMode steal)
+	: _mixer(mixer)
+	, _steal(steal)
+	, _oldest(kNoVoice)
+	, _newest(kNoVoice)
+	, _free(kNoVoice)
+{
+	for(unsigned i = 0; i < kMaxChokeGroups; i++)
+		_choke[i] = kNoVoice;
+
+	// The voices are big (each has a FIL and a Stream) so they come from the
+	// large memory pool rather than the stack.
+	for(int i = kMaxVoices - 1; i >= 0; i--) {
+		_voice[i] = new Voice(*this, i);
+		if(_voice[i] == 0)
+			continue;
+
+		int slot = _mixer.addVoice(_voice[i]);
+		if(slot < 0) {
+			delete _voice[i];
+			_voice[i] = 0;
+			continue;
+		}
+		_voice[i]->setSlot(slot);
+
+		_prev[i] = kNoVoice;
+		_next[i] = _free;
+		_free = i;
+	}
+}
+
+VoiceManager::~VoiceManager()
+{
+	for(unsigned i = 0; i < kMaxVoices; i++) {
+		if(_voice[i]) {
+			_mixer.removeVoice(_voice[i]);
+			delete _voice[i];
+		}
+	}
+}
+
+int VoiceManager::trigger(const TCHAR *filename, unsigned gain, unsigned pan, unsigned chokeGroup, bool loop)
+{
+	if(chokeGroup >= kMaxChokeGroups)
+		chokeGroup = 0;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	// Cut off whatever was playing in this choke group.
+	if(chokeGroup != 0 && _choke[chokeGroup] != kNoVoice)
+		_voice[_choke[chokeGroup]]->cancel();
+
+	unsigned v = pickVoice();
+	if(v != kNoVoice) {
+		Voice *voice = _voice[v];
+
+		// This voice may have been the one playing in another group.
+		unsigned oldGroup = voice->getGroup();
+		if(oldGroup != 0 && _choke[oldGroup] == v)
+			_choke[oldGroup] = kNoVoice;
+
+		voice->start(filename, gain, pan, chokeGroup, loop);
+		Trace::event(kTraceVoiceTrigger, v);
+
+		// It's now the newest voice.
+		unlink(v);
+		append(v);
+
+		if(chokeGroup != 0)
+			_choke[chokeGroup] = v;
+	}
+
+	__set_PRIMASK(primask);
+
+	return v == kNoVoice ? -1 : (int)v;
+}
+
+void VoiceManager::stopAll()
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	unsigned v = _oldest;
+	while(v != kNoVoice) {
+		unsigned next = _next[v];
+		_voice[v]->cancel();
+		v = next;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+void VoiceManager::poll()
+{
+	for(unsigned i = 0; i < kMaxVoices; i++) {
+		if(_voice[i])
+			_voice[i]->poll();
+	}
+}
+
+unsigned VoiceManager::getPlaying() const
+{
+	unsigned n = 0;
+	for(unsigned v = _oldest; v != kNoVoice; v = _next[v])
+		n++;
+	return n;
+}
+
+// Take a voice off the free list or, if there are none, steal one. Called
+// with interrupts masked.
+unsigned VoiceManager::pickVoice()
+{
+	unsigned v = _free;
+	if(v != kNoVoice) {
+		_free = _next[v];
+		_next[v] = _prev[v] = kNoVoice;
+		return v;
+	}
+
+	if(_steal == kStealQuietest)
+		return quietest();
+
+	return _oldest;
+}
+
+unsigned VoiceManager::quietest() const
+{
+	unsigned best  = _oldest;
+	unsigned level = 0xFFFFFFFF;
+	for(unsigned v = _oldest; v != kNoVoice; v = _next[v]) {
+		if(_voice[v]->getLevel() < level) {
+			level = _voice[v]->getLevel();
+			best  = v;
+		}
+	}
+	return best;
+}
+
+// Take a voice off the busy list (if it is on it).
+void VoiceManager::unlink(unsigned v)
+{
+	unsigned prev = _prev[v];
+	unsigned next = _next[v];
+
+	if(prev != kNoVoice)
+		_next[prev] = next;
+	else if(_oldest == v)
+		_oldest = next;
+	else
+		return; // Not on the list.
+
+	if(next != kNoVoice)
+		_prev[next] = prev;
+	else
+		_newest = prev;
+
+	_next[v] = _prev[v] = kNoVoice;
+}
+
+// Add a voice to the newest end of the busy list.
+void VoiceManager::append(unsigned v)
+{
+	_prev[v] = _newest;
+	_next[v] = kNoVoice;
+	if(_newest != kNoVoice)
+		_next[_newest] = v;
+	else
+		_oldest = v;
+	_newest = v;
+}
+
+// A voice has finished, put it back on the free list. Called from the audio
+// interrupt or with interrupts masked.
+void VoiceManager::release(unsigned v)
+{
+	unlink(v);
+
+	unsigned group = _voice[v]->getGroup();
+	if(group != 0 && _choke[group] == v)
+		_choke[group] = kNoVoice;
+
+	_next[v] = _free;
+	_free = v;
+}
@@ -0,0 +1,90 @@
+/*
+ * VoiceManager.h - Polyphonic sample player.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_VOICEMANAGER_H_
+#define AUDIO_VOICEMANAGER_H_
+
+#include "board.h"
+#include "Mixer.h"
+#include "WavSource.h"
+
+// Plays a WAV file on a free voice every time it is triggered, like a drum
+// module. There are a fixed number of voices, each one a WavSource feeding
+// a Mixer. When they are all busy a voice is stolen: either the one which
+// was triggered longest ago or the one which is quietest right now.
+//
+// Voices can be put into a choke group, where triggering any voice in the
+// group cuts off the one already playing (like an open hi-hat being cut off
+// by a closed one). Stolen and choked voices fade out over one frame rather
+// than stopping dead, so they don't click.
+//
+// trigger() can be called at any time from the main loop. It just picks a
+// voice and tells it what to play, which takes the same time however many
+// voices are playing. The file is opened by the next poll(), also in the
+// main loop, and streamed by the StreamScheduler. The audio interrupt never
+// touches the filesystem. If the card can't stream another file the voice
+// doesn't start (kTraceStreamRefused on the trace). Samples loaded into the
+// AttackCache start sounding at the next frame without waiting for the file.
+class VoiceManager
+{
+public:
+	enum {
+		kMaxVoices      = VOICE_COUNT,
+		kMaxChokeGroups = 4, // Group 0 means no choke group.
+		kNoVoice        = 0xFF
+	};
+
+	enum StealMode {
+		kStealOldest,
+		kStealQuietest
+	};
+
+	VoiceManager(Mixer &mixer, StealMode steal = kStealOldest);
+	~VoiceManager();
+
+	// Play a file. The filename isn't copied so it must stay around (a
+	// string constant is fine). Returns the voice number or -1 if there
+	// are no voices at all.
+	int trigger(const TCHAR *filename, unsigned gain = GainStage::kUnity, unsigned pan = Mixer::kPanCentre,
+	            unsigned chokeGroup = 0, bool loop = false);
+
+	// Fade out everything.
+	void stopAll();
+
+	// Call this all the time from the main loop, along with
+	// StreamScheduler::poll(). Opens and closes files for the voices.
+	void poll();
+
+	void setStealMode(StealMode steal) { _steal = steal; }
+
+	unsigned getPlaying() const; // Number of voices busy.
+
+private:
+	class Voice;
+
+	Mixer    &_mixer;
+	StealMode _steal;
+	Voice    *_voice[kMaxVoices];
+
+	// Busy voices are on a list from oldest to newest trigger, idle ones
+	// are on a free list. Links are voice numbers.
+	uint8_t _next[kMaxVoices];
+	uint8_t _prev[kMaxVoices];
+	uint8_t _oldest;
+	uint8_t _newest;
+	uint8_t _free;
+
+	uint8_t _choke[kMaxChokeGroups]; // Voice currently playing in each group.
+
+	unsigned pickVoice();
+	unsigned quietest() const;
+	void     unlink(unsigned v);
+	void     append(unsigned v);
+	void     release(unsigned v);
+};
+
+#endif /* AUDIO_VOICEMANAGER_H_ */
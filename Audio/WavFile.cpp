@@ -6,6 +6,11 @@
  */
 
 #include "WavFile.h"
+#include "AudioKinetisI2S.h"
+#include "AudioSource.h"
+#include "ImaAdpcm.h"
+#include "RiceLossless.h"
+#include "Trace.h"
 
 // 4CC codes for different chunk types that interest us.
 enum WavChunkType {
@@ -13,6 +18,7 @@ enum WavChunkType {
 	kWavHdrWave = 0x45564157, // "WAVE"
 	kWavHdrData = 0x61746164, // "data"
 	kWavHdrFmt  = 0x20746D66, // "FMT "
+	kWavHdrSmpl = 0x6C706D73, // "smpl"
 };
 
 struct __attribute__((packed)) WavChunkHdr
@@ -40,6 +46,38 @@ struct __attribute__((packed)) WavFormat
 	uint16_t numBits;       // Bits per sample (8, 16 etc)
 };
 
+// Sampler chunk, as written by sample editors to give loop points. The
+// loops follow it.
+struct __attribute__((packed)) WavSampler
+{
+	uint32_t manufacturer;
+	uint32_t product;
+	uint32_t samplePeriod;
+	uint32_t unityNote;
+	uint32_t pitchFraction;
+	uint32_t smpteFormat;
+	uint32_t smpteOffset;
+	uint32_t numLoops;
+	uint32_t samplerData; // Bytes of extra data after the loops.
+};
+
+struct __attribute__((packed)) WavSamplerLoop
+{
+	uint32_t cuePoint;
+	uint32_t type;
+	uint32_t start;     // Frames.
+	uint32_t end;       // The last frame in the loop, not one after it.
+	uint32_t fraction;
+	uint32_t playCount;
+};
+
+// Extra format info which follows WavFormat for IMA ADPCM.
+struct __attribute__((packed)) WavAdpcmFormat
+{
+	uint16_t extraSize;       // Bytes of extra info (2).
+	uint16_t samplesPerBlock; // Per channel.
+};
+
 WavFile::WavFile()
 {
 	close();
@@ -47,13 +85,21 @@ WavFile::WavFile()
 
 void WavFile::close()
 {
+	_stream.stop();
 	_f.close();
+	_format = 0;
+	_byteRate = 0;
 	_sampleRate = 0;
 	_bitsPerSample = 0;
 	_blockAlign = 0;
 	_nChannels = 0;
 	_dataOffset = 0;
 	_dataSize = 0;
+	_loopStart = 0;
+	_loopEnd = 0;
+	_reversePos = 0;
+	_reverse = false;
+	_mapped = false;
 }
 
 // Open a WAV file, load the header and find the data section.
@@ -87,9 +133,12 @@ bool WavFile::open(const TCHAR *filename)
 	{
 		// Read the next chunk.
 		r = _f.read((uint8_t *)&hdr, sizeof(hdr));
-		if(r < sizeof(hdr)) {
-			return false;
-		}
+		if(r < sizeof(hdr))
+			break;
+
+		// Chunks are padded out to an even number of bytes.
+		unsigned chunkSize  = hdr.size + (hdr.size & 1);
+		unsigned chunkStart = _f.tell();
 
 		// Do we care about this chunk?
 		switch(hdr.chunkType)
@@ -97,49 +146,268 @@ bool WavFile::open(const TCHAR *filename)
 		case kWavHdrData: // Data chunk. Record the location but don't read it yet.
 			_dataOffset = _f.tell();
 			_dataSize   = hdr.size;
-			_f.seek(hdr.size, File::SEEK_CUR);
+			_f.seek(chunkSize, File::SEEK_CUR);
 			break;
 
 		case kWavHdrFmt: // Sample format info. Sample rate, channels etc.
+			if(hdr.size < sizeof(fmt))
+				return false;
 			r = _f.read((uint8_t *)&fmt, sizeof(fmt));
 			if(r != sizeof(fmt))
 				return false;
-			if(fmt.format != 1)
-				return false; // Not in PCM sample format.
 
 			// Grab the information we want.
+			_format        = fmt.format;
 			_nChannels     = fmt.numChannels;
 			_sampleRate    = fmt.sampleRate;
+			_byteRate      = fmt.byteRate;
 			_blockAlign    = fmt.blockAlign;
 			_bitsPerSample = fmt.numBits;
+
+			if(_format == kFormatImaAdpcm) {
+				if(!checkAdpcmFormat(hdr.size))
+					return false;
+			} else if(_format == kFormatRice) {
+				if(!checkRiceFormat())
+					return false;
+			} else if(_format != kFormatPcm || !checkPcmFormat()) {
+				return false; // Not a sample format we can play.
+			}
+
+			// Skip anything else in the chunk.
+			_f.seek(chunkStart + chunkSize);
+			break;
+
+		case kWavHdrSmpl: // Loop points. Only the first loop is used.
+			readLoop(hdr.size);
+			_f.seek(chunkStart + chunkSize);
 			break;
 
 		default: // Unknown chunk. Skip it.
-			_f.seek(hdr.size, File::SEEK_CUR);
+			_f.seek(chunkSize, File::SEEK_CUR);
 			break;
 		}
 
-		// Do we have all the valid data we need?
-		if(_dataOffset != 0 && _sampleRate != 0) {
-			rewind();
-			return true;
-		}
+		// Carry on past the data for any chunks after it, the loop points
+		// are usually at the end.
+		if(sizeof(hdr) + chunkSize + sizeof(hdr) > riffSize)
+			break;
+		riffSize -= (sizeof(hdr) + chunkSize);
+	}
+
+	if(_dataOffset == 0 || _sampleRate == 0)
+		return false; // End of file reached, no valid WAV data found.
+
+	// ADPCM data is only any use in whole groups.
+	_dataSize -= _dataSize % getGranule();
+
+	// Loop points only work for PCM, and have to be inside the data.
+	unsigned frames = _dataSize / _blockAlign;
+	if(_format != kFormatPcm || _loopStart >= _loopEnd || _loopEnd > frames) {
+		_loopStart = 0;
+		_loopEnd   = 0;
+	}
+
+	rewind();
+	return true;
+}
+
+void WavFile::readLoop(unsigned chunkSize)
+{
+	WavSampler     smpl;
+	WavSamplerLoop loop;
+	if(chunkSize < sizeof(smpl) + sizeof(loop))
+		return;
+	if(_f.read((uint8_t *)&smpl, sizeof(smpl)) != sizeof(smpl) || smpl.numLoops == 0)
+		return;
+	if(_f.read((uint8_t *)&loop, sizeof(loop)) != sizeof(loop))
+		return;
+
+	_loopStart = loop.start;
+	_loopEnd   = loop.end + 1;
+}
+
+// Read the IMA ADPCM extra format info and check it all adds up.
+bool WavFile::checkAdpcmFormat(unsigned chunkSize)
+{
+	WavAdpcmFormat adpcm;
+	if(chunkSize < sizeof(WavFormat) + sizeof(adpcm))
+		return false;
+	if(_f.read((uint8_t *)&adpcm, sizeof(adpcm)) != sizeof(adpcm))
+		return false;
+
+	if(_bitsPerSample != 4 || _nChannels < 1 || _nChannels > 2)
+		return false;
+	if(_blockAlign == 0 || (_blockAlign % (_nChannels * 4)) != 0)
+		return false;
+
+	return adpcm.samplesPerBlock == ImaAdpcmDecoder::samplesPerBlock(_nChannels, _blockAlign);
+}
+
+// 8, 16 or 24-bit, mono or stereo, see PcmFormat.h.
+bool WavFile::checkPcmFormat()
+{
+	if(_bitsPerSample != 8 && _bitsPerSample != 16 && _bitsPerSample != 24)
+		return false;
+	if(_nChannels < 1 || _nChannels > 2)
+		return false;
+	return _blockAlign == _bitsPerSample / 8 * _nChannels;
+}
 
-		riffSize -= (sizeof(hdr) + hdr.size);
+// Check the format of a Rice lossless file (see RiceLossless.h) adds up.
+// The bits are those of the decoded samples.
+bool WavFile::checkRiceFormat()
+{
+	if(_bitsPerSample != 16 || _nChannels < 1 || _nChannels > 2)
+		return false;
+	return _blockAlign >= RiceDecoder::kMinBlockAlign && (_blockAlign % 4) == 0;
+}
+
+bool WavFile::setReverse(bool reverse)
+{
+	if(reverse) {
+		if(_format != kFormatPcm || _blockAlign == 3 || _blockAlign > 4)
+			return false;
+		mapClusters();
 	}
 
-	// End of file reached, no valid WAV data found.
-	return false;
+	_reverse = reverse;
+	rewind();
+	return true;
+}
+
+unsigned WavFile::getGranule() const
+{
+	if(_format == kFormatImaAdpcm)
+		return _nChannels * 4; // One ADPCM header or group.
+	if(_format == kFormatRice)
+		return 4;
+	return _blockAlign ? _blockAlign : 1;
+}
+
+bool WavFile::startStream(bool loop, unsigned skip, unsigned loopStart, unsigned loopEnd)
+{
+	if(!isOpen())
+		return false;
+
+	unsigned rate = _byteRate ? _byteRate : _sampleRate * _blockAlign;
+
+	// The audio interrupt takes a frame at a time out of the ring (more than
+	// a frame of the file if it is resampled down), if that doesn't fit it
+	// would run dry every frame. The compressed formats go by the byte rate,
+	// which for Rice is the worst block's.
+	unsigned outRate = AudioKinetisI2S::getSampleRate();
+	unsigned frames  = AudioSource::kFrameSize;
+	if(_sampleRate > outRate)
+		frames = AudioSource::kFrameSize * _sampleRate / outRate + 1;
+	bool tooBig = _format == kFormatPcm ? _blockAlign * frames > StreamScheduler::kRingBytes
+	                                    : rate > StreamScheduler::kRingBytes * _sampleRate / frames;
+	if(tooBig) {
+		Trace::event(kTraceStreamRefused, rate);
+		return false;
+	}
+
+	unsigned length = (loopEnd != 0 && loopEnd < _dataSize) ? loopEnd : _dataSize;
+	if(!_stream.start(&_f, _dataOffset, length, rate, loop, _dataOffset + loopStart, skip, _reverse ? _blockAlign : 0))
+		return false;
+
+	setStreamSpeed(1 << 16);
+	return true;
+}
+
+// A frame's worth of the file at this speed, from the byte rate, which is
+// the worst case for the compressed formats. Plus a granule for a frame
+// that starts part way through one.
+void WavFile::setStreamSpeed(uint32_t speed)
+{
+	unsigned rate  = _byteRate ? _byteRate : _sampleRate * _blockAlign;
+	unsigned bytes = rate * AudioSource::kFrameSize / AudioKinetisI2S::getSampleRate() + 1;
+	_stream.setNeed(((bytes * (speed >> 8)) >> 8) + getGranule());
 }
 
-// Get a chunk of wave data.
+// Get a chunk of wave data. Stops at the end of the data chunk, anything
+// after it isn't samples.
 unsigned WavFile::readBlock(uint8_t *dest, unsigned nBytes)
 {
-	return _f.read(dest, nBytes);
+	if(_stream.isRunning())
+		return _stream.read(dest, nBytes, getGranule());
+
+	if(_reverse) {
+		unsigned left = _reversePos - _dataOffset;
+		if(nBytes > left)
+			nBytes = left;
+		nBytes -= nBytes % _blockAlign;
+
+		_reversePos -= nBytes;
+		_f.seek(_reversePos);
+		if(_f.read(dest, nBytes) != (int)nBytes) {
+			_reversePos = _dataOffset; // Give up.
+			return 0;
+		}
+		Stream::reverseFrames(dest, nBytes, _blockAlign);
+		return nBytes;
+	}
+
+	unsigned pos = _f.tell();
+	unsigned end = _dataOffset + _dataSize;
+	if(pos >= end)
+		return 0;
+	if(nBytes > end - pos)
+		nBytes = end - pos;
+
+	int r = _f.read(dest, nBytes);
+	return r > 0 ? r : 0;
+}
+
+// Read from anywhere in the data, for a file which isn't streamed. It
+// carries on from wherever it was afterwards.
+unsigned WavFile::readAt(unsigned offset, uint8_t *dest, unsigned nBytes)
+{
+	if(_stream.isRunning() || offset > _dataSize)
+		return 0;
+	if(nBytes > _dataSize - offset)
+		nBytes = _dataSize - offset;
+
+	unsigned pos = _f.tell();
+	_f.seek(_dataOffset + offset);
+	int r = _f.read(dest, nBytes);
+	_f.seek(pos);
+	return r > 0 ? r : 0;
+}
+
+// Carry on reading from offset bytes into the data, for a file which isn't
+// streamed. With a cluster map this doesn't go near the card.
+bool WavFile::seekData(unsigned offset)
+{
+	return _f.seek(_dataOffset + offset);
+}
+
+// Make a cluster map, unless there is one already.
+void WavFile::mapClusters()
+{
+	if(!_mapped)
+		_mapped = _f.mapClusters(_clusterMap, kClusterMapEntries);
 }
 
 // Move playback to the beginning of the data.
 bool WavFile::rewind()
 {
-	return _f.seek(_dataOffset);
+	unsigned pos = _reverse ? _dataOffset + _dataSize : _dataOffset;
+	if(_stream.isRunning()) {
+		_stream.seek(pos);
+		return true;
+	}
+
+	_reversePos = pos;
+	return _f.seek(pos);
+}
+
+bool WavFile::isEnd() const
+{
+	if(_stream.isRunning())
+		return _stream.isEnd();
+	if(_reverse)
+		return _reversePos <= _dataOffset;
+
+	return _f.tell() >= _dataOffset + _dataSize;
 }
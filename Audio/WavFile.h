@@ -9,32 +9,97 @@
 #define WAVFILE_H_
 
 #include "Filesystem.h"
+#include "StreamScheduler.h"
 #include <stdint.h>
 
 class WavFile {
 public:
+	enum Format {
+		kFormatPcm      = 0x0001,
+		kFormatImaAdpcm = 0x0011,
+		kFormatRice     = 0x5249  // Our own, see RiceLossless.h.
+	};
+
+	enum {
+		kClusterMapEntries = 8 // Room for a file in up to three pieces.
+	};
+
 	WavFile();
 
 	bool open(const TCHAR *filename);
 	void close();
 
+	// Play the data backwards from the end, a frame at a time, which can
+	// only be done with 8 and 16-bit PCM. Call after open(), it starts from
+	// the end again. False if the format can't go backwards. The file gets
+	// a cluster map so going back a piece at a time doesn't mean following
+	// the FAT chain from the start of the file each time.
+	bool setReverse(bool reverse);
+	bool isReverse() const { return _reverse; }
+
+	// Read the sample data through a Stream, so the StreamScheduler does the
+	// card reads in the main loop and readBlock() only copies out of a ring
+	// buffer. The first skip bytes of data are left out the first time
+	// through. It finishes loopEnd bytes into the data (0 for the end), and
+	// a loop goes back to loopStart. Returns false if the scheduler can't
+	// fit another stream in.
+	bool startStream(bool loop = false, unsigned skip = 0, unsigned loopStart = 0, unsigned loopEnd = 0);
+	void stopStream() { _stream.stop(); }
+	bool isStreaming() const { return _stream.isRunning(); }
+
+	// Tell the stream how fast the file is being played (Q16.16, 1.0 is
+	// normal speed) so it keeps enough in the ring for a frame. startStream()
+	// assumes normal speed. Can be called from the audio interrupt.
+	void setStreamSpeed(uint32_t speed);
+
+	// Short reads from a stream are always a whole number of getGranule()
+	// bytes, so a sample is never split between two reads. In reverse the
+	// frames come out last first.
 	unsigned readBlock(uint8_t *dest, unsigned nBytes);
 
+	unsigned readAt(unsigned offset, uint8_t *dest, unsigned nBytes);
+	bool     seekData(unsigned offset);
+	void     mapClusters(); // So seekData() doesn't follow the FAT chain.
+
 	bool rewind();
+	bool isEnd() const; // All the sample data has been read.
+	bool isOpen() const { return _dataOffset != 0 && _sampleRate != 0; }
 
+	unsigned getFormat()     const { return _format; }
 	unsigned getByteSize()   const { return _dataSize; }
+	unsigned getBlockAlign() const { return _blockAlign; }
+	unsigned getGranule()    const; // Smallest useful piece of data, in bytes.
 	unsigned getSampleRate() const { return _sampleRate; }
 	unsigned getNumBits()    const { return _bitsPerSample; }
 	unsigned getChannels()   const { return _nChannels; }
 
+	// The first loop from the smpl chunk, in frames, end not included. Both
+	// 0 if there isn't one (or it isn't PCM).
+	unsigned getLoopStart()  const { return _loopStart; }
+	unsigned getLoopEnd()    const { return _loopEnd; }
+
 private:
 	File     _f;
+	unsigned _format;
+	unsigned _byteRate;
 	unsigned _sampleRate;
 	unsigned _bitsPerSample;
 	unsigned _blockAlign;
 	unsigned _nChannels;
 	unsigned _dataOffset;
 	unsigned _dataSize;
+	unsigned _loopStart;
+	unsigned _loopEnd;
+	unsigned _reversePos; // Where the next read backwards finishes.
+	bool     _reverse;
+	bool     _mapped;
+	Stream   _stream;
+	DWORD    _clusterMap[kClusterMapEntries];
+
+	bool checkPcmFormat();
+	bool checkAdpcmFormat(unsigned chunkSize);
+	bool checkRiceFormat();
+	void readLoop(unsigned chunkSize);
 };
 
 #endif /* WAVFILE_H_ */
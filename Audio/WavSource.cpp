@@ -6,76 +6,742 @@
  */
 
 #include "WavSource.h"
+#include "AudioKinetisI2S.h"
+#include "ConstexprMath.h"
+#include "PcmFormat.h"
+#include "Trace.h"
+#include <new>
 #include <string.h>
 
+#define FADE_STEPS 64
+
+// A quarter of a sine wave, Q15, for equal power crossfades. Fading in
+// goes up it and fading out comes down it the other way, and the two add
+// up to the same power all the way across.
+struct FadeTable
+{
+	int16_t g[FADE_STEPS + 1];
+
+	constexpr FadeTable()
+		: g()
+	{
+		for(unsigned i = 0; i <= FADE_STEPS; i++)
+			g[i] = ConstexprMath::round(ConstexprMath::sin(ConstexprMath::kPi / 2 * i / FADE_STEPS) * 32767);
+	}
+};
+
+static constexpr FadeTable s_fade;
+
+// The loop caches are static RAM, each lent to a WavSource while it plays a
+// loop.
+#ifdef LOOP_CACHE_ENABLE
+static uint32_t   s_loopCache[LOOP_CACHE_COUNT][LOOP_CACHE_BYTES / sizeof(uint32_t)];
+static WavSource *s_loopCacheOwner[LOOP_CACHE_COUNT];
+#endif
+
+// The file queueNext() opens the next file in, lent to one WavSource at a
+// time (see getNext()). Made the first time it's wanted, and never
+// destroyed, so there's no static destructor to register.
+static union
+{
+	uint32_t align;
+	uint8_t  bytes[sizeof(WavFile)];
+} s_sharedFile;
+static WavFile   *s_shared;
+static WavSource *s_sharedOwner;
+
 WavSource::WavSource()
-	: _loop(false)
+	: _wav(&_file)
+	, _gain(GainStage::kUnity / 4)
+	, _format(WavFile::kFormatPcm)
+	, _loop(false)
+	, _streamed(false)
 	, _isPlaying(false)
+	, _cardReader(false)
+	, _attack(0)
+	, _attackLeft(0)
+	, _attackBytes(0)
+	, _attackWhole(false)
+	, _waitStream(false)
+	, _reverse(false)
+	, _nextReady(false)
+	, _nextLoop(false)
+	, _loopRegion(false)
+	, _loopStart(0)
+	, _loopEnd(0)
+	, _loopLeft(0)
+	, _loopFade(0)
+	, _fadeBytes(0)
+	, _loopCached(0)
+	, _loopCache(0)
+	, _decode(&WavSource::decodePcm<16, 2>)
+	, _decodeInput(&WavSource::decodePcm<16, 2>)
 {
 }
 
 WavSource::~WavSource()
 {
+	dropNext();
+	useOwnFile();
+	releaseLoopCache();
+	setCardReader(false);
+}
+
+// While an attack is playing the audio interrupt doesn't go near the file,
+// so it can be opened underneath it.
+bool WavSource::open(const TCHAR *filename, bool streamed)
+{
+	dropNext();
+
+	bool attack = _waitStream;
+	if(!attack) {
+		_isPlaying = false;
+		_streamed  = streamed;
+		setCardReader(false);
+	}
+	useOwnFile();
+
+	if(!_wav->open(filename))
+		return false;
+
+	// Too fast for the resampler, or can't be played backwards.
+	if(!Resampler::isSupported(_wav->getSampleRate(), AudioKinetisI2S::getSampleRate()) ||
+	   (_reverse && !_wav->setReverse(true))) {
+		_wav->close();
+		return false;
+	}
+
+	// The attack already set the format up from the cache.
+	if(!attack) {
+		_loopRegion = false;
+		setFormat(_wav->getFormat(), _wav->getChannels(), _wav->getBlockAlign(), _wav->getByteSize(), _wav->getSampleRate());
+	}
+
+	// The whole file unless it says otherwise.
+	_loopStart = _wav->getLoopStart() * _wav->getBlockAlign();
+	_loopEnd   = _wav->getLoopEnd() ? _wav->getLoopEnd() * _wav->getBlockAlign() : _wav->getByteSize();
+	return true;
 }
 
-bool WavSource::open(const TCHAR *filename)
+void WavSource::setLoopPoints(unsigned start, unsigned end)
 {
-	return _wav.open(filename);
+	unsigned blockAlign = _wav->getBlockAlign();
+	if(blockAlign == 0 || start >= end || end * blockAlign > _wav->getByteSize())
+		return;
+
+	_loopStart = start * blockAlign;
+	_loopEnd   = end * blockAlign;
+}
+
+unsigned WavSource::getLoopStart() const
+{
+	return _wav->getBlockAlign() ? _loopStart / _wav->getBlockAlign() : 0;
+}
+
+unsigned WavSource::getLoopEnd() const
+{
+	return _wav->getBlockAlign() ? _loopEnd / _wav->getBlockAlign() : 0;
+}
+
+bool WavSource::setLoopFade(unsigned frames)
+{
+#ifdef LOOP_CACHE_ENABLE
+	_loopFade = frames;
+	return true;
+#else
+	_loopFade = 0;
+	return frames == 0;
+#endif
+}
+
+unsigned WavSource::getLoopFade() const
+{
+	return _wav->getBlockAlign() ? _fadeBytes / _wav->getBlockAlign() : 0;
 }
 
 void WavSource::close()
 {
-	_wav.close();
+	_isPlaying  = false;
+	_attackLeft = 0;
+	_waitStream = false;
+	_loopRegion = false;
+	dropNext();
+	_wav->close();
+	useOwnFile();
+	releaseLoopCache();
+	setCardReader(false);
 }
 
-void WavSource::play(bool loop)
+bool WavSource::play(bool loop)
 {
 	_loop = loop;
-	_isPlaying = true;
+
+	// If an attack is playing the decoder is already going.
+	if(!_waitStream) {
+		resetDecoder();
+		_resampler.reset();
+	}
+
+	startLoop();
+
+	// The stream does the looping itself, so fillBuffer() never sees the end.
+	// Between loop points it goes back to after the part in the loop cache,
+	// and if that's the whole loop it just stops at the end of it.
+	bool     region = _loopRegion;
+	unsigned resume = _loopStart + _loopCached;
+	if(_streamed && !_wav->startStream(loop && !(region && resume == _loopEnd), _waitStream ? _attackBytes : 0,
+	                                  region ? resume : 0, region ? _loopEnd : 0))
+		return false;
+	if(_streamed)
+		_wav->setStreamSpeed(_resampler.getSpeed());
+
+	setCardReader(!_streamed);
+	_waitStream = false;
+	_isPlaying  = true;
+	return true;
+}
+
+void WavSource::playAttack(const AttackCache::Entry *attack, bool loop)
+{
+	setFormat(attack->format, attack->channels, attack->blockAlign, attack->dataSize, attack->sampleRate);
+
+	_attack      = attack->data;
+	_attackLeft  = attack->bytes;
+	_attackBytes = attack->bytes;
+	_attackWhole = attack->whole && !loop;
+	_loop        = loop;
+	_streamed    = true;
+	_waitStream  = true;
+	_loopRegion  = false;
+	_isPlaying   = true;
+}
+
+// PCM loops go between the loop points, wrapping in readData(). Keep the
+// start of the loop, and the frames before it to crossfade from, in a loop
+// cache if there's one free, read now while the file is still ours.
+void WavSource::startLoop()
+{
+	unsigned blockAlign = _wav->getBlockAlign();
+	bool     region     = _loop && _format == WavFile::kFormatPcm && !_reverse && _loopStart < _loopEnd;
+	if(region && _waitStream && _attackBytes >= _loopEnd)
+		region = false; // The attack goes past the loop, just loop the stream.
+
+	unsigned fade   = 0;
+	unsigned cached = 0;
+	if(region) {
+		_wav->mapClusters();
+		_loopCache = getLoopCache();
+	}
+	if(region && _loopCache) {
+		unsigned room = LOOP_CACHE_BYTES - LOOP_CACHE_BYTES % blockAlign;
+		unsigned len  = _loopEnd - _loopStart;
+
+		fade = _loopFade * blockAlign;
+		if(fade > _loopStart)
+			fade = _loopStart;
+		if(fade > len)
+			fade = len;
+		if(fade > room)
+			fade = room;
+
+		cached = room - fade;
+		if(cached > len)
+			cached = len;
+
+		if(_wav->readAt(_loopStart - fade, _loopCache, fade + cached) < fade + cached)
+			fade = cached = 0;
+	}
+
+	// An attack may be playing.
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_fadeBytes  = fade;
+	_loopCached = cached;
+	_loopLeft   = _loopEnd - (_waitStream ? _attackBytes - _attackLeft : 0);
+	_loopRegion = region;
+	__set_PRIMASK(primask);
+}
+
+// At the loop end. Carry on from the loop cache, then the file after it.
+// Without a cluster map the seek would follow the FAT chain.
+void WavSource::wrapLoop()
+{
+	Trace::event(kTraceWavLoop);
+
+	_loopLeft   = _loopEnd - _loopStart;
+	_attack     = _loopCache + _fadeBytes;
+	_attackLeft = _loopCached;
+	if(!_streamed)
+		_wav->seekData(_loopStart + _loopCached);
+}
+
+uint8_t *WavSource::getLoopCache()
+{
+#ifdef LOOP_CACHE_ENABLE
+	unsigned spare = LOOP_CACHE_COUNT;
+	for(unsigned i = 0; i < LOOP_CACHE_COUNT; i++) {
+		if(s_loopCacheOwner[i] == this)
+			return (uint8_t *)s_loopCache[i];
+		if(s_loopCacheOwner[i] == 0 && spare == LOOP_CACHE_COUNT)
+			spare = i;
+	}
+	if(spare < LOOP_CACHE_COUNT) {
+		s_loopCacheOwner[spare] = this;
+		return (uint8_t *)s_loopCache[spare];
+	}
+#endif
+	return 0;
+}
+
+void WavSource::releaseLoopCache()
+{
+#ifdef LOOP_CACHE_ENABLE
+	for(unsigned i = 0; i < LOOP_CACHE_COUNT; i++) {
+		if(s_loopCacheOwner[i] == this)
+			s_loopCacheOwner[i] = 0;
+	}
+#endif
+	_loopCache  = 0;
+	_loopCached = 0;
+	_fadeBytes  = 0;
 }
 
 void WavSource::stop()
 {
-	_isPlaying = false;
-	_wav.rewind();
+	_isPlaying  = false;
+	_attackLeft = 0;
+	_waitStream = false;
+	_loopRegion = false;
+	dropNext();
+	if(_streamed)
+		_wav->stopStream();
+	else
+		rewind();
+	setCardReader(false);
+}
+
+bool WavSource::queueNext(const TCHAR *filename, bool loop)
+{
+	dropNext();
+	if(!_isPlaying || _waitStream || (_loop && !_loopRegion && _streamed))
+		return false;
+
+	WavFile *next = getNext();
+	if(next == 0) {
+		if(s_sharedOwner != 0)
+			return false; // Someone else has it.
+		if(s_shared == 0)
+			s_shared = new(s_sharedFile.bytes) WavFile;
+		s_sharedOwner = this;
+		next = s_shared;
+	}
+	if(!next->open(filename)) {
+		dropNext();
+		return false;
+	}
+
+	// Where it'll loop, as spliceNext() works it out.
+	unsigned blockAlign = next->getBlockAlign();
+	bool     region     = loop && next->getFormat() == WavFile::kFormatPcm && !_reverse;
+	unsigned loopStart  = region ? next->getLoopStart() * blockAlign : 0;
+	unsigned loopEnd    = region ? next->getLoopEnd() * blockAlign : 0;
+	if(region && !_streamed)
+		next->mapClusters();
+
+	if(!Resampler::isSupported(next->getSampleRate(), AudioKinetisI2S::getSampleRate()) ||
+	   (_reverse && !next->setReverse(true)) ||
+	   (_streamed && !next->startStream(loop, 0, loopStart, loopEnd))) {
+		dropNext();
+		return false;
+	}
+	if(_streamed)
+		next->setStreamSpeed(_resampler.getSpeed());
+
+	_nextLoop  = loop;
+	_nextReady = true;
+	return true;
+}
+
+// The one that isn't playing: queued, spliced out of or closed. If ours is
+// playing that's the shared one, or none if we haven't got it.
+WavFile *WavSource::getNext()
+{
+	if(_wav != &_file)
+		return &_file;
+	return s_sharedOwner == this ? s_shared : 0;
+}
+
+// The audio interrupt doesn't touch the file that isn't playing once
+// _nextReady is clear, so it can be closed. Which one that is has to be
+// read with _nextReady cleared, or the interrupt could splice in between.
+// The shared file goes back once it's closed.
+void WavSource::dropNext()
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	_nextReady = false;
+	WavFile *next = getNext();
+	__set_PRIMASK(primask);
+
+	if(next == 0)
+		return;
+	next->close();
+	if(next == s_shared)
+		s_sharedOwner = 0;
+}
+
+void WavSource::poll()
+{
+	if(_nextReady)
+		return;
+	WavFile *old = getNext();
+	if(old && old->isOpen())
+		dropNext();
+}
+
+// Back to our own file, which must be closed, and let the shared one go.
+// Only while the audio interrupt isn't reading the file.
+void WavSource::useOwnFile()
+{
+	if(_wav == &_file)
+		return;
+	_wav->close();
+	_wav          = &_file;
+	s_sharedOwner = 0;
+}
+
+// Unstreamed, the audio interrupt reads the card, so it has to be kept out
+// while the main loop is in FatFs. Set before it starts reading.
+void WavSource::setCardReader(bool reader)
+{
+	if(reader == _cardReader)
+		return;
+	_cardReader = reader;
+	if(reader)
+		Filesystem::addInterruptReader();
+	else
+		Filesystem::removeInterruptReader();
+}
+
+// At the end of the file, or of the time round the loop.
+bool WavSource::isFinished()
+{
+	if(_loopRegion)
+		return _loopLeft == 0;
+	return _wav->isEnd();
+}
+
+// Carry on with the queued file. A resampler that was already going keeps
+// the last of the old file to interpolate from, so there's no join even
+// across a change of rate.
+void WavSource::spliceNext()
+{
+	bool resampled = _decode == &WavSource::decodeResampled;
+
+	_wav       = getNext();
+	_nextReady = false;
+	_loop      = _nextLoop;
+	releaseLoopCache();
+	setFormat(_wav->getFormat(), _wav->getChannels(), _wav->getBlockAlign(), _wav->getByteSize(), _wav->getSampleRate(),
+	          resampled);
+	resetDecoder();
+
+	unsigned blockAlign = _wav->getBlockAlign();
+	_loopStart  = _wav->getLoopStart() * blockAlign;
+	_loopEnd    = _wav->getLoopEnd() ? _wav->getLoopEnd() * blockAlign : _wav->getByteSize();
+	_loopLeft   = _loopEnd;
+	_loopRegion = _loop && _format == WavFile::kFormatPcm && !_reverse;
+}
+
+// Back to the start of the data, for a file which isn't streamed.
+void WavSource::rewind()
+{
+	_wav->rewind();
+	_loopLeft = _loopEnd;
+	resetDecoder();
+}
+
+void WavSource::setFormat(unsigned format, unsigned channels, unsigned blockAlign, unsigned dataSize, unsigned sampleRate,
+                          bool keepHistory)
+{
+	_format = format;
+
+	if(format == WavFile::kFormatImaAdpcm) {
+		_adpcm.init(channels, blockAlign, dataSize);
+		_decode = &WavSource::decodeAdpcm;
+	} else if(format == WavFile::kFormatRice) {
+		_rice.init(channels, blockAlign, dataSize);
+		_decode = &WavSource::decodeRice;
+	} else if(channels == 1) {
+		if(blockAlign == 1)
+			_decode = &WavSource::decodePcm<8, 1>;
+		else if(blockAlign == 3)
+			_decode = &WavSource::decodePcm<24, 1>;
+		else
+			_decode = &WavSource::decodePcm<16, 1>;
+	} else {
+		if(blockAlign == 2)
+			_decode = &WavSource::decodePcm<8, 2>;
+		else if(blockAlign == 6)
+			_decode = &WavSource::decodePcm<24, 2>;
+		else
+			_decode = &WavSource::decodePcm<16, 2>;
+	}
+
+	unsigned outRate = AudioKinetisI2S::getSampleRate();
+	if(keepHistory)
+		_resampler.setRate(sampleRate, outRate);
+	else
+		_resampler.init(sampleRate, outRate);
+	_decodeInput = _decode;
+	if(Resampler::isNeeded(sampleRate, outRate) || _resampler.getSpeed() != Resampler::kUnitySpeed || _resampler.getSpeedInput())
+		_decode = &WavSource::decodeResampled;
+}
+
+void WavSource::setSpeed(uint32_t speed)
+{
+	_resampler.setSpeed(speed);
+	if(_streamed)
+		_wav->setStreamSpeed(speed);
+
+	// Once it's going through the Resampler it stays there until the next
+	// file, so going back to normal speed doesn't jump.
+	if(speed != Resampler::kUnitySpeed && _decode != &WavSource::decodeResampled) {
+		_resampler.reset();
+		_decode = &WavSource::decodeResampled;
+	}
+}
+
+void WavSource::setSpeedInput(const uint32_t *speeds)
+{
+	_resampler.setSpeedInput(speeds);
+	if(speeds && _decode != &WavSource::decodeResampled) {
+		_resampler.reset();
+		_decode = &WavSource::decodeResampled;
+	}
+}
+
+void WavSource::resetDecoder()
+{
+	if(_format == WavFile::kFormatImaAdpcm)
+		_adpcm.reset();
+	else if(_format == WavFile::kFormatRice)
+		_rice.reset();
+}
+
+// The next bytes of sample data, going round between the loop points if
+// it's looping them.
+unsigned WavSource::readData(uint8_t *dest, unsigned nBytes)
+{
+	if(!_loopRegion)
+		return readSource(dest, nBytes);
+
+	unsigned size = 0;
+	while(size < nBytes) {
+		unsigned n = nBytes - size;
+		if(n > _loopLeft)
+			n = _loopLeft;
+
+		unsigned got = readSource(&dest[size], n);
+		size      += got;
+		_loopLeft -= got;
+		if(_loopLeft > 0 || _nextReady)
+			break; // Got it all, the stream ran dry, or it's time for the next file.
+
+		wrapLoop();
+	}
+	return size;
+}
+
+// From the attack (or loop) cache and then the file or its stream.
+unsigned WavSource::readSource(uint8_t *dest, unsigned nBytes)
+{
+	unsigned size = 0;
+
+	unsigned left = _attackLeft;
+	if(left > 0) {
+		size = left < nBytes ? left : nBytes;
+		memcpy(dest, _attack, size);
+		_attack     += size;
+		_attackLeft  = left - size;
+	}
+
+	if(size < nBytes && !_waitStream)
+		size += _wav->readBlock(&dest[size], nBytes - size);
+
+	return size;
+}
+
+unsigned WavSource::decodeAdpcm(AUDIOSAMPLE *out, unsigned frames)
+{
+	return decodeWith(_adpcm, out, frames);
+}
+
+unsigned WavSource::decodeRice(AUDIOSAMPLE *out, unsigned frames)
+{
+	return decodeWith(_rice, out, frames);
+}
+
+// Decodes the file a run at a time into the resampler's input. A loop
+// rewinds the decoder underneath it, so the resampler goes straight on into
+// the start of the file without a click. Runs are shorter going fast, so
+// the input still fits.
+unsigned WavSource::decodeResampled(AUDIOSAMPLE *out, unsigned frames)
+{
+	unsigned done = 0;
+	while(done < frames) {
+		unsigned want = frames - done;
+		unsigned most = _resampler.getMaxOutput();
+		if(want > most)
+			want = most;
+
+		unsigned need = _resampler.getInputNeeded(want);
+		unsigned got  = (this->*_decodeInput)(_resampler.getInput(), need);
+		done += _resampler.process(&out[done], want, got);
+		if(got < need)
+			break;
+	}
+	return done;
+}
+
+// Both decoders take their input a few bytes at a time and say when they
+// need more by decoding fewer frames than asked for.
+template<class Decoder>
+unsigned WavSource::decodeWith(Decoder &decoder, AUDIOSAMPLE *out, unsigned frames)
+{
+	unsigned done = decoder.drain(out, frames);
+	while(done < frames) {
+		uint8_t  in[8];
+		unsigned n = decoder.getInputSize();
+		if(readData(in, n) < n)
+			break;
+
+		decoder.decode(in);
+		done += decoder.drain(&out[done], frames - done);
+	}
+	return done;
+}
+
+// PCM is read straight into the end of the output buffer and expanded
+// forwards from there. 24-bit stereo is bigger than the output so goes a
+// few frames at a time through the stack instead.
+template<unsigned kBits, unsigned kChannels>
+unsigned WavSource::decodePcm(AUDIOSAMPLE *out, unsigned frames)
+{
+	typedef PcmFormat<kBits, kChannels> Format;
+
+	if(Format::kBytes <= sizeof(AUDIOSAMPLE)) {
+		uint8_t *in     = (uint8_t *)&out[frames] - frames * Format::kBytes;
+		unsigned toLoop = _loopLeft / Format::kBytes;
+		unsigned n      = readData(in, frames * Format::kBytes) / Format::kBytes;
+		if(kBits != 16 || kChannels != 2) // Already what we want.
+			Format::convert(out, in, n);
+		if(_loopRegion && _fadeBytes)
+			crossfade<kBits, kChannels>(out, n, toLoop);
+		return n;
+	}
+
+	unsigned done = 0;
+	while(done < frames) {
+		uint8_t  in[8 * Format::kBytes];
+		unsigned want = frames - done;
+		if(want > 8)
+			want = 8;
+
+		unsigned toLoop = _loopLeft / Format::kBytes;
+		unsigned n      = readData(in, want * Format::kBytes) / Format::kBytes;
+		Format::convert(&out[done], in, n);
+		if(_loopRegion && _fadeBytes)
+			crossfade<kBits, kChannels>(&out[done], n, toLoop);
+		done += n;
+		if(n < want)
+			break;
+	}
+	return done;
+}
+
+// Fade the frames just before each loop end out while the ones before the
+// loop start, kept in the loop cache, fade in. toLoop is how many of the
+// frames came before the first loop end; the loop may have gone round more
+// than once if it's short.
+template<unsigned kBits, unsigned kChannels>
+void WavSource::crossfade(AUDIOSAMPLE *out, unsigned frames, unsigned toLoop)
+{
+	typedef PcmFormat<kBits, kChannels> Format;
+
+	unsigned fade = _fadeBytes / Format::kBytes;
+	unsigned len  = (_loopEnd - _loopStart) / Format::kBytes;
+
+	for(unsigned end = toLoop; end < frames + fade; end += len) {
+		unsigned i = end > fade ? end - fade : 0;
+		for(; i < end && i < frames; i++) {
+			unsigned    k       = i + fade - end; // Into the fade.
+			unsigned    p       = ((2 * k + 1) * FADE_STEPS) / (2 * fade);
+			int32_t     fadeIn  = s_fade.g[p];
+			int32_t     fadeOut = s_fade.g[FADE_STEPS - p];
+			AUDIOSAMPLE pre;
+			Format::convert(&pre, &_loopCache[k * Format::kBytes], 1);
+
+			int32_t l = ((int16_t)pre * fadeIn + (int16_t)out[i] * fadeOut + 0x4000) >> 15;
+			int32_t r = (((int32_t)pre >> 16) * fadeIn + ((int32_t)out[i] >> 16) * fadeOut + 0x4000) >> 15;
+			out[i] = ((uint32_t)(uint16_t)saturate16(r) << 16) | (uint16_t)saturate16(l);
+		}
+	}
 }
 
 void WavSource::fillBuffer(AUDIOSAMPLE *buffer)
 {
-	unsigned  size = 0;
-	uint8_t  *dest = (uint8_t *)buffer;
+	unsigned frames = 0;
 
 	if(_isPlaying) {
-		int r = _wav.readBlock(dest, kFrameBytes);
-		if(r >= 0) {
-			size = r;
+		_resampler.startFrame();
+		frames = (this->*_decode)(buffer, kFrameSize);
+
+		// Go straight on into the queued file.
+		while(frames < kFrameSize && _nextReady && isFinished()) {
+			Trace::event(kTraceWavNext, frames);
+			spliceNext();
+			frames += (this->*_decode)(&buffer[frames], kFrameSize - frames);
+		}
+
+		if(frames < kFrameSize && _streamed) {
+			// Short because the sample has finished, or because the card
+			// didn't keep up. The stream stays where it is for whoever stops it.
+			if(_waitStream ? _attackWhole : _wav->isEnd())
+				_isPlaying = false;
+			else
+				Trace::event(kTraceStreamUnderrun, frames);
+		} else if(frames < kFrameSize) {
+			Trace::event(kTraceWavShortRead, frames);
 
 			// Handle looping.
-			while(size < kFrameBytes && _loop) { // This is a while loop because the size of the file might be less than the frame size.
-				_wav.rewind();
-				r = _wav.readBlock(&dest[size], kFrameBytes - size);
-				if(r <= 0)
+			while(frames < kFrameSize && _loop) { // This is a while loop because the size of the file might be less than the frame size.
+				Trace::event(kTraceWavLoop);
+				rewind();
+				unsigned n = (this->*_decode)(&buffer[frames], kFrameSize - frames);
+				if(n == 0)
 					break;
 
-				size += r;
+				frames += n;
+			}
+
+			// Got to the end of a one-shot. Stop so a Mixer can skip us, and
+			// be ready to start again from the top.
+			if(frames < kFrameSize && !_loop) {
+				_isPlaying = false;
+				rewind();
 			}
 		}
 	}
 
 	// Run out of data or not playing. Fill remains of buffer with silence.
-	unsigned remainingSpace = kFrameBytes - size;
-	if(remainingSpace > 0)
-		memset(&dest[size], 0, remainingSpace);
+	if(frames < kFrameSize)
+		memset(&buffer[frames], 0, (kFrameSize - frames) * sizeof(AUDIOSAMPLE));
 
 	// Convert to unsigned data.
 	//convert16((uint16_t *)buffer, kFrameSize * 2);
 
-	// Quieten it down a bit (temporary).
-	int16_t *samp = (int16_t *)buffer;
-	for(unsigned i = 0; i < kFrameSize * 2; i++)
-		samp[i] = samp[i] / 4;
-
-	// TODO: Different conversions for 8-bit or mono or different sample rates.
+	_gain.process(buffer, kFrameSize);
 }
 
 // Convert 16-bit samples from signed (as used by WAV files) to unsigned (as used by I2S).
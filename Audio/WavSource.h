@@ -9,8 +9,18 @@
 #define AUDIO_WAVSOURCE_H_
 
 #include "AudioSource.h"
+#include "AttackCache.h"
+#include "GainStage.h"
+#include "ImaAdpcm.h"
+#include "Resampler.h"
+#include "RiceLossless.h"
 #include "WavFile.h"
 
+// Plays WAV files: 8, 16 or 24-bit PCM, IMA ADPCM or Rice lossless, mono
+// or stereo. Mono comes out of both channels. Files at other sample rates
+// than the output (up to Resampler::kMaxRate) go through a Resampler, set
+// up for the output rate at the time the file is opened. The Resampler also
+// does varispeed.
 class WavSource
     : public AudioSource
 {
@@ -18,20 +28,180 @@ public:
 	WavSource();
 	virtual ~WavSource();
 
-	bool open(const TCHAR *filename);
+	// If streamed is set the file is read by the StreamScheduler in the main
+	// loop rather than in fillBuffer(). open(), close(), play() and stop()
+	// must then all be called from the main loop.
+	// Otherwise the audio interrupt reads the card, and FatFs isn't
+	// re-entrant, so while it's playing the audio interrupt is held off
+	// whenever the main loop is in FatFs (see Filesystem). A slow open()
+	// or queueNext() in the main loop can then cost a glitch.
+	bool open(const TCHAR *filename, bool streamed = false);
 	void close();
 
-	void play(bool loop = false);
+	bool play(bool loop = false); // False if a streamed file can't be fitted in.
 	void stop();
 
+	// Start playing straight away from data already in RAM (see AttackCache),
+	// before the file has been opened. Then open() the file with streamed
+	// set and play() it, and it carries on after the cached part. If the
+	// cache has the whole sample a one-shot just ends with it.
+	// Can be called from the audio interrupt or with interrupts masked.
+	void playAttack(const AttackCache::Entry *attack, bool loop = false);
+
+	// Queue the file to play after this one, without a gap: it's opened and
+	// its header read now, and streamed the same as this one its stream is
+	// started so the first sectors are in the ring by the time it's needed.
+	// It goes on at the sample after this one's last, in the same frame. A
+	// looping PCM file finishes the time round it's on (looping between
+	// loop points without a loop cache from then on); other loops don't end
+	// so it's refused for them if streamed, and for an attack that's still
+	// waiting for its file. Queueing again replaces it; stop() or open()
+	// drop it. A crossfade is two voices with their gains ramped.
+	// There's one WavFile to queue into, shared by all the WavSources. After
+	// the splice it's the one playing, and the next file queues into this
+	// one's own. So it's only free again once the playing file is back in
+	// our own one, or at open() and close().
+	// Fails if the file can't be opened, there's no stream for it, or
+	// another WavSource has the shared file.
+	bool queueNext(const TCHAR *filename, bool loop = false);
+	bool isNextQueued() const { return _nextReady; } // Not gone on to it yet.
+
+	// Main loop. Stops the stream of the file spliced out of, so it isn't
+	// still taking card time, and closes it.
+	void poll();
+
+	// Play files backwards, from the end to the start (and round again if
+	// looped). Set it before open(), which fails for a file that can't go
+	// backwards: only 8 and 16-bit PCM can. Not for use with playAttack(),
+	// the cache has the start of the file.
+	void setReverse(bool reverse) { _reverse = reverse; }
+	bool isReverse() const        { return _reverse; }
+
+	bool isPlaying() const { return _isPlaying; }
+	bool isOpen()    const { return _wav->isOpen(); }
+
+	// Volume, see GainStage for the units. Changes ramp over a frame except
+	// with setGainNow().
+	void setGain(unsigned left, unsigned right) { _gain.setGain(left, right); }
+	void setGain(unsigned gain)                 { _gain.setGain(gain); }
+	void setGainNow(unsigned gain)              { _gain.jumpTo(gain, gain); }
+
+	// Play faster or slower, pitch and all. Q16.16, Resampler::kUnitySpeed
+	// is normal speed and it goes up to Resampler::kMaxSpeed. Changes glide
+	// over a few milliseconds, so it can be swept or modulated every frame.
+	// It's set before play() for a file at the output rate, that starts
+	// resampling with a few frames of silence behind it. A streamed file
+	// needs a ring big enough for a frame at the speed it's played at.
+	// Can be called from the audio interrupt or with interrupts masked.
+	void     setSpeed(uint32_t speed);
+	uint32_t getSpeed() const { return _resampler.getSpeed(); }
+
+	// Audio rate speed, a speed for every output frame (see
+	// Resampler::setSpeedInput()), refilled before each fillBuffer(). 0
+	// goes back to setSpeed(). A streamed file's bandwidth still comes from
+	// setSpeed(), so set that to the fastest the input goes.
+	void setSpeedInput(const uint32_t *speeds);
+
+	// How varispeed and sample rate conversion work out the samples between
+	// the file's. Linear and Hermite are cheaper than the FIR (see
+	// Benchmark), which doesn't filter out aliasing going faster anyway.
+	void setInterpolation(Resampler::Interpolation interpolation) { _resampler.setInterpolation(interpolation); }
+
+	// Loop between two points, in frames (the end one not included), rather
+	// than round the whole file. open() sets them from the file's smpl chunk
+	// if it has one, change them after that and before play(). Only for PCM,
+	// the other formats loop the whole file. PCM loops wrap in the middle of
+	// a read without going back to the card, and streamed ones carry on
+	// from the loop start in the ring. A loop that fits in a loop cache (see
+	// LOOP_CACHE_ENABLE) plays from there; streaming one much shorter than
+	// a frame would keep running the ring dry. Without a cache a loop that
+	// isn't streamed seeks the card from the audio interrupt as it wraps,
+	// like the rest of its reads.
+	void     setLoopPoints(unsigned start, unsigned end);
+	unsigned getLoopStart() const;
+	unsigned getLoopEnd()   const;
+
+	// Crossfade the end of a PCM loop into what comes before its start over
+	// this many frames, equal power, so it goes round without a click
+	// whatever the two ends look like. Set before play(). It needs a loop
+	// cache, so without LOOP_CACHE_ENABLE in board.h this returns false and
+	// loops don't fade. The fade is cut short to what fits in the cache, and
+	// there's none if they were all taken when play() started, so
+	// getLoopFade() says what play() really got.
+	bool     setLoopFade(unsigned frames);
+	unsigned getLoopFade() const;
+
 	virtual void fillBuffer(AUDIOSAMPLE *buffer);
+	virtual bool isActive() const { return _isPlaying; } // Even when turned down, see AudioSource.
 
 private:
-	WavFile _wav;
-	bool    _loop;
-	bool    _isPlaying;
+	WavFile         _file;     // Our own.
+	WavFile        *_wav;      // The one playing, our own or the shared one.
+	GainStage       _gain;
+	uint16_t        _format;
+	bool            _loop;
+	bool            _streamed;
+	bool            _isPlaying;
+	bool            _cardReader; // Counted in Filesystem::addInterruptReader().
+
+	const uint8_t    *volatile _attack; // Cached data still to play.
+	volatile unsigned          _attackLeft;
+	unsigned                   _attackBytes;
+	bool                       _attackWhole;
+	volatile bool              _waitStream; // Not our stream yet, don't read it.
+	bool                       _reverse;
+	volatile bool              _nextReady;
+	bool                       _nextLoop;
+
+	// Looping between the loop points, all in bytes of data. The start of
+	// the loop, and the frames before it that are faded in, are in the loop
+	// cache if there is one. It's played through _attack after the wrap.
+	bool     _loopRegion;
+	unsigned _loopStart;
+	unsigned _loopEnd;
+	unsigned _loopLeft;  // Till the wrap.
+	unsigned _loopFade;  // Frames asked for.
+	unsigned _fadeBytes; // Before _loopStart, at the start of the cache.
+	unsigned _loopCached;
+	uint8_t *_loopCache;
+
+	// Turns the file's data into up to frames frames of 16-bit stereo and
+	// returns how many there were. Chosen for the format when the file is
+	// opened, so there's no deciding what to do for every sample.
+	typedef unsigned (WavSource::*DecodeFunction)(AUDIOSAMPLE *out, unsigned frames);
+	DecodeFunction _decode;
+	DecodeFunction _decodeInput; // What decodeResampled() reads from.
+	Resampler      _resampler;
+
+	// Only one is in use at a time, whichever _format needs.
+	union {
+		ImaAdpcmDecoder _adpcm;
+		RiceDecoder     _rice;
+	};
 
-	void convert16(uint16_t *data, unsigned count);
+	unsigned readData(uint8_t *dest, unsigned nBytes);
+	unsigned readSource(uint8_t *dest, unsigned nBytes);
+	void     startLoop();
+	void     wrapLoop();
+	uint8_t *getLoopCache();
+	void     releaseLoopCache();
+	template<unsigned kBits, unsigned kChannels> void crossfade(AUDIOSAMPLE *out, unsigned frames, unsigned toLoop);
+	WavFile *getNext();
+	void     dropNext();
+	void     useOwnFile();
+	void     setCardReader(bool reader);
+	bool     isFinished();
+	void     spliceNext();
+	void     setFormat(unsigned format, unsigned channels, unsigned blockAlign, unsigned dataSize, unsigned sampleRate,
+	                   bool keepHistory = false);
+	void     resetDecoder();
+	unsigned decodeAdpcm(AUDIOSAMPLE *out, unsigned frames);
+	unsigned decodeRice(AUDIOSAMPLE *out, unsigned frames);
+	unsigned decodeResampled(AUDIOSAMPLE *out, unsigned frames);
+	template<class Decoder> unsigned decodeWith(Decoder &decoder, AUDIOSAMPLE *out, unsigned frames);
+	template<unsigned kBits, unsigned kChannels> unsigned decodePcm(AUDIOSAMPLE *out, unsigned frames);
+	void     rewind();
+	void     convert16(uint16_t *data, unsigned count);
 };
 
 #endif /* AUDIO_WAVSOURCE_H_ */
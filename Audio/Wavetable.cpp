@@ -0,0 +1,73 @@
+/*
+ * Wavetable.cpp - Single cycle wave tables in flash, for the oscillators.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "Wavetable.h"
+#include "ConstexprMath.h"
+
+// Harmonics in each saw, half as many each octave up. 63 is the most a
+// table of 128 can hold.
+static constexpr unsigned harmonics(unsigned level)
+{
+	return level == 0 ? Wavetable::kSize / 2 - 1 : Wavetable::kSize / 2 >> level;
+}
+
+// The saw's Fourier series, (2 / pi) sum of -(-1)^n sin(nx) / n, with
+// sin(nx) from the two before it so there's only one real sin() per sample.
+static constexpr double saw(unsigned level, unsigned i)
+{
+	double x    = 2 * ConstexprMath::kPi * i / Wavetable::kSize;
+	double c    = 2 * ConstexprMath::cos(x);
+	double prev = 0;
+	double now  = ConstexprMath::sin(x);
+	double sum  = 0;
+	for(unsigned n = 1; n <= harmonics(level); n++) {
+		sum += (n & 1 ? now : -now) / n;
+		double next = c * now - prev;
+		prev = now;
+		now  = next;
+	}
+	return sum * 2 / ConstexprMath::kPi;
+}
+
+constexpr Wavetable::Wavetable()
+	: sine()
+	, saw()
+{
+	for(unsigned i = 0; i < kSize; i++)
+		sine[i] = ConstexprMath::round(ConstexprMath::sin(2 * ConstexprMath::kPi * i / kSize) * 32767);
+
+	// One scale for every level so they're all as loud, small enough that
+	// the biggest square (with its ringing) still fits.
+	double peak = 0;
+	for(unsigned l = 0; l < kSawLevels; l++) {
+		for(unsigned i = 0; i < kSize / 2; i++) {
+			double square = ::saw(l, i) - ::saw(l, i + kSize / 2);
+			if(ConstexprMath::abs(square) > peak)
+				peak = ConstexprMath::abs(square);
+			if(ConstexprMath::abs(::saw(l, i)) > peak)
+				peak = ConstexprMath::abs(::saw(l, i));
+		}
+	}
+
+	for(unsigned l = 0; l < kSawLevels; l++) {
+		for(unsigned i = 0; i < kSize; i++)
+			saw[l][i] = ConstexprMath::round(::saw(l, i) * 32767 / peak);
+	}
+}
+
+constexpr Wavetable g_wavetable;
+
+// The harmonics of a note go up to half the sample rate at an increment of
+// 2^31 per harmonic.
+const int16_t *Wavetable::sawFor(uint32_t increment)
+{
+	uint32_t room = increment ? 0x80000000u / increment : 0xFFFFFFFF;
+	unsigned l = 0;
+	while(l < kSawLevels - 1 && harmonics(l) > room)
+		l++;
+	return g_wavetable.saw[l];
+}
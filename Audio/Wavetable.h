@@ -0,0 +1,61 @@
+/*
+ * Wavetable.h - Single cycle wave tables in flash, for the oscillators.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef AUDIO_WAVETABLE_H_
+#define AUDIO_WAVETABLE_H_
+
+#include <stdint.h>
+
+// One cycle of a sine and of band-limited saws, kSize 16-bit samples each,
+// worked out by the compiler and shared by everything that plays them. The
+// phase is a full turn in 32 bits, so it wraps round by itself, and the top
+// kBits pick the sample.
+//
+// A saw has every harmonic, so played as it is the ones over half the
+// sample rate would alias. There's a saw for each octave with only the
+// harmonics that fit (mip levels), from 63 of them for notes under 350Hz
+// down to just the fundamental over a quarter of the sample rate. Square
+// waves come from subtracting a saw from itself half a cycle on, which
+// leaves the odd harmonics, so they don't need tables of their own. The
+// saws are scaled so that fits in 16 bits. 2k of flash in all, 128 samples
+// a table keeps it in budget. Linear interpolation between the sine's
+// samples is out by 0.03% of full scale at most.
+struct Wavetable
+{
+	enum {
+		kBits      = 7,
+		kSize      = 1 << kBits,
+		kSawLevels = kBits // The last has just the fundamental.
+	};
+
+	int16_t sine[kSize];
+	int16_t saw[kSawLevels][kSize];
+
+	constexpr Wavetable();
+
+	// Phase per sample for a frequency (Q16.16 Hz) at a sample rate.
+	static uint32_t increment(uint32_t frequency, unsigned rate)
+	{
+		return (uint32_t)(((uint64_t)frequency << 16) / rate);
+	}
+
+	// The saw with as many harmonics as will go at this phase increment.
+	static const int16_t *sawFor(uint32_t increment);
+
+	// Linear interpolation between the two samples the phase is between.
+	static inline int32_t lookup(const int16_t *table, uint32_t phase)
+	{
+		unsigned i = phase >> (32 - kBits);
+		int32_t  a = table[i];
+		int32_t  b = table[(i + 1) & (kSize - 1)];
+		return a + (((b - a) * (int32_t)((phase >> (17 - kBits)) & 0x7FFF)) >> 15);
+	}
+};
+
+extern const Wavetable g_wavetable;
+
+#endif /* AUDIO_WAVETABLE_H_ */
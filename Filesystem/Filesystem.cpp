@@ -96,6 +96,19 @@ bool File::seek(int offset, SeekMode mode)
 	return FR_OK == rslt;
 }
 
+bool File::mapClusters(DWORD *table, unsigned entries)
+{
+	DriveLight led;
+
+	table[0] = entries;
+	_f.cltbl = table;
+	if(FR_OK == f_lseek(&_f, CREATE_LINKMAP))
+		return true;
+
+	_f.cltbl = 0;
+	return false;
+}
+
 
 #if 0
 // Other functions I might like to add.
@@ -157,6 +170,70 @@ Filesystem::Filesystem()
 	f_mount(&_fs, "0", 1);
 }
 
+bool Filesystem::exists(const TCHAR *filename)
+{
+	// f_stat() is left out at _FS_MINIMIZE 1, so open it to see.
+	DriveLight led;
+	FIL file;
+	if(FR_OK != f_open(&file, filename, FA_READ))
+		return false;
+	f_close(&file);
+	return true;
+}
+
+// How many are reading the card from the audio interrupt.
+static volatile unsigned s_interruptReaders = 0;
+
+// Whether ff_req_grant() turned the audio interrupt off, to put it back.
+static bool s_heldOff = false;
+
+void Filesystem::addInterruptReader()
+{
+	s_interruptReaders++;
+}
+
+void Filesystem::removeInterruptReader()
+{
+	if(s_interruptReaders > 0)
+		s_interruptReaders--;
+}
+
+// FatFs calls these round every file operation with _FS_REENTRANT set.
+// There's no RTOS, the only other user is the audio interrupt, so the main
+// loop holds it off for the length of the call. The interrupt can't be
+// interrupted by the main loop so it has nothing to wait for. One volume,
+// one lock, no nesting (FatFs doesn't call itself).
+extern "C" int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	*sobj = vol;
+	return 1;
+}
+
+extern "C" int ff_del_syncobj(_SYNC_t sobj)
+{
+	return 1;
+}
+
+extern "C" int ff_req_grant(_SYNC_t sobj)
+{
+	if(s_interruptReaders == 0 || __get_IPSR() != 0)
+		return 1;
+
+	// Leave it off if it wasn't on, e.g. before the audio has started.
+	s_heldOff = 0 != (NVIC->ISER[0] & (1UL << FLEXIO_DMA_IRQN));
+	if(s_heldOff)
+		NVIC_DisableIRQ(FLEXIO_DMA_IRQN);
+	return 1;
+}
+
+extern "C" void ff_rel_grant(_SYNC_t sobj)
+{
+	if(__get_IPSR() != 0 || !s_heldOff)
+		return;
+	s_heldOff = false;
+	NVIC_EnableIRQ(FLEXIO_DMA_IRQN);
+}
+
 #ifdef OLD
 Filesystem::Filesystem()
 	: _csPort(SDCARD_CS_PORT)
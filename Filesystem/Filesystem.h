@@ -40,6 +40,13 @@ public:
 	unsigned tell()  const;
 	bool     seek(int offset, SeekMode mode = SEEK_SET);
 
+	// Make a map of where the file's clusters are, so seek() goes straight
+	// there rather than following the FAT chain from the start of the file.
+	// It takes two entries for each contiguous piece of the file plus two
+	// more, and must stay around until the file is closed. False if the file
+	// is in too many pieces, then seeks work the slow way.
+	bool mapClusters(DWORD *table, unsigned entries);
+
 #ifndef SDCARD_READONLY
 	int  write(const uint8_t *data, int size);
 #endif // SDCARD_READONLY
@@ -53,6 +60,14 @@ class Filesystem
 public:
 	Filesystem();
 
+	bool exists(const TCHAR *filename);
+
+	// FatFs isn't re-entrant, so while anything reads the card from the
+	// audio interrupt (an unstreamed WavSource) the interrupt is held off
+	// whenever the main loop is in FatFs. Count them in and out here.
+	static void addInterruptReader();
+	static void removeInterruptReader();
+
 private:
 	SDCard _card;
 	FATFS  _fs;
@@ -9,6 +9,7 @@
 
 #include "SDCard.h"
 #include "SystemTick.h"
+#include "Trace.h"
 
 // There is a lot of commented out code here. This is all example code stuff
 // which I might want to use for additional functionality in the future.
@@ -49,8 +50,10 @@ enum SDCommand
 {
 	SDCARD_CMD_GO_IDLE_STATE    =  0,
 	SDCARD_CMD_SEND_IF_COND     =  8,
+	SDCARD_CMD_STOP_TRANS       = 12,
 	SDCARD_CMD_SET_BLOCKLEN     = 16,
 	SDCARD_CMD_READ_BLOCK       = 17,
+	SDCARD_CMD_READ_MULTIPLE    = 18,
 	SDCARD_CMD_WRITE_BLOCK      = 24,
 	SDCARD_CMD_APP_CMD          = 55,
 	SDCARD_CMD_READ_CCS         = 58,
@@ -93,13 +96,20 @@ bool SDCard::getStatus()
 
 bool SDCard::readBlocks(uint8_t *buffer, unsigned startBlock, unsigned blockCount)
 {
-	for(unsigned i = 0; i < blockCount; i++) {
-		if(!readSector(startBlock, buffer))
-			return false;
+	Trace::event(kTraceSdReadStart, startBlock);
 
-		startBlock++;
-		buffer += getBlockSize();
+	bool ok;
+	if(blockCount == 1)
+		ok = readSector(startBlock, buffer);
+	else
+		ok = readSectors(startBlock, buffer, blockCount);
+
+	if(!ok) {
+		Trace::event(kTraceSdError, startBlock);
+		return false;
 	}
+
+	Trace::event(kTraceSdReadEnd, blockCount);
 	return true;
 }
 
@@ -122,6 +132,46 @@ bool SDCard::readSector(unsigned sector, uint8_t *buffer)
 		return false;
 	}
 
+	bool ok = receiveBlock(buffer);
+	deselect();
+	return ok;
+}
+
+// Read a run of consecutive sectors with one command (CMD18). The card only
+// has to find the data once, which is a lot quicker than a CMD17 for each
+// sector.
+bool SDCard::readSectors(unsigned sector, uint8_t *buffer, unsigned count)
+{
+	select();
+	if(!getStatus()) {
+		deselect();
+		return false;
+	}
+
+	if(!isHighCapacity())
+		sector <<= 9;
+
+	if(command(SDCARD_CMD_READ_MULTIPLE, sector) != 0) {
+		deselect();
+		return false;
+	}
+
+	while(count > 0) {
+		if(!receiveBlock(buffer))
+			break;
+
+		buffer += kBlockSize;
+		count--;
+	}
+
+	stopTransmission();
+	deselect();
+	return count == 0;
+}
+
+// Receive one data block once a read command has been accepted.
+bool SDCard::receiveBlock(uint8_t *buffer)
+{
 	Timeout t(1000);
 	while(!t.isExpired())
 	{
@@ -139,16 +189,37 @@ bool SDCard::readSector(unsigned sector, uint8_t *buffer)
 			//_spi.exchange((uint8_t *)&checksum, (uint8_t *)&checksum, sizeof(checksum));
 			uint16_t checksum;
 			_spi.recv((uint8_t *)&checksum, sizeof(checksum));
-
-			deselect();
 			return true;
 		}
 	}
 
-	deselect();
 	return false; // Timeout with no data received.
 }
 
+// End a multiple block read (CMD12). This can't go through command() as the
+// card is still sending data so it won't look ready.
+bool SDCard::stopTransmission()
+{
+	uint8_t req[6];
+	req[0] = 0x40 | SDCARD_CMD_STOP_TRANS;
+	req[1] = req[2] = req[3] = req[4] = 0;
+	req[5] = (crc7(req, 5) << 1) | 1;
+	_spi.send(req, sizeof(req));
+
+	// Skip the stuff byte then wait for the response.
+	_spi.recv();
+	uint8_t response = 0xFF;
+	for(int i = 0; i < 10; i++)
+	{
+		response = _spi.recv();
+		if(0 == (response & 0x80))
+			break;
+	}
+
+	// R1b response, the card holds the line low while it is busy.
+	return response == 0 && waitReady();
+}
+
 
 // Write a 512-byte block of data to the card.
 bool SDCard::writeSector(unsigned sector, const uint8_t *buffer)
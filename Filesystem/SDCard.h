@@ -208,6 +208,9 @@ private:
 		void     select();
 		void     deselect();
 		bool     readSector(unsigned sector, uint8_t *buffer);
+		bool     readSectors(unsigned sector, uint8_t *buffer, unsigned count);
+		bool     receiveBlock(uint8_t *buffer);
+		bool     stopTransmission();
 		bool     writeSector(unsigned sector, const uint8_t *buffer);
 		bool     isHighCapacity() const;
 		uint8_t  command(uint8_t cmd, uint32_t arg);
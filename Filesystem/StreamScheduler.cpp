@@ -0,0 +1,383 @@
+/*
+ * StreamScheduler.cpp - Keeps several file streams fed from the SD card.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "StreamScheduler.h"
+#include "SystemTick.h"
+#include "Trace.h"
+#include <string.h>
+
+// The ring buffers live here rather than in the Stream objects so the
+// streams themselves are small enough to come from the memory pools.
+static uint32_t s_rings[StreamScheduler::kMaxStreams][StreamScheduler::kRingBytes / sizeof(uint32_t)];
+
+Stream  *StreamScheduler::s_stream[kMaxStreams];
+unsigned StreamScheduler::s_bandwidth = STREAM_DEFAULT_BANDWIDTH;
+unsigned StreamScheduler::s_committed = 0;
+
+Stream::Stream()
+	: _f(0)
+	, _ring(0)
+	, _rate(0)
+	, _start(0)
+	, _end(0)
+	, _loopStart(0)
+	, _filePos(0)
+	, _wr(0)
+	, _rd(0)
+	, _wrIdx(0)
+	, _rdIdx(0)
+	, _seekPos(0)
+	, _need(StreamScheduler::kRingBytes)
+	, _seekReq(0)
+	, _seekAck(0)
+	, _eof(false)
+	, _loop(false)
+	, _slot(0)
+	, _reverse(0)
+{
+}
+
+bool Stream::start(File *f, unsigned start, unsigned length, unsigned bytesPerSecond, bool loop, unsigned loopStart,
+                   unsigned skip, unsigned reverse)
+{
+	stop();
+
+	if(!StreamScheduler::admit(bytesPerSecond)) {
+		Trace::event(kTraceStreamRefused, bytesPerSecond);
+		return false;
+	}
+
+	unsigned slot;
+	for(slot = 0; slot < StreamScheduler::kMaxStreams; slot++) {
+		if(StreamScheduler::s_stream[slot] == 0)
+			break;
+	}
+	if(slot >= StreamScheduler::kMaxStreams) {
+		Trace::event(kTraceStreamRefused, bytesPerSecond);
+		return false;
+	}
+
+	_f         = f;
+	_rate      = bytesPerSecond ? bytesPerSecond : 1;
+	_start     = start;
+	_end       = start + length;
+	_loop      = loop;
+	_loopStart = (loopStart >= start && loopStart < _end) ? loopStart : start;
+	_filePos   = start + (skip < length ? skip : length);
+	if(_filePos >= _end && loop)
+		_filePos = _loopStart;
+	_need      = StreamScheduler::kRingBytes;
+	_wr        = 0;
+	_rd        = 0;
+	_wrIdx     = 0;
+	_rdIdx     = 0;
+	_seekReq   = 0;
+	_seekAck   = 0;
+	_eof       = (_filePos >= _end);
+	_slot      = slot;
+	_reverse   = reverse;
+	if(reverse) {
+		_filePos = _end; // Each read seeks for itself.
+		_eof     = (length == 0);
+	} else {
+		_f->seek(_filePos);
+		StreamScheduler::align(this);
+	}
+
+	// Hand it to the scheduler last, the audio interrupt can read as soon
+	// as the ring is set.
+	_ring = (uint8_t *)s_rings[slot];
+	StreamScheduler::s_committed += _rate;
+	StreamScheduler::s_stream[slot] = this;
+	return true;
+}
+
+void Stream::stop()
+{
+	if(_ring == 0)
+		return;
+
+	StreamScheduler::s_stream[_slot] = 0;
+	StreamScheduler::s_committed -= _rate;
+	_ring = 0;
+}
+
+unsigned Stream::read(uint8_t *dest, unsigned nBytes, unsigned granule)
+{
+	uint8_t *ring = _ring;
+	if(ring == 0 || _seekReq != _seekAck)
+		return 0;
+
+	unsigned rd    = _rd;
+	unsigned avail = _wr - rd;
+	if(nBytes > avail)
+		nBytes = avail - (granule > 1 ? avail % granule : 0);
+
+	unsigned idx   = _rdIdx;
+	unsigned first = StreamScheduler::kRingBytes - idx;
+	if(first > nBytes)
+		first = nBytes;
+	memcpy(dest, &ring[idx], first);
+	memcpy(dest + first, ring, nBytes - first);
+
+	idx += nBytes;
+	if(idx >= StreamScheduler::kRingBytes)
+		idx -= StreamScheduler::kRingBytes;
+	_rdIdx = idx;
+	_rd    = rd + nBytes;
+	return nBytes;
+}
+
+void Stream::seek(unsigned position)
+{
+	_seekPos = position;
+	_seekReq++;
+}
+
+void Stream::reverseFrames(uint8_t *data, unsigned nBytes, unsigned frameBytes)
+{
+	if(frameBytes == 4) {
+		uint32_t *lo = (uint32_t *)data;
+		uint32_t *hi = (uint32_t *)(data + nBytes) - 1;
+		while(lo < hi) {
+			uint32_t t = *lo;
+			*lo++ = *hi;
+			*hi-- = t;
+		}
+	} else if(frameBytes == 2) {
+		uint16_t *lo = (uint16_t *)data;
+		uint16_t *hi = (uint16_t *)(data + nBytes) - 1;
+		while(lo < hi) {
+			uint16_t t = *lo;
+			*lo++ = *hi;
+			*hi-- = t;
+		}
+	} else {
+		uint8_t *lo = data;
+		uint8_t *hi = data + nBytes - 1;
+		while(lo < hi) {
+			uint8_t t = *lo;
+			*lo++ = *hi;
+			*hi-- = t;
+		}
+	}
+}
+
+bool Stream::isEnd() const
+{
+	return _ring == 0 || (_eof && _wr == _rd && _seekReq == _seekAck);
+}
+
+bool StreamScheduler::admit(unsigned bytesPerSecond)
+{
+	return s_committed + bytesPerSecond <= s_bandwidth / 100 * STREAM_BANDWIDTH_MARGIN;
+}
+
+unsigned StreamScheduler::getMaxStreams(unsigned bytesPerSecond)
+{
+	if(bytesPerSecond == 0)
+		return kMaxStreams;
+
+	unsigned n = s_bandwidth / 100 * STREAM_BANDWIDTH_MARGIN / bytesPerSecond;
+	return n < kMaxStreams ? n : kMaxStreams;
+}
+
+// With the ring empty, move both ends of it to the same place in a sector
+// as the file is. Then a read which fills to the end of the ring finishes
+// on a sector boundary in the file, and the next one starts on one, so
+// FatFs can hand the card whole runs of sectors (CMD18) straight into the
+// ring. Sample data starts 44 bytes or so into a WAV file, so without this
+// every read would straddle a sector.
+void StreamScheduler::align(Stream *s)
+{
+	unsigned idx = s->_filePos % SDCard::kBlockSize;
+	s->_wrIdx = idx;
+	s->_rdIdx = idx;
+}
+
+// Throw away what is in the ring and start again from wherever the consumer
+// asked for. The consumer leaves the ring alone until _seekAck catches up.
+void StreamScheduler::restart(Stream *s)
+{
+	uint8_t req = s->_seekReq;
+
+	unsigned pos = s->_seekPos;
+	if(pos < s->_start || pos > s->_end)
+		pos = s->_start;
+
+	s->_filePos = pos;
+	if(s->_reverse) {
+		s->_eof = (pos <= s->_start);
+	} else {
+		s->_f->seek(pos);
+		s->_eof = (pos >= s->_end);
+	}
+	s->_rd = s->_wr;
+	if(!s->_reverse)
+		align(s);
+	else
+		s->_rdIdx = s->_wrIdx;
+
+	s->_seekAck = req;
+}
+
+// Read n bytes from the stream's file into its ring at idx. Returns how
+// many were read, 0 if there was a card error or the file is shorter than
+// it said, in which case the stream gives up rather than keep trying.
+int StreamScheduler::read(Stream *s, unsigned idx, unsigned n)
+{
+	uint32_t t = SystemTick::getMicroseconds();
+	int r = s->_f->read(&s->_ring[idx], n);
+	t = SystemTick::getMicroseconds() - t;
+
+	if(r <= 0) {
+		Trace::event(kTraceSdError, s->_filePos);
+		s->_eof = true;
+		return 0;
+	}
+
+	// Keep a running average of how fast the card is going. Only count
+	// whole sectors, little reads are mostly overhead.
+	if(r >= (int)SDCard::kBlockSize && t > 0) {
+		unsigned rate = (unsigned)(((uint64_t)r * 1000000) / t);
+		s_bandwidth = (s_bandwidth * 7 + rate) / 8;
+	}
+	return r;
+}
+
+// Read as much as will fit into the stream's ring.
+void StreamScheduler::fill(Stream *s)
+{
+	if(s->_reverse) {
+		fillReverse(s);
+		return;
+	}
+
+	unsigned wr    = s->_wr;
+	unsigned space = kRingBytes - (wr - s->_rd);
+	unsigned idx   = s->_wrIdx;
+
+	unsigned n = kRingBytes - idx; // Up to the end of the ring.
+	if(n > space)
+		n = space;
+
+	unsigned left = s->_end - s->_filePos;
+	unsigned over = (s->_filePos + n) % SDCard::kBlockSize;
+	if(n >= left) {
+		n = left;
+	} else if(n > over) {
+		// Finish on a sector boundary in the file. Then the next read starts
+		// on one too and FatFs can read whole sectors straight into the ring.
+		n -= over;
+	}
+
+	int r = read(s, idx, n);
+	if(r == 0)
+		return;
+
+	s->_filePos += r;
+	s->_wrIdx = idx + r < kRingBytes ? idx + r : idx + r - kRingBytes;
+	s->_wr = wr + r;
+
+	if(s->_filePos >= s->_end) {
+		if(s->_loop) {
+			s->_filePos = s->_loopStart;
+			s->_f->seek(s->_loopStart);
+		} else {
+			s->_eof = true;
+		}
+	}
+}
+
+// The same going backwards: read the piece of the file just before
+// _filePos, as much as fits, then turn it round so the ring still comes out
+// in the order it's played. The reads are the same size as going forwards,
+// starting on a sector boundary (or the first frame after one) rather than
+// finishing on one, so the card does just the same work.
+void StreamScheduler::fillReverse(Stream *s)
+{
+	unsigned frame = s->_reverse;
+	unsigned wr    = s->_wr;
+	unsigned space = kRingBytes - (wr - s->_rd);
+	unsigned idx   = s->_wrIdx;
+
+	unsigned n = kRingBytes - idx;
+	if(n > space)
+		n = space;
+
+	unsigned left = s->_filePos - s->_start;
+	if(n >= left) {
+		n = left;
+	} else if(n > SDCard::kBlockSize) {
+		unsigned from = s->_filePos - n;
+		from += (SDCard::kBlockSize - from % SDCard::kBlockSize) % SDCard::kBlockSize;
+		from += (frame - (from - s->_start) % frame) % frame;
+		if(from < s->_filePos)
+			n = s->_filePos - from;
+	}
+
+	unsigned from = s->_filePos - n;
+	s->_f->seek(from);
+	if(read(s, idx, n) < (int)n) {
+		s->_eof = true; // Can't carry on backwards from a short read.
+		return;
+	}
+
+	Stream::reverseFrames(&s->_ring[idx], n, frame);
+	s->_filePos = from;
+	s->_wrIdx = idx + n < kRingBytes ? idx + n : idx + n - kRingBytes;
+	s->_wr = wr + n;
+
+	if(s->_filePos <= s->_start) {
+		if(s->_loop)
+			s->_filePos = s->_end;
+		else
+			s->_eof = true;
+	}
+}
+
+void StreamScheduler::poll()
+{
+	Stream  *best     = 0;
+	unsigned bestFill = 0;
+
+	for(unsigned i = 0; i < kMaxStreams; i++) {
+		Stream *s = s_stream[i];
+		if(s == 0)
+			continue;
+
+		if(s->_seekReq != s->_seekAck)
+			restart(s);
+
+		if(s->_eof)
+			continue;
+
+		// Nothing to do if the ring is full, or if there's no room up to
+		// the next sector boundary and it has enough for the next frame.
+		// Topping it up past the boundary every time would leave it ending
+		// wherever the audio interrupt got to, so every read after would
+		// straddle a sector.
+		unsigned fill  = s->getFill();
+		unsigned space = kRingBytes - fill;
+		unsigned left  = s->_reverse ? s->_filePos - s->_start : s->_end - s->_filePos;
+		if(space == 0)
+			continue;
+		if(!s->_reverse && fill >= s->_need && space < left &&
+		   space < SDCard::kBlockSize - s->_filePos % SDCard::kBlockSize)
+			continue;
+
+		// Earliest deadline first. Time to empty is fill / rate, cross
+		// multiply to compare without dividing.
+		if(best == 0 || fill * best->_rate < bestFill * s->_rate) {
+			best     = s;
+			bestFill = fill;
+		}
+	}
+
+	if(best)
+		fill(best);
+}
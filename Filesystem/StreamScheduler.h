@@ -0,0 +1,124 @@
+/*
+ * StreamScheduler.h - Keeps several file streams fed from the SD card.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef FILESYSTEM_STREAMSCHEDULER_H_
+#define FILESYSTEM_STREAMSCHEDULER_H_
+
+#include "board.h"
+#include "Filesystem.h"
+
+// A Stream reads part of a File into a ring buffer in the main loop so the
+// audio interrupt can take the data out without ever touching the card or
+// FatFs. There is one producer (StreamScheduler::poll() in the main loop)
+// and one consumer (read() in the audio interrupt) so no locking is needed.
+//
+// Once a stream has been started, its File belongs to the scheduler. Don't
+// read or seek it yourself until the stream has been stopped.
+class Stream
+{
+public:
+	Stream();
+	~Stream() { stop(); }
+
+	// Main loop only. Stream length bytes from start, consumed at
+	// bytesPerSecond. If loop is set, go back to loopStart (which must be
+	// between start and start + length) each time the end is reached. The
+	// first skip bytes aren't read the first time through (the caller
+	// already has them). Returns false if the scheduler can't take another
+	// stream of this rate, see StreamScheduler::admit().
+	// If reverse is set it's the size of a frame (1, 2 or 4 bytes) and the
+	// stream goes backwards from the end, frame by frame, looping back to
+	// the end. loopStart and skip don't apply then. The file is still read
+	// in whole sectors, just in descending order, and each read is turned
+	// round in the ring. Give the File a cluster map (File::mapClusters())
+	// or every read seeks along the FAT chain from the start of the file.
+	bool start(File *f, unsigned start, unsigned length, unsigned bytesPerSecond, bool loop = false, unsigned loopStart = 0,
+	           unsigned skip = 0, unsigned reverse = 0);
+	void stop();
+
+	bool isRunning() const { return _ring != 0; }
+
+	// The most the consumer takes out between two polls, a frame's worth.
+	// Reads finish on a sector boundary in the file so the next one starts
+	// on one, and the ring is only topped up past the last boundary if it
+	// would otherwise hold less than this. Until it's set the ring is kept
+	// full. Can be changed from the audio interrupt.
+	void setNeed(unsigned bytes) { _need = bytes; }
+
+	// Put frameBytes sized frames (1, 2 or 4) the other way round.
+	static void reverseFrames(uint8_t *data, unsigned nBytes, unsigned frameBytes);
+
+	// Audio interrupt side.
+	unsigned read(uint8_t *dest, unsigned nBytes, unsigned granule = 1); // Short if the ring ran dry, but whole granules.
+	void     seek(unsigned position);               // Restart from here (a file offset).
+	bool     isEnd() const;                         // True once everything has been read.
+	unsigned getFill() const { return _wr - _rd; }  // Bytes waiting in the ring.
+
+private:
+	friend class StreamScheduler;
+
+	File             *_f;
+	uint8_t          *_ring;
+	unsigned          _rate;       // Bytes per second the consumer takes.
+	unsigned          _start;      // First byte of the stream in the file.
+	unsigned          _end;        // One after the last byte.
+	unsigned          _loopStart;
+	unsigned          _filePos;    // Where the next read from the file goes from (or up to, in reverse).
+	volatile unsigned _wr;         // Bytes ever written into the ring (main loop).
+	volatile unsigned _rd;         // Bytes ever read out of it (audio interrupt).
+	unsigned          _wrIdx;      // Where in the ring the next write goes.
+	volatile unsigned _rdIdx;      // And the next read (audio interrupt, or the main loop during a seek).
+	volatile unsigned _seekPos;
+	volatile unsigned _need;
+	volatile uint8_t  _seekReq;    // Bumped by seek(), the scheduler catches up.
+	volatile uint8_t  _seekAck;
+	volatile bool     _eof;        // Read up to the end, nothing more to come.
+	bool              _loop;
+	uint8_t           _slot;
+	uint8_t           _reverse;    // Frame size going backwards, 0 going forwards.
+};
+
+// Decides which stream to read next. Each stream's deadline is when its
+// ring will run dry at the rate it is being consumed, and the one with the
+// earliest deadline gets the next read (earliest deadline first). Each read
+// fills as much of the ring as it can in one go, which FatFs turns into a
+// single multiple block read from the card.
+//
+// The scheduler keeps a running measurement of how fast the card really
+// delivers data and refuses to start a stream which would push the total
+// demand over STREAM_BANDWIDTH_MARGIN percent of that.
+class StreamScheduler
+{
+public:
+	enum {
+		kMaxStreams = STREAM_COUNT,
+		kRingBytes  = STREAM_RING_SECTORS * SDCard::kBlockSize
+	};
+
+	// Call this all the time from the main loop. Does one read each time.
+	static void poll();
+
+	static bool     admit(unsigned bytesPerSecond); // Would a stream this fast fit?
+	static unsigned getBandwidth() { return s_bandwidth; } // Measured bytes per second from the card.
+	static unsigned getCommitted() { return s_committed; } // Bytes per second promised to streams.
+	static unsigned getMaxStreams(unsigned bytesPerSecond); // How many streams of this rate would fit.
+
+private:
+	friend class Stream;
+
+	static Stream  *s_stream[kMaxStreams];
+	static unsigned s_bandwidth;
+	static unsigned s_committed;
+
+	static void align(Stream *s);
+	static int  read(Stream *s, unsigned idx, unsigned n);
+	static void fill(Stream *s);
+	static void fillReverse(Stream *s);
+	static void restart(Stream *s);
+};
+
+#endif /* FILESYSTEM_STREAMSCHEDULER_H_ */
@@ -0,0 +1,157 @@
+/*
+ * MemoryPool.cpp - Fixed block allocator for new and delete.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "MemoryPool.h"
+#include "board.h"
+#include "Trace.h"
+
+// Defined in the linker script.
+extern "C" uint8_t __ArenaBase;
+extern "C" uint8_t __ArenaLimit;
+
+#define POOL_ALIGN 8
+
+static uint8_t *s_arenaNext = &__ArenaBase;
+
+void *Arena::allocate(unsigned size)
+{
+	size = (size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	void *p = 0;
+	if(size <= (unsigned)(&__ArenaLimit - s_arenaNext)) {
+		p = s_arenaNext;
+		s_arenaNext += size;
+	}
+
+	__set_PRIMASK(primask);
+	return p;
+}
+
+unsigned Arena::getFree()
+{
+	return &__ArenaLimit - s_arenaNext;
+}
+
+// Take the blocks for this pool from the arena. If the arena runs out the
+// pool gets as many blocks as would fit and this returns false.
+bool MemoryPool::init(unsigned blockSize, unsigned count)
+{
+	if(blockSize < sizeof(Block))
+		blockSize = sizeof(Block);
+	blockSize = (blockSize + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+
+	unsigned n = count;
+	if(n * blockSize > Arena::getFree())
+		n = Arena::getFree() / blockSize;
+
+	_base      = (uint8_t *)Arena::allocate(n * blockSize);
+	_blockSize = blockSize;
+	_count     = _base ? n : 0;
+	_end       = _base + _count * blockSize;
+
+	// Chain all the blocks together onto the free list.
+	_freeList = 0;
+	for(uint8_t *p = _end; p > _base; ) {
+		p -= blockSize;
+		Block *b = (Block *)p;
+		b->next = _freeList;
+		_freeList = b;
+	}
+	_nFree = _lowWater = _count;
+
+	return _count == count;
+}
+
+void *MemoryPool::allocate()
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	Block *b = _freeList;
+	if(b) {
+		_freeList = b->next;
+		if(--_nFree < _lowWater)
+			_lowWater = _nFree;
+	}
+
+	__set_PRIMASK(primask);
+	return b;
+}
+
+void MemoryPool::free(void *p)
+{
+	if(!owns(p))
+		return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	Block *b = (Block *)p;
+	b->next = _freeList;
+	_freeList = b;
+	_nFree++;
+
+	__set_PRIMASK(primask);
+}
+
+static MemoryPool s_pools[PoolAllocator::kNumPools];
+static bool       s_poolsReady = false;
+static unsigned   s_failures   = 0;
+
+void PoolAllocator::init()
+{
+	s_pools[kPoolSmall].init(POOL_SMALL_BLOCK, POOL_SMALL_COUNT);
+	s_pools[kPoolMedium].init(POOL_MEDIUM_BLOCK, POOL_MEDIUM_COUNT);
+	s_pools[kPoolLarge].init(POOL_LARGE_BLOCK, POOL_LARGE_COUNT);
+	s_poolsReady = true;
+}
+
+// Give out a block from the smallest pool that fits. If that pool is empty
+// try the next size up rather than fail.
+void *PoolAllocator::allocate(size_t size)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(!s_poolsReady)
+		init();
+	__set_PRIMASK(primask);
+
+	for(unsigned i = 0; i < kNumPools; i++) {
+		if(size <= s_pools[i].getBlockSize()) {
+			void *p = s_pools[i].allocate();
+			if(p)
+				return p;
+		}
+	}
+
+	s_failures++;
+	Trace::event(kTraceAllocFail, size);
+	return 0;
+}
+
+void PoolAllocator::free(void *p)
+{
+	for(unsigned i = 0; i < kNumPools; i++) {
+		if(s_pools[i].owns(p)) {
+			s_pools[i].free(p);
+			return;
+		}
+	}
+}
+
+const MemoryPool &PoolAllocator::getPool(PoolId id)
+{
+	return s_pools[id];
+}
+
+unsigned PoolAllocator::getFailures()
+{
+	return s_failures;
+}
@@ -0,0 +1,122 @@
+/*
+ * MemoryPool.h - Fixed block allocator for new and delete.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef DRIVERS_MEMORYPOOL_H_
+#define DRIVERS_MEMORYPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+
+// There is no malloc heap. Instead the linker script reserves a fixed arena
+// in RAM which is carved up once into pools of equal sized blocks. Allocating
+// and freeing a block is just a push or pop on the pool's free list, so it
+// always takes the same short time, can be done from an interrupt handler and
+// can never fragment memory.
+//
+// operator new (see tinycpp.cpp) uses the pools set up in board.h. If there is
+// no block left it records the failure, sends a kTraceAllocFail trace event
+// and returns 0. We build with -fcheck-new so "new Thing" gives 0 rather than
+// constructing the thing at address 0, so always check the result.
+
+// The arena itself. Memory taken from here is never given back.
+class Arena
+{
+public:
+	static void    *allocate(unsigned size); // 8-byte aligned, 0 if the arena is full.
+	static unsigned getFree();
+};
+
+// A pool of blocks all the same size.
+class MemoryPool
+{
+public:
+	// constexpr so the pools behind new are ready before any constructors run.
+	constexpr MemoryPool()
+		: _base(0), _end(0), _freeList(0), _blockSize(0), _count(0), _nFree(0), _lowWater(0)
+	{ }
+
+	bool  init(unsigned blockSize, unsigned count);
+	void *allocate();
+	void  free(void *p);
+
+	bool owns(const void *p) const { return p >= _base && p < _end; }
+
+	unsigned getBlockSize() const { return _blockSize; }
+	unsigned getCount()     const { return _count; }
+	unsigned getFree()      const { return _nFree; }
+	unsigned getLowWater()  const { return _lowWater; } // Fewest blocks ever free.
+
+private:
+	struct Block
+	{
+		Block *next;
+	};
+
+	uint8_t *_base;
+	uint8_t *_end;
+	Block   *_freeList;
+	unsigned _blockSize;
+	unsigned _count;
+	unsigned _nFree;
+	unsigned _lowWater;
+};
+
+// The pools behind operator new.
+class PoolAllocator
+{
+public:
+	enum PoolId {
+		kPoolSmall,  // DSP state.
+		kPoolMedium, // Voices.
+		kPoolLarge,  // File objects.
+		kNumPools
+	};
+
+	static void *allocate(size_t size);
+	static void  free(void *p);
+
+	static const MemoryPool &getPool(PoolId id);
+	static unsigned          getFailures(); // Number of allocations which could not be met.
+
+private:
+	static void init();
+};
+
+// A pool just for one type of object, for things which must never have to
+// compete with anything else for memory. The blocks come from the arena when
+// the pool is constructed, so make these static or members of something which
+// lives forever.
+template<class T, unsigned N>
+class ObjectPool
+{
+public:
+	ObjectPool() { _pool.init(sizeof(T), N); }
+
+	template<typename... Args>
+	T *create(Args&&... args)
+	{
+		void *p = _pool.allocate();
+		return p ? new(p) T(std::forward<Args>(args)...) : 0;
+	}
+
+	void destroy(T *obj)
+	{
+		if(obj) {
+			obj->~T();
+			_pool.free(obj);
+		}
+	}
+
+	unsigned getFree() const { return _pool.getFree(); }
+
+private:
+	MemoryPool _pool;
+};
+
+#endif /* DRIVERS_MEMORYPOOL_H_ */
@@ -0,0 +1,126 @@
+/*
+ * Profiler.cpp - Statistical PC-sampling profiler.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "Profiler.h"
+#include "SystemIntegration.h"
+#include <string.h>
+
+#ifdef PROFILER_ENABLE
+
+// The histogram. Dump this with J-Link "savebin" while the board is running
+// and feed it to tools/profile_report.py.
+ProfilerData g_profile;
+
+static bool s_running = false;
+
+// Clear the histogram.
+void Profiler::reset()
+{
+	NVIC_DisableIRQ(PROFILER_IRQN);
+
+	memset(&g_profile, 0, sizeof(g_profile));
+	g_profile.magic       = PROFILER_MAGIC;
+	g_profile.codeBase    = PROFILER_CODE_BASE;
+	g_profile.bucketShift = PROFILER_BUCKET_SHIFT;
+	g_profile.bucketCount = PROFILER_BUCKETS;
+
+	if(s_running)
+		NVIC_EnableIRQ(PROFILER_IRQN);
+}
+
+// Start taking samples. The histogram is cleared the first time through.
+void Profiler::start()
+{
+	if(g_profile.magic != PROFILER_MAGIC)
+		reset();
+
+	// Clock the timer from the 48MHz IRC.
+	SystemIntegration::enableClock(PROFILER_TPM_CLOCK);
+	SIM->SOPT2 = (SIM->SOPT2 & ~SIM_SOPT2_TPMSRC_MASK) | SIM_SOPT2_TPMSRC(TPM_CLK_SRC_IRC48M);
+
+	// Free-running up-counter which overflows PROFILER_SAMPLE_HZ times a second.
+	PROFILER_TPM->SC  = 0;
+	PROFILER_TPM->CNT = 0;
+	PROFILER_TPM->MOD = TPM_MOD_MOD(CORE_CLOCK / PROFILER_SAMPLE_HZ - 1);
+	PROFILER_TPM->SC  = TPM_SC_TOF_MASK | TPM_SC_TOIE_MASK | TPM_SC_CMOD(1) | TPM_SC_PS(0);
+
+	// Must be the highest priority interrupt in the system or we can't see inside the others.
+	NVIC_SetPriority(PROFILER_IRQN, PROFILER_IRQ_PRIORITY);
+	NVIC_EnableIRQ(PROFILER_IRQN);
+	s_running = true;
+}
+
+void Profiler::stop()
+{
+	if(!s_running)
+		return;
+
+	NVIC_DisableIRQ(PROFILER_IRQN);
+	PROFILER_TPM->SC = TPM_SC_TOF_MASK;
+	s_running = false;
+}
+
+// Count one sample. Called from the timer interrupt with a pointer to the
+// exception frame which the CPU stacked for the code we interrupted:
+//   r0, r1, r2, r3, r12, lr, pc, xPSR
+extern "C" void profilerSample(const uint32_t *frame)
+{
+	// Clear the overflow flag.
+	PROFILER_TPM->SC |= TPM_SC_TOF_MASK;
+
+	uint32_t pc  = frame[6];
+	uint32_t psr = frame[7];
+
+	g_profile.samples++;
+	if(0 != (psr & IPSR_ISR_Msk))
+		g_profile.isrSamples++;
+
+	uint32_t offset = pc - PROFILER_CODE_BASE;
+	if(offset >= PROFILER_CODE_SIZE) {
+		g_profile.outOfRange++;
+		return;
+	}
+
+	uint16_t *bucket = &g_profile.bucket[offset >> PROFILER_BUCKET_SHIFT];
+	if(*bucket == 0xFFFF) {
+		// Counter is about to wrap. Halve everything so the ratios stay valid.
+		for(unsigned i = 0; i < PROFILER_BUCKETS; i++)
+			g_profile.bucket[i] >>= 1;
+		g_profile.samples    >>= 1;
+		g_profile.isrSamples >>= 1;
+		g_profile.outOfRange >>= 1;
+	}
+	(*bucket)++;
+}
+
+// Sample timer interrupt. This has to be naked because we need the stack
+// pointer exactly as the CPU left it. Bit 2 of the EXC_RETURN value in LR
+// tells us whether the interrupted code was using MSP or PSP.
+extern "C" __attribute__((naked)) void TPM2_IRQHandler()
+{
+	__asm volatile(
+		"movs r0, #4               \n"
+		"mov  r1, lr               \n"
+		"tst  r0, r1               \n"
+		"bne  1f                   \n"
+		"mrs  r0, msp              \n"
+		"ldr  r1, =profilerSample  \n"
+		"bx   r1                   \n"
+		"1:                        \n"
+		"mrs  r0, psp              \n"
+		"ldr  r1, =profilerSample  \n"
+		"bx   r1                   \n"
+	);
+}
+
+#else // PROFILER_ENABLE
+
+void Profiler::start() { }
+void Profiler::stop()  { }
+void Profiler::reset() { }
+
+#endif // PROFILER_ENABLE
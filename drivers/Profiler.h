@@ -0,0 +1,49 @@
+/*
+ * Profiler.h - Statistical PC-sampling profiler.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef DRIVERS_PROFILER_H_
+#define DRIVERS_PROFILER_H_
+
+#include "board.h"
+#include <stdint.h>
+
+// A timer interrupt samples the program counter of whatever it interrupted
+// and counts it into a histogram of flash address buckets. The histogram sits
+// in RAM (g_profile) where it can be dumped over J-Link while the board runs
+// and turned into a per-function report by tools/profile_report.py.
+//
+// Only built in when PROFILER_ENABLE is defined in board.h, otherwise all
+// of these calls do nothing.
+
+#define PROFILER_MAGIC       0x464F5250 // "PROF"
+#define PROFILER_CODE_BASE   0x00000000 // Start of flash.
+#define PROFILER_CODE_SIZE   0x00008000 // 32k of flash on the KL17Z32.
+#define PROFILER_BUCKETS     (PROFILER_CODE_SIZE >> PROFILER_BUCKET_SHIFT)
+
+// Layout of the histogram in RAM. The host script relies on this so only
+// ever append to it.
+struct ProfilerData
+{
+	uint32_t magic;       // Always PROFILER_MAGIC.
+	uint32_t codeBase;    // Address covered by bucket 0.
+	uint32_t bucketShift; // log2 of the number of bytes per bucket.
+	uint32_t bucketCount; // Number of entries in bucket[].
+	uint32_t samples;     // Total number of samples counted.
+	uint32_t isrSamples;  // Samples which landed in an interrupt handler.
+	uint32_t outOfRange;  // Samples with a PC outside of flash.
+	uint16_t bucket[PROFILER_BUCKETS];
+};
+
+class Profiler
+{
+public:
+	static void start();
+	static void stop();
+	static void reset();
+};
+
+#endif /* DRIVERS_PROFILER_H_ */
@@ -0,0 +1,34 @@
+/*
+ * StackMonitor.cpp - Find out how much stack we are really using.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "StackMonitor.h"
+#include <stdint.h>
+
+// Defined in the linker script.
+extern "C" uint32_t __StackBottom;
+extern "C" uint32_t __StackTop;
+
+unsigned StackMonitor::getSize()
+{
+	return (uint8_t *)&__StackTop - (uint8_t *)&__StackBottom;
+}
+
+unsigned StackMonitor::getHeadroom()
+{
+	const uint32_t *p   = &__StackBottom;
+	const uint32_t *top = &__StackTop;
+
+	while(p < top && *p == STACK_PAINT_PATTERN)
+		p++;
+
+	return (uint8_t *)p - (uint8_t *)&__StackBottom;
+}
+
+unsigned StackMonitor::getHighWater()
+{
+	return getSize() - getHeadroom();
+}
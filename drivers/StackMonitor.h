@@ -0,0 +1,29 @@
+/*
+ * StackMonitor.h - Find out how much stack we are really using.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef DRIVERS_STACKMONITOR_H_
+#define DRIVERS_STACKMONITOR_H_
+
+// The startup code fills all the RAM between the end of the arena and the
+// top of the stack with STACK_PAINT_PATTERN. Anything that has been used
+// since no longer holds the pattern, so scanning up from the bottom finds
+// the deepest the stack (including all the interrupt handlers, which share
+// it) has ever been.
+//
+// A local variable which happens to hold the pattern value will make the
+// stack look a few bytes shallower than it was, so keep some margin.
+#define STACK_PAINT_PATTERN 0xC5C5C5C5 // Must match startup_MKL17Z644.S
+
+class StackMonitor
+{
+public:
+	static unsigned getSize();      // Bytes of RAM available to the stack.
+	static unsigned getHighWater(); // Most bytes of stack ever used.
+	static unsigned getHeadroom();  // Bytes of stack which have never been touched.
+};
+
+#endif /* DRIVERS_STACKMONITOR_H_ */
@@ -8,30 +8,87 @@
 #include "SystemTick.h"
 #include "board.h"
 
-volatile unsigned g_systickCount = 0;
+volatile unsigned g_systickCount = 0; // Number of SysTick interrupts since init().
 
-#define SYSTICK_MS_PER_INTERRUPT (1000/SYSTICK_FREQ)
+#define SYSTICK_MS_PER_INTERRUPT     (1000/SYSTICK_FREQ)
+#define SYSTICK_US_PER_INTERRUPT     (1000000/SYSTICK_FREQ)
+#define SYSTICK_CYCLES_PER_INTERRUPT (CORE_CLOCK/SYSTICK_FREQ)
+#define SYSTICK_CYCLES_PER_US        (CORE_CLOCK/1000000)
+#define SYSTICK_CYCLES_PER_MS        (CORE_CLOCK/1000)
 
 // Configure the SysTick timer.
 void SystemTick::init()
 {
-	SysTick_Config(CORE_CLOCK / SYSTICK_FREQ);
+	SysTick_Config(SYSTICK_CYCLES_PER_INTERRUPT);
 	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
 }
 
 extern "C" void SysTick_Handler()
 {
-	g_systickCount += SYSTICK_MS_PER_INTERRUPT;
+	g_systickCount++;
+}
+
+// Get a consistent reading of the interrupt count and the number of cycles
+// since the last interrupt. If the counter has wrapped but the interrupt
+// hasn't been serviced yet (because we are in a higher priority handler or
+// interrupts are masked) the missing tick is counted here.
+void SystemTick::snapshot(unsigned &ticks, unsigned &cycles)
+{
+	unsigned t, val, val2, pending;
+
+	do {
+		t       = g_systickCount;
+		val     = SysTick->VAL;
+		pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+		val2    = SysTick->VAL;
+	} while(t != g_systickCount || val2 > val); // Interrupt ran or counter reloaded while reading, try again.
+
+	// VAL of zero means the counter is just about to reload so the pending tick hasn't happened yet.
+	if(pending && val != 0)
+		t++;
+
+	ticks  = t;
+	cycles = SysTick->LOAD - val;
 }
 
 unsigned SystemTick::getMilliseconds()
 {
-	return g_systickCount;
+	unsigned ticks, cycles;
+	snapshot(ticks, cycles);
+	return ticks * SYSTICK_MS_PER_INTERRUPT + cycles / SYSTICK_CYCLES_PER_MS;
+}
+
+uint32_t SystemTick::getMicroseconds()
+{
+	unsigned ticks, cycles;
+	snapshot(ticks, cycles);
+	return ticks * SYSTICK_US_PER_INTERRUPT + cycles / SYSTICK_CYCLES_PER_US;
+}
+
+uint64_t SystemTick::getMicroseconds64()
+{
+	unsigned ticks, cycles;
+	snapshot(ticks, cycles);
+	return (uint64_t)ticks * SYSTICK_US_PER_INTERRUPT + cycles / SYSTICK_CYCLES_PER_US;
+}
+
+uint32_t SystemTick::getCycles()
+{
+	unsigned ticks, cycles;
+	snapshot(ticks, cycles);
+	return ticks * SYSTICK_CYCLES_PER_INTERRUPT + cycles;
 }
 
 void SystemTick::delay(unsigned ms)
 {
-	unsigned tStart = g_systickCount;
-	while(g_systickCount - tStart < ms)
+	Timeout t(ms);
+	while(!t.isExpired())
+		;
+}
+
+void SystemTick::delayMicroseconds(unsigned us)
+{
+	Timeout t(us, Timeout::kMicroseconds);
+	while(!t.isExpired())
 		;
 }
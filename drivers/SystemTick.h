@@ -8,29 +8,45 @@
 #ifndef DRIVERS_SYSTEMTICK_H_
 #define DRIVERS_SYSTEMTICK_H_
 
+#include <stdint.h>
+
+// The SysTick interrupt only fires every 10ms but the counter itself runs at
+// the core clock, so combining the two gives a timebase with single-cycle
+// resolution. All of the get functions are safe to call from any interrupt
+// handler, even one which has blocked the SysTick interrupt itself.
 class SystemTick
 {
 public:
 	static void     init();
 	static unsigned getMilliseconds();
+	static uint32_t getMicroseconds();   // Wraps after 71 minutes.
+	static uint64_t getMicroseconds64(); // Doesn't wrap.
+	static uint32_t getCycles();         // Core clock cycles, wraps after 89 seconds.
 	static void     delay(unsigned ms);
+	static void     delayMicroseconds(unsigned us);
+
+private:
+	static void snapshot(unsigned &ticks, unsigned &cycles);
 };
 
+// Timeout measured on the microsecond clock. Timeouts can be up to 35 minutes long.
 class Timeout
 {
 public:
-	Timeout(unsigned ms)
-		: _tFinish(SystemTick::getMilliseconds() + ms)
+	enum Unit { kMilliseconds, kMicroseconds };
+
+	Timeout(unsigned t, Unit unit = kMilliseconds)
+		: _tFinish(SystemTick::getMicroseconds() + (unit == kMilliseconds ? t * 1000 : t))
 	{ }
 
 	bool isExpired() const
 	{
-		unsigned dt = _tFinish - SystemTick::getMilliseconds();
+		uint32_t dt = _tFinish - SystemTick::getMicroseconds();
 		return 0 != (0x80000000 & dt);
 	}
 
 private:
-	unsigned _tFinish;
+	uint32_t _tFinish;
 };
 
 #endif /* DRIVERS_SYSTEMTICK_H_ */
@@ -0,0 +1,129 @@
+/*
+ * Trace.cpp - Binary event trace readable over J-Link RTT.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#include "Trace.h"
+#include "SystemTick.h"
+#include <string.h>
+
+#ifdef TRACE_ENABLE
+
+#define TRACE_RECORD_SIZE 8
+
+#if (TRACE_BUFFER_SIZE % TRACE_RECORD_SIZE) != 0
+#error TRACE_BUFFER_SIZE must be a multiple of 8 so records never wrap.
+#endif
+
+// These structures must match SEGGER's RTT control block layout exactly.
+struct RttBuffer
+{
+	const char        *name;
+	uint8_t           *buffer;
+	unsigned           size;
+	volatile unsigned  wrOff; // Written by the target.
+	volatile unsigned  rdOff; // Written by the J-Link.
+	unsigned           flags;
+};
+
+struct RttControlBlock
+{
+	char      id[16];   // "SEGGER RTT", J-Link searches RAM for this.
+	int       maxUp;
+	int       maxDown;
+	RttBuffer up[1];
+	RttBuffer down[1];
+};
+
+#define RTT_MODE_NO_BLOCK_SKIP 0 // Drop events rather than wait for the host.
+
+static RttControlBlock s_rtt;
+static uint32_t        s_traceBuf[TRACE_BUFFER_SIZE / sizeof(uint32_t)];
+static uint8_t         s_downBuf[16];
+static unsigned        s_dropped = 0;
+
+void Trace::init()
+{
+	s_rtt.maxUp   = 1;
+	s_rtt.maxDown = 1;
+
+	s_rtt.up[0].name   = "Trace";
+	s_rtt.up[0].buffer = (uint8_t *)s_traceBuf;
+	s_rtt.up[0].size   = TRACE_BUFFER_SIZE;
+	s_rtt.up[0].wrOff  = 0;
+	s_rtt.up[0].rdOff  = 0;
+	s_rtt.up[0].flags  = RTT_MODE_NO_BLOCK_SKIP;
+
+	s_rtt.down[0].name   = "Unused";
+	s_rtt.down[0].buffer = s_downBuf;
+	s_rtt.down[0].size   = sizeof(s_downBuf);
+	s_rtt.down[0].wrOff  = 0;
+	s_rtt.down[0].rdOff  = 0;
+	s_rtt.down[0].flags  = RTT_MODE_NO_BLOCK_SKIP;
+
+	// Write the ID last, and back to front, so the J-Link never finds a
+	// half-initialised control block. This is how SEGGER do it too.
+	strcpy(&s_rtt.id[7], "RTT");
+	__DMB();
+	memcpy(s_rtt.id, "SEGGER ", 7);
+	__DMB();
+}
+
+// Add an event to the ring buffer. Interrupts are masked for the few
+// instructions it takes, so this can be called from any context.
+void Trace::event(TraceEvent id, uint32_t arg)
+{
+	RttBuffer &up = s_rtt.up[0];
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t time = SystemTick::getCycles();
+	unsigned rd   = up.rdOff;
+	unsigned wr   = up.wrOff;
+
+	// Report lost events first, if there is room for both records.
+	if(s_dropped != 0) {
+		unsigned next = wr + TRACE_RECORD_SIZE;
+		if(next >= TRACE_BUFFER_SIZE)
+			next = 0;
+		unsigned after = next + TRACE_RECORD_SIZE;
+		if(after >= TRACE_BUFFER_SIZE)
+			after = 0;
+
+		if(next != rd && after != rd) {
+			uint32_t *rec = &s_traceBuf[wr / sizeof(uint32_t)];
+			rec[0] = time;
+			rec[1] = kTraceOverflow | (s_dropped << 8);
+			wr = next;
+			s_dropped = 0;
+		}
+	}
+
+	unsigned next = wr + TRACE_RECORD_SIZE;
+	if(next >= TRACE_BUFFER_SIZE)
+		next = 0;
+
+	if(next == rd || s_dropped != 0) {
+		s_dropped++; // Host isn't keeping up.
+	} else {
+		uint32_t *rec = &s_traceBuf[wr / sizeof(uint32_t)];
+		rec[0] = time;
+		rec[1] = id | (arg << 8);
+		wr = next;
+	}
+
+	up.wrOff = wr;
+
+	__set_PRIMASK(primask);
+}
+
+#else // TRACE_ENABLE
+
+void Trace::init()
+{
+}
+
+#endif // TRACE_ENABLE
@@ -0,0 +1,65 @@
+/*
+ * Trace.h - Binary event trace readable over J-Link RTT.
+ *
+ *  Created on: 18 Oct 2026
+ *      Author: adam
+ */
+
+#ifndef DRIVERS_TRACE_H_
+#define DRIVERS_TRACE_H_
+
+#include "board.h"
+#include <stdint.h>
+
+// Events are written into a ring buffer in RAM which is laid out as a SEGGER
+// RTT control block, so J-Link can pull them out while the board runs without
+// halting it (e.g. with JLinkRTTLogger, see jlink.sh). Each event is 8 bytes:
+//
+//   uint32_t time;  // Core clock cycles from SystemTick::getCycles().
+//   uint32_t info;  // Event ID in bits 0-7, argument in bits 8-31.
+//
+// tools/trace_decode.py turns a capture into a timeline. It reads the event
+// names from this enum so keep one event per line.
+//
+// Only built in when TRACE_ENABLE is defined in board.h, otherwise all
+// of these calls do nothing.
+enum TraceEvent
+{
+	kTraceNone = 0,
+	kTraceOverflow = 1,         // Buffer was full, arg = number of events lost.
+	kTraceBoot = 2,             // Firmware started.
+	kTraceIdle = 3,             // Main loop heartbeat, arg = iteration count / 2^20.
+	kTraceMark = 4,             // General purpose marker, arg = whatever you like.
+	kTraceAudioIrqStart = 5,    // Audio DMA complete interrupt entered.
+	kTraceAudioIrqEnd = 6,      // Next audio frame has been generated.
+	kTraceSdReadStart = 7,      // SD card read, arg = first sector.
+	kTraceSdReadEnd = 8,        // SD card read finished, arg = number of sectors.
+	kTraceSdError = 9,          // SD card read failed, arg = sector.
+	kTraceWavShortRead = 10,    // WAV data ran out, arg = frames read.
+	kTraceWavLoop = 11,         // WAV playback looped back to the start.
+	kTraceStackHeadroom = 12,   // Bytes of stack never used so far.
+	kTraceAllocFail = 13,       // operator new found no free block, arg = bytes wanted.
+	kTraceBenchmark = 14,       // Benchmark result follows, arg = BenchmarkId.
+	kTraceBenchCycles = 15,     // Cycles the last benchmark took per frame.
+	kTraceStreamRefused = 16,   // Card too slow for another stream, arg = bytes per second wanted.
+	kTraceStreamUnderrun = 17,  // Stream ran dry mid frame, arg = frames there were.
+	kTraceStreamBandwidth = 18, // Measured card read rate, arg = bytes per second.
+	kTraceVoiceTrigger = 19,    // VoiceManager::trigger(), arg = voice.
+	kTraceVoiceSound = 20,      // First frame of the triggered sample mixed, arg = voice.
+	kTraceSampleRate = 21,      // I2S output rate changed at a frame boundary, arg = Hz.
+	kTraceWavNext = 22,         // WAV playback went on into the queued file, arg = frame it started at.
+};
+
+class Trace
+{
+public:
+	static void init();
+
+#ifdef TRACE_ENABLE
+	static void event(TraceEvent id, uint32_t arg = 0);
+#else
+	static void event(TraceEvent id, uint32_t arg = 0) { }
+#endif
+};
+
+#endif /* DRIVERS_TRACE_H_ */
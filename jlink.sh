@@ -5,6 +5,12 @@
 #
 #   connect
 #   loadfile <hex_file>
+#
+# To capture the event trace (TRACE_ENABLE in board.h) while the board runs use
+#
+#   JLinkRTTLogger -Device MKL17Z32xxx4 -If SWD -Speed 4000 -RTTChannel 0 trace.bin
+#
+# and decode it with tools/trace_decode.py trace.bin
 
 JLinkExe -device MKL17Z32xxx4 -if SWD
 
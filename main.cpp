@@ -5,7 +5,6 @@
 
 // TODO:
 // * DMA SPI not working
-// * Granulation or some kind of filter thing
 // * Inputs - GPIO and ADC
 // * Use inputs to modulate playback and filters.
 // * Looper
@@ -13,11 +12,19 @@
 #include "board.h"
 #include "SystemIntegration.h"
 #include "AudioKinetisI2S.h"
+#include "AttackCache.h"
 #include "AudioSource.h"
+#include "Benchmark.h"
 #include "Filesystem.h"
+#include "FlashSampleSource.h"
+#include "Profiler.h"
 #include "SystemTick.h"
-#include "SineSource.h"
-#include "WavSource.h"
+#include "Trace.h"
+#include "Mixer.h"
+#include "OscillatorBank.h"
+#include "StackMonitor.h"
+#include "StreamScheduler.h"
+#include "VoiceManager.h"
 #include <stdint.h>
 
 void delay(void)
@@ -44,26 +51,65 @@ int main(void)
 	// System tick is a useful timer.
 	SystemTick::init();
 
+	// Event trace for J-Link RTT (does nothing unless TRACE_ENABLE is set in board.h).
+	Trace::init();
+	Trace::event(kTraceBoot);
+
+	// Time the audio code while there is nothing else running (only if
+	// BENCHMARK_ENABLE is set, which stops here).
+	Benchmark::run();
+
+	// Start sampling the PC (does nothing unless PROFILER_ENABLE is set in board.h).
+	Profiler::start();
+
 	// Init the SD card and mount the filesystem.
 	Filesystem fs;
 
 	// Set up I2S DAC to produce audio.
 	AudioKinetisI2S audio;
 
-	// Create audio source object and link it to the audio output.
-	SineSource sine;
-	WavSource wav;
-	if(wav.open("/LOOP001.WAV"))
-		audio.setDataSource(&wav);
-	else
-		audio.setDataSource(&sine);
+	// Sample player voices, all mixed together.
+	Mixer        mixer;
+	VoiceManager voices(mixer);
 
-	wav.play(true);
+	// Create audio source object and link it to the audio output.
+	OscillatorBank    tone;
+	FlashSampleSource flash;
+	if(fs.exists("/LOOP001.WAV")) {
+		AttackCache::load("/LOOP001.WAV"); // Start without waiting for the card (if ATTACK_CACHE_ENABLE is set).
+		voices.trigger("/LOOP001.WAV", GainStage::kUnity / 4, Mixer::kPanCentre, 0, true);
+		audio.setDataSource(&mixer);
+	} else if(FlashSampleSource::getBankSize() > 0) {
+		// No card, play what is built in instead. Nothing else is playing so
+		// the output can run at the sample's own rate, if it can be had in
+		// tune. Others play at the default rate (see wav2flash.py).
+		const FlashSample *sample = FlashSampleSource::getSample(0);
+		if(AudioKinetisI2S::isInTune(sample->sampleRate))
+			audio.setSampleRate(sample->sampleRate);
+		flash.play(sample, true);
+		audio.setDataSource(&flash);
+	} else {
+		// Nothing to play, so a quiet A440 to show it's alive.
+		tone.start(0, 440 << 16);
+		tone.setGain(GainStage::kUnity / 8);
+		audio.setDataSource(&tone);
+	}
 
 	unsigned counter = 0;
 
 	while(1)
     {
 		counter++;
+
+		// Open files for newly triggered voices and keep the streams fed.
+		voices.poll();
+		StreamScheduler::poll();
+
+		// Heartbeat so the trace shows how much idle time and stack we have.
+		if(0 == (counter & 0xFFFFF)) {
+			Trace::event(kTraceIdle, counter >> 20);
+			Trace::event(kTraceStackHeadroom, StackMonitor::getHeadroom());
+			Trace::event(kTraceStreamBandwidth, StreamScheduler::getBandwidth());
+		}
     }
 }
@@ -34,6 +34,11 @@
 #define FLEXIO_DMA_CHANNEL 0
 #define FLEXIO_DMA_IRQN    DMA0_IRQn
 
+// Interrupt priorities (0 is highest, 3 is lowest). The audio DMA interrupt
+// sits below the profiler so the profiler can see what the audio ISR is doing.
+#define PROFILER_IRQ_PRIORITY 0
+#define AUDIO_IRQ_PRIORITY    1
+
 // Definitions for the SPI interface.
 #define SPI_PERIPH_CLOCK   SystemIntegration::kCLOCK_Spi0  // Peripheral clock to activate.
 #define SPI_PORT_CLOCK     SystemIntegration::kCLOCK_PortE // Port clock to activate.
@@ -53,4 +58,105 @@
 #define SDCARD_CS_PIN  16
 #define SDCARD_READONLY
 
+// Statistical profiler. Uncomment PROFILER_ENABLE to build it in.
+//#define PROFILER_ENABLE
+#define PROFILER_TPM          TPM2                            // Timer used to take the samples.
+#define PROFILER_TPM_CLOCK    SystemIntegration::kCLOCK_Tpm2  // Clock gate for that timer.
+#define PROFILER_IRQN         TPM2_IRQn                       // Handler is TPM2_IRQHandler() in Profiler.cpp
+#define PROFILER_SAMPLE_HZ    3989                            // Prime, so it won't lock to the audio frame rate.
+#define PROFILER_BUCKET_SHIFT 6                               // 64 bytes of code per bucket (1k of RAM, 7 halves that).
+
+// Event trace over J-Link RTT (see Trace.h). Uncomment TRACE_ENABLE to build it in.
+//#define TRACE_ENABLE
+#define TRACE_BUFFER_SIZE 512 // Bytes of RAM for the ring buffer, 8 bytes per event.
+
+// Time the audio code at startup and report it on the trace (see Benchmark.h).
+// Needs TRACE_ENABLE too. Takes about 2.5k of static RAM for the synth voices.
+// It stops there, the player isn't built in, or it wouldn't fit in flash.
+//#define BENCHMARK_ENABLE
+
+// Maximum number of sources the Mixer can mix together.
+#define MIXER_MAX_VOICES 8
+
+// Number of sample player voices in the VoiceManager. Each one is a
+// WavSource taken from the large memory pool below.
+#define VOICE_COUNT 2
+
+// SD card streaming (see StreamScheduler.h). One stream per voice, each with
+// a ring buffer of STREAM_RING_SECTORS sectors in static RAM. The audio
+// interrupt takes a whole frame of the file's data out at once, so a ring
+// has to hold a frame and then some, or the card has to be read between
+// every frame with nothing in hand. Two sectors is a 16-bit stereo frame
+// (512 bytes) and a sector to spare. 16-bit stereo at 48kHz (558 bytes a
+// frame, resampled down), playing up to 1.5x faster (WavSource::setSpeed())
+// and 24-bit stereo files (768 bytes a frame) fit too with less spare.
+// A voice with the next file queued (WavSource::queueNext()) has two
+// streams going till the splice, so add one if a set list has to play
+// while the other voices are busy. Only one voice can have a file queued,
+// there's one WavFile for it, static RAM.
+// Streams are only started while the total data rate stays under
+// STREAM_BANDWIDTH_MARGIN percent of what the card has been measured to
+// deliver. STREAM_DEFAULT_BANDWIDTH (bytes per second) is the guess used
+// until the first reads have been timed.
+#define STREAM_COUNT             VOICE_COUNT
+#define STREAM_RING_SECTORS      2
+#define STREAM_BANDWIDTH_MARGIN  75
+#define STREAM_DEFAULT_BANDWIDTH 500000
+
+// Keep the start of chosen samples in RAM so they sound the moment they are
+// triggered (see AttackCache.h). Uncomment ATTACK_CACHE_ENABLE to build it
+// in. ATTACK_CACHE_SAMPLE_BYTES is how much of each sample to keep unless
+// load() is told otherwise. 1k is two frames, 5.8ms of 16-bit stereo at
+// 44.1kHz, which covers opening the file and the first stream read. 48kHz
+// stereo gets through 1116 bytes of the file in that time, so give those
+// more.
+//#define ATTACK_CACHE_ENABLE
+#define ATTACK_CACHE_BYTES        2048 // Total, static RAM. Multiple of 4.
+#define ATTACK_CACHE_ENTRIES      4
+#define ATTACK_CACHE_SAMPLE_BYTES 1024
+
+// Keep the start of a sample's loop, and the frames before it for a
+// crossfade (see WavSource::setLoopFade()), in RAM while it loops, so the
+// wrap doesn't wait for the card. Uncomment LOOP_CACHE_ENABLE to build it in.
+// Without one a loop still wraps at the right frame, but there's no
+// crossfade (setLoopFade() returns false) and a loop that isn't streamed
+// seeks the card in the audio interrupt. Off to keep static RAM in budget.
+// 512 bytes is 128 frames of 16-bit stereo.
+//#define LOOP_CACHE_ENABLE
+#define LOOP_CACHE_BYTES 512 // Each, static RAM. Multiple of 4.
+#define LOOP_CACHE_COUNT VOICE_COUNT
+
+// Granular synthesis (see GranularSource.h). Grains come out of a window of
+// GRANULAR_WINDOW_FRAMES frames (a power of two) of the sample, kept as
+// mono 16-bit in the GranularSource. 1024 is 23ms and takes 2k of RAM, so
+// make the GranularSource a global rather than putting it on the stack.
+// At most GRANULAR_MAX_GRAINS play at once, which bounds the CPU it takes.
+#define GRANULAR_WINDOW_FRAMES 1024
+#define GRANULAR_MAX_GRAINS    8
+
+// Oscillators in an OscillatorBank (see OscillatorBank.h), 16 bytes of RAM
+// each.
+#define OSCILLATOR_COUNT 8
+
+// Samples of delay line in each PluckSource (see PluckSource.h), which sets
+// the lowest note, 86Hz at 44.1kHz. It's 16-bit so this is 1k of RAM per
+// string, make them globals.
+#define PLUCK_DELAY_FRAMES 512
+
+// Pools which operator new hands out blocks from (see MemoryPool.h). new picks
+// the smallest block which fits. They are carved out of the arena defined in
+// the linker script, which must be big enough for all of them.
+#define POOL_SMALL_BLOCK  32  // DSP state: filters, oscillators, envelopes.
+#define POOL_SMALL_COUNT  4
+#define POOL_MEDIUM_BLOCK 96  // Other audio sources, File objects.
+#define POOL_MEDIUM_COUNT 1
+#define POOL_LARGE_BLOCK  432 // Sample player voices (a WavFile with its FIL, Stream and cluster map, a decoder, a Resampler and loop points).
+#define POOL_LARGE_COUNT  VOICE_COUNT
+
+// Options for clock source selection on the TPM timers.
+#define TPM_CLK_SRC_DISABLE  0
+#define TPM_CLK_SRC_IRC48M   1
+#define TPM_CLK_SRC_OSCERCLK 2
+#define TPM_CLK_SRC_MCGIRCLK 3
+
 #endif
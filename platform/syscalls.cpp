@@ -26,27 +26,12 @@ extern "C" {
 		return -1;
 	}
 #endif
+	// There is no malloc heap. Memory comes from the fixed pools in
+	// MemoryPool.cpp instead so anything which calls malloc gets NULL.
 	extern caddr_t _sbrk(int incr)
-	{/*
-		static unsigned char *heap = NULL ;
-		unsigned char *prev_heap ;
-
-		if(heap == NULL)
-			heap = (unsigned char *)&__HeapStart;
-
-		prev_heap = heap;
-
-		if((int)heap + incr > (int)&__HeapLimit)
-		{
-			_write(0, (char *)"OUT OF MEMORY!!\r\n", 17);
-			errno = ENOMEM;
-			return (caddr_t)(-1);
-		}
-
-		heap += incr;
-
-		return (caddr_t) prev_heap;*/
-		return 0;
+	{
+		errno = ENOMEM;
+		return (caddr_t)(-1);
 	}
 #if 0
 	// Returns number of bytes free on the heap.
@@ -4,28 +4,30 @@
 //    -fno-exceptions -fno-rtti
 
 #include <new>
-#include <malloc.h>
+#include "MemoryPool.h"
 
 // This is to prevent an exception being thrown for a pure virtual function.
 extern "C" void __cxa_pure_virtual() { while(1); }
 
 
 // New and delete overrides public domain code by Eric Agan.
+// There is no malloc heap on this board, everything comes out of the fixed
+// block pools in MemoryPool.cpp. new returns 0 when the pools run dry.
 
 void* operator new(std::size_t size) {
-    return malloc(size);
+    return PoolAllocator::allocate(size);
 }
 
 void* operator new[](std::size_t size) {
-    return malloc(size);
+    return PoolAllocator::allocate(size);
 }
 
 void operator delete(void* ptr) {
-    free(ptr);
+    PoolAllocator::free(ptr);
 }
 
 void operator delete[](void* ptr) {
-    free(ptr);
+    PoolAllocator::free(ptr);
 }
 
 // Optionally you can override the 'nothrow' versions as well.
@@ -34,18 +36,27 @@ void operator delete[](void* ptr) {
 // rather than just eliminate exceptions.
 
 void* operator new(std::size_t size, const std::nothrow_t&) {
-    return malloc(size);
+    return PoolAllocator::allocate(size);
 }
 
 void* operator new[](std::size_t size, const std::nothrow_t&) {
-    return malloc(size);
+    return PoolAllocator::allocate(size);
 }
 
 void operator delete(void* ptr, const std::nothrow_t&) {
-    free(ptr);
+    PoolAllocator::free(ptr);
 }
 
 void operator delete[](void* ptr, const std::nothrow_t&) {
-    free(ptr);
+    PoolAllocator::free(ptr);
 }
 
+// Sized versions used by C++14.
+
+void operator delete(void* ptr, std::size_t) {
+    PoolAllocator::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) {
+    PoolAllocator::free(ptr);
+}
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+#
+# Builds bits of the firmware for the PC so the tools/test_*.py scripts can
+# check them against a reference written in Python. Nothing here runs on its
+# own, the tests import it.
+#
+# The sources are compiled with the host C++ compiler (--cxx, "c++" by
+# default) and the firmware's include paths. platform/board.h is copied in
+# without the MCU header, and with the few CMSIS intrinsics the audio code
+# uses (interrupt masking) turned into nothing, so the board.h settings are
+# the same ones the firmware is built with.
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+BOARD_STUBS = '''\
+// Made by tools/host_harness.py for host builds, don't edit.
+#include <stdint.h>
+static inline uint32_t __get_PRIMASK() { return 0; }
+static inline void __set_PRIMASK(uint32_t) { }
+static inline void __disable_irq() { }
+static inline void __enable_irq() { }
+'''
+
+
+def add_arguments(ap):
+    ap.add_argument('--cxx', default=os.environ.get('CXX', 'c++'), help='host C++ compiler (default c++)')
+    ap.add_argument('--keep', action='store_true', help='keep the build directory and print where it is')
+
+
+class Harness:
+    """Compiles main_source with the firmware's sources (relative to the
+    repository) into a program in a temporary directory."""
+
+    def __init__(self, args, main_source, sources, defines=()):
+        self.dir = tempfile.mkdtemp(prefix='wavboard-')
+        self.keep = args.keep
+
+        with open(os.path.join(ROOT, 'platform', 'board.h')) as f:
+            board = f.read()
+        board = re.sub(r'#include "MKL17Z644.h"\n', BOARD_STUBS, board)
+        with open(os.path.join(self.dir, 'board.h'), 'w') as f:
+            f.write(board)
+        main = os.path.join(self.dir, 'main.cpp')
+        with open(main, 'w') as f:
+            f.write(main_source)
+
+        self.exe = os.path.join(self.dir, 'harness')
+        cmd = [args.cxx, '-std=gnu++14', '-O2', '-fno-exceptions', '-fno-rtti', '-I' + self.dir,
+               '-I' + os.path.join(ROOT, 'Audio'), '-o', self.exe, main]
+        cmd += ['-D' + d for d in defines]
+        cmd += [os.path.join(ROOT, s) for s in sources]
+        r = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        if r.returncode:
+            sys.stderr.write(r.stdout)
+            raise SystemExit('host build failed: %s' % ' '.join(cmd))
+
+    def run(self, args, data=b''):
+        """Runs the program with data on stdin, returns what it wrote."""
+        r = subprocess.run([self.exe] + [str(a) for a in args], input=data, stdout=subprocess.PIPE)
+        if r.returncode:
+            raise SystemExit('%s exited with %d' % (self.exe, r.returncode))
+        return r.stdout
+
+    def close(self):
+        if self.keep:
+            print('build directory %s' % self.dir)
+            return
+        for name in os.listdir(self.dir):
+            os.remove(os.path.join(self.dir, name))
+        os.rmdir(self.dir)
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#
+# Per-module flash and RAM report from the GNU ld map file, run by the
+# Makefile after every link. Exits with an error if the image is over budget
+# so the build fails.
+#
+#   tools/memory_budget.py Release/WAVBoard.map --flash 30720 --ram 3072
+#
+# "RAM" here is static RAM: .data, .bss and anything else the linker places
+# in SRAM (the MemoryPool arena, stack reservation etc). main() keeps the big audio and
+# filesystem objects on the stack, so whatever is left over after static RAM
+# is what the stack has to live in. Use StackMonitor at run time to see how
+# much of that it really needs.
+
+import argparse
+import re
+import sys
+
+RAM_START = 0x1FFF0000
+RAM_END = 0x20010000
+
+OUT_SECTION = re.compile(r'^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(.*)$')
+OUT_SECTION_NAME = re.compile(r'^(\.\S+)\s*$')
+IN_SECTION = re.compile(r'^ (\.\S+|COMMON)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+IN_SECTION_NAME = re.compile(r'^ (\.\S+|COMMON)\s*$')
+ADDR_SIZE = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(.*)$')
+LOAD_ADDR = re.compile(r'load address 0x([0-9a-f]+)')
+
+
+def module_name(path):
+    """Release/main.o -> main.o, .../libc_nano.a(lib_a-memcpy.o) -> libc_nano.a"""
+    path = path.strip()
+    m = re.match(r'(.*\.a)\(.*\)$', path)
+    if m:
+        path = m.group(1)
+    return re.split(r'[\\/]', path)[-1]
+
+
+def is_ram(addr):
+    return RAM_START <= addr < RAM_END
+
+
+def parse(path):
+    """Returns {module: [flash, ram]}."""
+    modules = {}
+    out = None          # (name, address, size, loads_from_flash)
+    out_used = 0
+    pending_out = None
+    pending_in = None
+    started = False
+
+    def add(name, flash, ram):
+        entry = modules.setdefault(name, [0, 0])
+        entry[0] += flash
+        entry[1] += ram
+
+    def close_out():
+        # Anything in the output section not accounted for by an input section
+        # (arena and stack reservations, alignment padding) goes to the section itself.
+        if out is not None and out[2] > out_used:
+            spare = out[2] - out_used
+            ram = is_ram(out[1])
+            add('(%s)' % out[0], spare if (not ram or out[3]) else 0, spare if ram else 0)
+
+    for line in open(path):
+        line = line.rstrip('\n')
+        if not started:
+            started = line.startswith('Linker script and memory map')
+            continue
+
+        m = OUT_SECTION_NAME.match(line)
+        if m:
+            pending_out = m.group(1)
+            continue
+
+        m = OUT_SECTION.match(line)
+        if not m and pending_out:
+            m2 = ADDR_SIZE.match(line)
+            if m2:
+                m = (pending_out, m2.group(1), m2.group(2), m2.group(3))
+        elif m:
+            m = m.groups()
+        pending_out = None
+        if m:
+            close_out()
+            name, addr, size, rest = m[0], int(m[1], 16), int(m[2], 16), m[3]
+            out = (name, addr, size, bool(LOAD_ADDR.search(rest)))
+            out_used = 0
+            continue
+
+        m = IN_SECTION_NAME.match(line)
+        if m:
+            pending_in = m.group(1)
+            continue
+
+        m = IN_SECTION.match(line)
+        if m:
+            addr, size, obj = int(m.group(2), 16), int(m.group(3), 16), m.group(4)
+        elif pending_in:
+            m = ADDR_SIZE.match(line)
+            addr, size, obj = (int(m.group(1), 16), int(m.group(2), 16), m.group(3)) if m else (0, 0, '')
+        pending_in = None
+        if not m or out is None or size == 0 or not obj.strip():
+            continue
+
+        out_used += size
+        ram = is_ram(addr)
+        add(module_name(obj), size if (not ram or out[3]) else 0, size if ram else 0)
+
+    close_out()
+    return modules
+
+
+def main():
+    ap = argparse.ArgumentParser(description='WAVBoard memory budget')
+    ap.add_argument('map', help='linker map file')
+    ap.add_argument('--flash', type=int, default=0, help='flash budget in bytes (0 = no limit)')
+    ap.add_argument('--ram', type=int, default=0, help='static RAM budget in bytes (0 = no limit)')
+    args = ap.parse_args()
+
+    modules = parse(args.map)
+    flash = sum(v[0] for v in modules.values())
+    ram = sum(v[1] for v in modules.values())
+
+    print('%-28s %8s %8s' % ('module', 'flash', 'ram'))
+    for name in sorted(modules, key=lambda n: (-modules[n][0] - modules[n][1], n)):
+        f, r = modules[name]
+        if f or r:
+            print('%-28s %8d %8d' % (name, f, r))
+    print('%-28s %8d %8d' % ('TOTAL', flash, ram))
+
+    failed = False
+    if args.flash:
+        print('Flash: %d of %d bytes budgeted, %d spare' % (flash, args.flash, args.flash - flash))
+        failed |= flash > args.flash
+    if args.ram:
+        print('Static RAM: %d of %d bytes budgeted, %d spare' % (ram, args.ram, args.ram - ram))
+        failed |= ram > args.ram
+
+    if failed:
+        print('error: memory budget exceeded', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
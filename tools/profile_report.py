@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+#
+# Turn a dump of the WAVBoard sampling profiler histogram into a
+# per-function hotspot report.
+#
+# 1. Uncomment PROFILER_ENABLE in platform/board.h, build and flash.
+# 2. Let the board run for a while, then find out where the histogram is:
+#        tools/profile_report.py --where Release/WAVBoard.elf
+#    and dump it from JLinkExe (the board keeps running):
+#        savebin prof.bin, <address>, <size>
+# 3. Make the report:
+#        tools/profile_report.py Release/WAVBoard.elf prof.bin
+#
+# Symbols come from the ELF (using arm-none-eabi-nm) or from the linker
+# map file if you pass the .map instead.
+
+import argparse
+import re
+import shutil
+import struct
+import subprocess
+import sys
+
+PROFILER_MAGIC = 0x464F5250
+HEADER = struct.Struct('<7I')
+NM = 'arm-none-eabi-nm'
+CXXFILT = 'arm-none-eabi-c++filt'
+
+
+def demangle(names):
+    tool = shutil.which(CXXFILT) or shutil.which('c++filt')
+    if tool is None or not names:
+        return names
+    out = subprocess.run([tool], input='\n'.join(names), capture_output=True, text=True).stdout
+    result = out.splitlines()
+    return result if len(result) == len(names) else names
+
+
+def symbols_from_elf(path):
+    """Return a list of (address, size, name) for every function in the ELF."""
+    out = subprocess.run([NM, '--print-size', '--defined-only', path],
+                         capture_output=True, text=True, check=True).stdout
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 4 or parts[2] not in 'tTwW':
+            continue
+        addr, size = int(parts[0], 16) & ~1, int(parts[1], 16)
+        if size:
+            syms.append((addr, size, parts[3]))
+    return syms
+
+
+def symbols_from_map(path):
+    """Return (address, size, name) from the input sections of a GNU ld map file.
+    We build with -ffunction-sections so each .text.<name> is one function."""
+    syms = []
+    pending = None
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'^ \.text\.(\S+)\s*$', line)
+            if m:
+                pending = m.group(1)
+                continue
+            m = re.match(r'^ (?:\.text\.(\S+))?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)', line)
+            if m:
+                name = m.group(1) or pending
+                if name:
+                    size = int(m.group(3), 16)
+                    if size:
+                        syms.append((int(m.group(2), 16), size, name))
+            pending = None
+    return syms
+
+
+def symbol_address(elf, name):
+    out = subprocess.run([NM, '--print-size', '--defined-only', elf],
+                         capture_output=True, text=True, check=True).stdout
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[3] == name:
+            return int(parts[0], 16), int(parts[1], 16)
+    raise SystemExit('%s not found in %s - is PROFILER_ENABLE set?' % (name, elf))
+
+
+def load_histogram(path):
+    data = open(path, 'rb').read()
+    if len(data) < HEADER.size:
+        raise SystemExit('%s is too short to be a profile dump' % path)
+    magic, base, shift, count, samples, isr, outside = HEADER.unpack_from(data)
+    if magic != PROFILER_MAGIC:
+        raise SystemExit('%s does not start with the profiler magic number' % path)
+    buckets = struct.unpack_from('<%dH' % count, data, HEADER.size)
+    return base, shift, buckets, samples, isr, outside
+
+
+def attribute(base, shift, buckets, syms):
+    """Share each bucket between the functions which overlap it, in proportion
+    to how many bytes of the bucket each one covers."""
+    syms = sorted(syms)
+    hits = {}
+    width = 1 << shift
+    first = 0
+    for i, count in enumerate(buckets):
+        if not count:
+            continue
+        lo = base + i * width
+        hi = lo + width
+        while first < len(syms) and syms[first][0] + syms[first][1] <= lo:
+            first += 1
+        covered = 0
+        for addr, size, name in syms[first:]:
+            if addr >= hi:
+                break
+            overlap = min(hi, addr + size) - max(lo, addr)
+            if overlap > 0:
+                hits[name] = hits.get(name, 0.0) + count * overlap / width
+                covered += overlap
+        if covered < width:
+            hits['<unknown>'] = hits.get('<unknown>', 0.0) + count * (width - covered) / width
+    return hits
+
+
+def main():
+    ap = argparse.ArgumentParser(description='WAVBoard profiler report')
+    ap.add_argument('symbols', help='WAVBoard.elf or WAVBoard.map')
+    ap.add_argument('dump', nargs='?', help='histogram dumped with J-Link savebin')
+    ap.add_argument('--where', action='store_true', help='print the J-Link command to dump the histogram')
+    ap.add_argument('--top', type=int, default=30, help='number of functions to list')
+    args = ap.parse_args()
+
+    if args.where:
+        addr, size = symbol_address(args.symbols, 'g_profile')
+        print('savebin prof.bin, 0x%08X, 0x%X' % (addr, size))
+        return
+
+    if args.dump is None:
+        ap.error('need a histogram dump')
+
+    base, shift, buckets, samples, isr, outside = load_histogram(args.dump)
+    if args.symbols.endswith('.map'):
+        syms = symbols_from_map(args.symbols)
+    else:
+        syms = symbols_from_elf(args.symbols)
+
+    hits = attribute(base, shift, buckets, syms)
+    total = sum(hits.values()) + outside
+    if total == 0:
+        raise SystemExit('no samples in the dump')
+
+    names = sorted(hits, key=hits.get, reverse=True)[:args.top]
+    pretty = demangle(names)
+
+    print('%d samples, %.1f%% in interrupt handlers, %d outside flash, %d bytes per bucket'
+          % (samples, 100.0 * isr / max(samples, 1), outside, 1 << shift))
+    print()
+    print('%9s %7s  %s' % ('samples', '%', 'function'))
+    for name, shown in zip(names, pretty):
+        print('%9.0f %6.2f%%  %s' % (hits[name], 100.0 * hits[name] / total, shown))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
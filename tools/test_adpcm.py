@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+#
+# Checks ImaAdpcmDecoder (Audio/ImaAdpcm.cpp) against a reference IMA ADPCM
+# decoder written straight from the WAV format 0x11 description. The
+# decoder is built for the PC (see host_harness.py) and fed random blocks,
+# mono and stereo, in frames of random sizes like the audio interrupt's,
+# and round the data more than once like a loop. Its output has to match
+# the reference sample for sample.
+#
+#     tools/test_adpcm.py
+#
+# Random codes go up and down the whole step table and hit the clipping at
+# both ends. The block headers include step indexes past the end of the
+# table, which a decoder has to clamp.
+
+import argparse
+import random
+import struct
+import sys
+
+import host_harness
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8] * 2
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767]
+
+HARNESS = r'''
+#include "ImaAdpcm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// harness channels blockAlign dataSize passes seed, data on stdin, frames
+// out on stdout.
+int main(int argc, char **argv)
+{
+	unsigned channels   = atoi(argv[1]);
+	unsigned blockAlign = atoi(argv[2]);
+	unsigned dataSize   = atoi(argv[3]);
+	unsigned passes     = atoi(argv[4]);
+	unsigned random     = atoi(argv[5]);
+
+	uint8_t *data = (uint8_t *)malloc(dataSize);
+	if(fread(data, 1, dataSize, stdin) != dataSize)
+		return 1;
+
+	ImaAdpcmDecoder decoder;
+	decoder.init(channels, blockAlign, dataSize);
+
+	// Feed it one input at a time, stopping where the decoder wants to go
+	// back to the start, and drain it into frames of any size.
+	AUDIOSAMPLE frame[AudioSource::kFrameSize];
+	unsigned    pos   = 0;
+	unsigned    in    = 0;
+	unsigned    size  = decoder.getInputSize();
+	while(in < passes) {
+		random = random * 1103515245 + 12345;
+		unsigned want = 1 + (random >> 8) % AudioSource::kFrameSize;
+		unsigned got  = 0;
+		while(got < want && in < passes) {
+			if(decoder.isDrained()) {
+				decoder.decode(&data[pos]);
+				pos += size;
+				if(dataSize - pos < size) {
+					pos = 0;
+					in++;
+				}
+			}
+			got += decoder.drain(&frame[got], want - got);
+		}
+		// What's left of the last input after the last pass.
+		while(in == passes && got < want && !decoder.isDrained())
+			got += decoder.drain(&frame[got], want - got);
+		fwrite(frame, sizeof(AUDIOSAMPLE), got, stdout);
+	}
+	return 0;
+}
+'''
+
+
+def decode_channel(codes, predictor, index):
+    out = []
+    for code in codes:
+        step = STEP_TABLE[index]
+        diff = step >> 3
+        if code & 4:
+            diff += step
+        if code & 2:
+            diff += step >> 1
+        if code & 1:
+            diff += step >> 2
+        predictor = predictor - diff if code & 8 else predictor + diff
+        predictor = min(max(predictor, -32768), 32767)
+        index = min(max(index + INDEX_TABLE[code], 0), 88)
+        out.append(predictor)
+    return out, predictor, index
+
+
+def reference(data, channels, block):
+    """Frames of (left, right), mono on both sides."""
+    frames = []
+    for b in range(0, len(data), block):
+        blk = data[b:b + block]
+        if len(blk) < 4 * channels:
+            break
+        chans = []
+        for c in range(channels):
+            predictor, index = struct.unpack_from('<hB', blk, 4 * c)
+            chans.append([predictor, min(index, 88), [predictor]])
+        # 4 bytes of each channel in turn, 8 codes each, low nibble first.
+        pos = 4 * channels
+        while len(blk) - pos >= 4 * channels:
+            for c in range(channels):
+                group = blk[pos + 4 * c:pos + 4 * c + 4]
+                codes = [(byte >> shift) & 0xF for byte in group for shift in (0, 4)]
+                ch = chans[c]
+                samples, ch[0], ch[1] = decode_channel(codes, ch[0], ch[1])
+                ch[2].extend(samples)
+            pos += 4 * channels
+        left = chans[0][2]
+        right = chans[-1][2]
+        frames.extend(zip(left, right))
+    return frames
+
+
+def make_data(rnd, channels, block, size):
+    """Random codes, with headers from anywhere in the range."""
+    data = bytearray(rnd.getrandbits(8) for _ in range(size))
+    for b in range(0, size, block):
+        for c in range(channels):
+            if b + 4 * c + 4 <= size:
+                sample = rnd.choice([-32768, 32767, 0, rnd.randint(-32768, 32767)])
+                struct.pack_into('<hBB', data, b + 4 * c, sample, rnd.randint(0, 100), 0)
+    return bytes(data)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Check ImaAdpcmDecoder against a reference decoder')
+    host_harness.add_arguments(ap)
+    ap.add_argument('--seed', type=int, default=1, help='random seed')
+    args = ap.parse_args()
+
+    harness = host_harness.Harness(args, HARNESS, ['Audio/ImaAdpcm.cpp'])
+    rnd = random.Random(args.seed)
+
+    # (channels, blockAlign, data size). Sizes that aren't a whole number
+    # of blocks end on a short block.
+    cases = [(1, 256, 256 * 8), (2, 512, 512 * 6), (2, 1024, 1024 * 3 + 520),
+             (1, 36, 36 * 40 + 20), (2, 2048, 2048 * 2), (1, 512, 4 + 4 * 3)]
+    failed = 0
+    for channels, block, size in cases:
+        data = make_data(rnd, channels, block, size)
+        passes = 3
+        out = harness.run([channels, block, size, passes, rnd.getrandbits(16)], data)
+        got = [(s & 0xFFFF, s >> 16) for s in struct.unpack('<%dI' % (len(out) // 4), out)]
+        want = [(l & 0xFFFF, r & 0xFFFF) for l, r in reference(data, channels, block)] * passes
+        name = '%s, blockAlign %d, %d bytes' % ('stereo' if channels == 2 else 'mono', block, size)
+        if got == want:
+            print('%s: %d frames match' % (name, len(got)))
+            continue
+        failed += 1
+        bad = next((i for i, (g, w) in enumerate(zip(got, want)) if g != w), min(len(got), len(want)))
+        print('%s: FAILED at frame %d of %d (got %d frames)' % (name, bad, len(want), len(got)))
+
+    harness.close()
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
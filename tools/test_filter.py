@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+#
+# Checks FilterSource (Audio/FilterSource.cpp) against a double precision
+# model of the same filters. The fixed point ones can't match bit for bit,
+# so each has to stay within a tolerance of the model, in LSBs of the 16-bit
+# output:
+#
+#     tools/test_filter.py
+#
+# The biquad model is Robert Bristow-Johnson's cookbook filter worked out
+# with floating point trig from the cutoff and resonance steps, so the
+# check covers the coefficient tables and design as well as the filter.
+# The state variable model is Chamberlin's with the same f and damping the
+# firmware uses, rounded to Q15 the way its tables are, and f held down to
+# the same stability limit. Its cutoff is only as exact as that rounding by
+# design, which at the bottom is a few percent, so that's left out.
+#
+# Each type and structure is run at a spread of cutoffs and resonances with
+# white noise on the left and a sine at the cutoff on the right, both low
+# enough that the resonant peak doesn't clip. The settings are held, with
+# kPerFrame. --verbose prints the error for every setting.
+
+import argparse
+import math
+import random
+import struct
+import sys
+
+import host_harness
+
+SAMPLE_RATE = 44117  # AudioSource::kSampleRate
+CUTOFF_STEPS = 120
+RESONANCE_STEPS = 16
+SVF_MARGIN = 0.9
+TYPES = ['low pass', 'high pass', 'band pass', 'notch']
+STRUCTURES = ['biquad', 'state variable']
+
+# Worst error allowed, and RMS error, in LSBs. The biquad's error feedback
+# uses -a1 rounded to a whole number, so where it's well off one (middle
+# cutoffs at low resonance) a little of the output rounding gets through
+# the poles. The state variable filter keeps 10 bits of fraction.
+TOLERANCE = {'biquad': (5.0, 1.5), 'state variable': (2.0, 1.0)}
+
+LENGTH = 4096
+
+HARNESS = r'''
+#include "FilterSource.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// harness structure type cutoff resonance, stereo samples on stdin, the
+// filtered ones on stdout.
+int main(int argc, char **argv)
+{
+	static AUDIOSAMPLE buffer[AudioSource::kFrameSize];
+	FilterSource filter;
+	filter.setType((FilterSource::Type)atoi(argv[2]), (FilterSource::Structure)atoi(argv[1]));
+	filter.setCutoff(atoi(argv[3]));
+	filter.setResonance(atoi(argv[4]));
+	filter.setUpdate(FilterSource::kPerFrame);
+
+	size_t count;
+	while((count = fread(buffer, sizeof(AUDIOSAMPLE), AudioSource::kFrameSize, stdin)) != 0) {
+		filter.process(buffer, count);
+		fwrite(buffer, sizeof(AUDIOSAMPLE), count, stdout);
+	}
+	return 0;
+}
+'''
+
+
+def w0(cutoff):
+    return 2 * math.pi * 20 * 2 ** (cutoff / 12.0) / SAMPLE_RATE
+
+
+def damping(resonance):
+    """1 / Q."""
+    return 2 / 2 ** (resonance / 4.0)
+
+
+def biquad(kind, cutoff, resonance, x):
+    w = w0(cutoff)
+    alpha = math.sin(w) * damping(resonance) / 2
+    cosw = math.cos(w)
+    if kind == 0:
+        b = [(1 - cosw) / 2, 1 - cosw, (1 - cosw) / 2]
+    elif kind == 1:
+        b = [(1 + cosw) / 2, -(1 + cosw), (1 + cosw) / 2]
+    elif kind == 2:
+        b = [alpha, 0, -alpha]
+    else:
+        b = [1, -2 * cosw, 1]
+    a0 = 1 + alpha
+    b0, b1, b2 = (v / a0 for v in b)
+    a1, a2 = -2 * cosw / a0, (1 - alpha) / a0
+
+    y = []
+    x1 = x2 = y1 = y2 = 0.0
+    for v in x:
+        out = b0 * v + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2
+        x2, x1 = x1, v
+        y2, y1 = y1, out
+        y.append(out)
+    return y
+
+
+def state_variable(kind, cutoff, resonance, x):
+    q = damping(resonance)
+    d = min(round(q * 32768), 0xFFFF) / 32768
+    f = round(2 * math.sin(w0(cutoff) / 2) * 32768)
+    f = min(f, round(SVF_MARGIN * (math.sqrt(q * q + 4) - q) * 32768)) / 32768
+
+    y = []
+    low = band = 0.0
+    for v in x:
+        low += f * band
+        high = v - low - d * band
+        band += f * high
+        y.append([low, high, band * d, low + high][kind])
+    return y
+
+
+def signals(rnd, cutoff, resonance):
+    """Noise and a sine at the cutoff, quiet enough not to clip."""
+    level = 6000 / (1 + 2 ** (resonance / 4.0))
+    left = [rnd.uniform(-level, level) for _ in range(LENGTH)]
+    w = w0(cutoff)
+    right = [level * math.sin(w * i) for i in range(LENGTH)]
+    return [int(round(v)) for v in left], [int(round(v)) for v in right]
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Check FilterSource against a double precision model')
+    host_harness.add_arguments(ap)
+    ap.add_argument('--seed', type=int, default=1, help='random seed')
+    ap.add_argument('--verbose', action='store_true', help='print the error at every setting')
+    args = ap.parse_args()
+
+    harness = host_harness.Harness(args, HARNESS, ['Audio/FilterSource.cpp'])
+    rnd = random.Random(args.seed)
+
+    cutoffs = list(range(0, CUTOFF_STEPS, 9)) + [CUTOFF_STEPS - 1]
+    resonances = [0, 2, 6, 10, RESONANCE_STEPS - 1]
+    worst = {}
+    failed = 0
+    for structure, sname in enumerate(STRUCTURES):
+        model = biquad if structure == 0 else state_variable
+        limit, rms_limit = TOLERANCE[sname]
+        for kind, tname in enumerate(TYPES):
+            for cutoff in cutoffs:
+                for resonance in resonances:
+                    left, right = signals(rnd, cutoff, resonance)
+                    data = b''.join(struct.pack('<hh', l, r) for l, r in zip(left, right))
+                    out = harness.run([structure, kind, cutoff, resonance], data)
+                    got = struct.unpack('<%dh' % (2 * LENGTH), out)
+
+                    err = []
+                    for c, x in enumerate((left, right)):
+                        want = model(kind, cutoff, resonance, x)
+                        err.extend(g - min(max(w, -32768), 32767) for g, w in zip(got[c::2], want))
+                    peak = max(abs(e) for e in err)
+                    rms = math.sqrt(sum(e * e for e in err) / len(err))
+
+                    key = (sname, tname)
+                    if peak > worst.get(key, (0, 0))[0]:
+                        worst[key] = (peak, rms)
+                    bad = peak > limit or rms > rms_limit
+                    if bad or args.verbose:
+                        print('%s %s, cutoff %d, resonance %d: error %.1f LSB, RMS %.2f%s' %
+                              (sname, tname, cutoff, resonance, peak, rms, ' FAILED' if bad else ''))
+                    failed += bad
+
+    harness.close()
+    for (sname, tname), (peak, rms) in sorted(worst.items()):
+        print('%s %s: worst error %.1f LSB (RMS %.2f), allowed %.1f' %
+              (sname, tname, peak, rms, TOLERANCE[sname][0]))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+#
+# Checks GainStage (Audio/GainStage.cpp) bit for bit against a plain model of
+# what it's meant to do: each sample times its gain, shifted down 15 with
+# the remainder dropped (towards minus infinity), clamped to 16 bits by
+# process() and not by accumulate(). A new gain ramps there over the frame
+# in equal steps, the step rounded towards zero, and lands on the gain
+# exactly after the last sample.
+#
+#     tools/test_gain.py
+#
+# The GainStage is built for the PC (see host_harness.py) and run through
+# a few thousand frames of random samples, including full scale, with
+# random gains: held, ramped up and down, jumped to, unity, zero and the
+# maximum, left and right different. The packed lane arithmetic and the
+# shortcuts for unity, silence and gains that can't clip all have to come
+# out the same as the model.
+
+import argparse
+import random
+import struct
+import sys
+
+import host_harness
+
+FRAME_SIZE = 128  # AudioSource::kFrameSize
+UNITY = 0x8000
+MAX_GAIN = 0xFFFF
+
+OP_NONE = 0
+OP_SET = 1
+OP_JUMP = 2
+
+HARNESS = r'''
+#include "GainStage.h"
+#include <stdio.h>
+
+// Frames on stdin, each a header (op, left, right, accumulate, count), the
+// samples and, for accumulate, the mix buffer to add to. What comes out of
+// each one goes to stdout, then whether the gain is silent.
+int main()
+{
+	static AUDIOSAMPLE buffer[AudioSource::kFrameSize];
+	static int32_t     mix[AudioSource::kFrameSize * 2];
+	GainStage gain;
+
+	uint16_t head[5];
+	while(fread(head, sizeof(head), 1, stdin) == 1) {
+		unsigned count = head[4];
+		if(head[0] == 1)
+			gain.setGain(head[1], head[2]);
+		else if(head[0] == 2)
+			gain.jumpTo(head[1], head[2]);
+
+		if(fread(buffer, sizeof(AUDIOSAMPLE), count, stdin) != count)
+			return 1;
+		if(head[3]) {
+			if(fread(mix, sizeof(int32_t), count * 2, stdin) != count * 2)
+				return 1;
+			gain.accumulate(mix, buffer, count);
+			fwrite(mix, sizeof(int32_t), count * 2, stdout);
+		} else {
+			gain.process(buffer, count);
+			fwrite(buffer, sizeof(AUDIOSAMPLE), count, stdout);
+		}
+		uint8_t silent = gain.isSilent();
+		fwrite(&silent, 1, 1, stdout);
+	}
+	return 0;
+}
+'''
+
+
+def clamp16(v):
+    return min(max(v, -32768), 32767)
+
+
+def ramp_step(a, b, count):
+    """(b - a) / count the C way, rounded towards zero."""
+    d = b - a
+    return d // count if d >= 0 else -(-d // count)
+
+
+class Model:
+    def __init__(self):
+        self.target = [UNITY, UNITY]
+        self.gain = [UNITY, UNITY]
+
+    def run(self, op, left, right, samples, mix):
+        if op == OP_SET:
+            self.target = [left, right]
+        elif op == OP_JUMP:
+            self.target = [left, right]
+            self.gain = [left, right]
+
+        count = len(samples)
+        steps = [ramp_step(self.gain[c], self.target[c], count) for c in range(2)]
+        out = []
+        for i, s in enumerate(samples):
+            for c in range(2):
+                v = (s[c] * (self.gain[c] + i * steps[c])) >> 15
+                if mix is None:
+                    out.append(clamp16(v))
+                else:
+                    out.append(mix[2 * i + c] + v)
+        self.gain = list(self.target)
+        return out, self.gain == [0, 0]
+
+
+def random_gain(rnd):
+    return rnd.choice([0, UNITY, UNITY + 1, MAX_GAIN, rnd.randint(0, 16),
+                       rnd.randint(0, UNITY), rnd.randint(UNITY, MAX_GAIN)])
+
+
+def random_sample(rnd):
+    return rnd.choice([-32768, 32767, 0, rnd.randint(-32768, 32767), rnd.randint(-64, 64)])
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Check GainStage bit for bit against a model')
+    host_harness.add_arguments(ap)
+    ap.add_argument('--seed', type=int, default=1, help='random seed')
+    ap.add_argument('--frames', type=int, default=4000, help='number of frames to run')
+    args = ap.parse_args()
+
+    harness = host_harness.Harness(args, HARNESS, ['Audio/GainStage.cpp'])
+    rnd = random.Random(args.seed)
+    model = Model()
+
+    # Build the whole run, then compare it frame by frame.
+    script = bytearray()
+    want = []
+    for _ in range(args.frames):
+        op = rnd.choice([OP_NONE, OP_NONE, OP_SET, OP_SET, OP_JUMP])
+        left = random_gain(rnd)
+        right = left if rnd.random() < 0.5 else random_gain(rnd)
+        accumulate = rnd.random() < 0.3
+        count = rnd.choice([FRAME_SIZE, FRAME_SIZE, FRAME_SIZE, 1, 7, rnd.randint(1, FRAME_SIZE)])
+        samples = [(random_sample(rnd), random_sample(rnd)) for _ in range(count)]
+        mix = [rnd.randint(-1 << 20, 1 << 20) for _ in range(2 * count)] if accumulate else None
+
+        script += struct.pack('<5H', op, left, right, accumulate, count)
+        script += b''.join(struct.pack('<hh', l, r) for l, r in samples)
+        if accumulate:
+            script += struct.pack('<%di' % len(mix), *mix)
+        out, silent = model.run(op, left, right, samples, mix)
+        want.append((out, silent, accumulate))
+
+    got = harness.run([], bytes(script))
+    harness.close()
+
+    pos = 0
+    for n, (out, silent, accumulate) in enumerate(want):
+        size = 4 * len(out) if accumulate else 2 * len(out)
+        fmt = '<%d%s' % (len(out), 'i' if accumulate else 'h')
+        result = list(struct.unpack_from(fmt, got, pos))
+        pos += size
+        got_silent = bool(got[pos])
+        pos += 1
+        if result != out or got_silent != silent:
+            bad = next((i for i, (g, w) in enumerate(zip(result, out)) if g != w), None)
+            print('frame %d (%s): FAILED at %s, got %s want %s' %
+                  (n, 'accumulate' if accumulate else 'process',
+                   'isSilent()' if bad is None else 'sample %d' % (bad // 2),
+                   got_silent if bad is None else result[bad], silent if bad is None else out[bad]))
+            return 1
+
+    print('%d frames match' % len(want))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
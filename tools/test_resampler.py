@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+#
+# Checks the Resampler's audio rate speed input (Audio/Resampler.cpp,
+# setSpeedInput()) against a model of the same fixed point sums. Each
+# output has its own speed, so the position has to come out the same
+# however the outputs are split into runs and the input into windows:
+#
+#     tools/test_resampler.py
+#
+# The harness drives it a frame at a time the way WavSource does, startFrame()
+# and then runs of getMaxOutput(), with random input and a speed for every
+# output swept and jumped about between still and kMaxSpeed, and beyond to
+# check it's held there. Linear and Hermite are integer sums so they have to
+# match the model exactly, from input rates either side of the output's.
+
+import argparse
+import random
+import struct
+import sys
+
+import host_harness
+
+SAMPLE_RATE = 44117  # AudioSource::kSampleRate
+FRAME = 128          # AudioSource::kFrameSize
+TAPS = 8
+HALF_TAPS = TAPS // 2
+MAX_RATE = 48000
+UNITY = 0x10000
+MAX_SPEED = 4 * UNITY
+INTERPOLATIONS = {'linear': 1, 'hermite': 2}  # Resampler::Interpolation
+
+HARNESS = r'''
+#include "Resampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// harness interpolation rate inputs frames, the input then the speeds on
+// stdin, the output on stdout.
+int main(int argc, char **argv)
+{
+	unsigned interpolation = atoi(argv[1]);
+	unsigned rate   = atoi(argv[2]);
+	unsigned inputs = atoi(argv[3]);
+	unsigned frames = atoi(argv[4]);
+
+	AUDIOSAMPLE *input  = (AUDIOSAMPLE *)malloc(inputs * sizeof(AUDIOSAMPLE));
+	uint32_t    *speeds = (uint32_t *)malloc(frames * AudioSource::kFrameSize * sizeof(uint32_t));
+	if(fread(input, sizeof(AUDIOSAMPLE), inputs, stdin) != inputs
+	|| fread(speeds, sizeof(uint32_t), frames * AudioSource::kFrameSize, stdin) != frames * AudioSource::kFrameSize)
+		return 1;
+
+	Resampler resampler;
+	resampler.init(rate, AudioSource::kSampleRate);
+	resampler.setInterpolation((Resampler::Interpolation)interpolation);
+
+	// Like WavSource::decodeResampled(), with the speeds for each frame
+	// put in where the caller would refill them.
+	unsigned pos = 0;
+	for(unsigned f = 0; f < frames; f++) {
+		AUDIOSAMPLE out[AudioSource::kFrameSize];
+		uint32_t    frameSpeeds[AudioSource::kFrameSize];
+		for(unsigned i = 0; i < AudioSource::kFrameSize; i++)
+			frameSpeeds[i] = speeds[f * AudioSource::kFrameSize + i];
+		resampler.setSpeedInput(frameSpeeds);
+		resampler.startFrame();
+
+		unsigned done = 0;
+		bool     end  = false;
+		while(done < AudioSource::kFrameSize) {
+			unsigned want = AudioSource::kFrameSize - done;
+			unsigned most = resampler.getMaxOutput();
+			if(want > most)
+				want = most;
+
+			unsigned need = resampler.getInputNeeded(want);
+			unsigned got  = 0;
+			while(got < need && pos < inputs)
+				resampler.getInput()[got++] = input[pos++];
+			done += resampler.process(&out[done], want, got);
+			if(got < need) {
+				end = true;
+				break;
+			}
+		}
+		fwrite(out, sizeof(AUDIOSAMPLE), done, stdout);
+		if(end)
+			break;
+	}
+	return 0;
+}
+'''
+
+
+def saturate16(x):
+    return max(-32768, min(32767, x))
+
+
+def linear(x, i, pos):
+    t = (pos & 0xFFFF) >> 2
+    return x[i] + (((x[i + 1] - x[i]) * t) >> 14)
+
+
+def hermite(x, i, pos):
+    t = (pos & 0xFFFF) >> 6
+    xm1, x0, x1, x2 = x[i - 1], x[i], x[i + 1], x[i + 2]
+    c1 = x1 - xm1
+    c2 = 2 * xm1 - 5 * x0 + 4 * x1 - x2
+    c3 = x2 - xm1 + 3 * (x0 - x1)
+    return saturate16(x0 + ((((((((c3 * t) >> 10) + c2) * t) >> 10) + c1) * t) >> 11))
+
+
+def model(interpolate, rate, left, right, speeds):
+    """The outputs for each channel, from the first output landing on the
+    first input with kTaps frames of silence before it."""
+    ratio = min((min(rate, MAX_RATE) << 16) // SAMPLE_RATE, MAX_RATE * 0x10000 // SAMPLE_RATE)
+    left = [0] * TAPS + left
+    right = [0] * TAPS + right
+    pos = TAPS << 16
+    out = []
+    for speed in speeds:
+        i = pos >> 16
+        if i + HALF_TAPS >= len(left):
+            break
+        out.append((interpolate(left, i, pos) & 0xFFFF, interpolate(right, i, pos) & 0xFFFF))
+        pos += (ratio * (min(speed, MAX_SPEED) >> 4)) >> 12
+    return out
+
+
+def make_speeds(rnd, frames):
+    """Sweeps, a sine-ish wobble, jumps and the odd stop or overspeed."""
+    speeds = []
+    speed = UNITY
+    for i in range(frames * FRAME):
+        r = rnd.random()
+        if r < 0.01:
+            speed = rnd.choice([0, MAX_SPEED, MAX_SPEED * 2, UNITY // 3])
+        elif r < 0.05:
+            speed = rnd.randint(0, MAX_SPEED)
+        else:
+            speed = max(0, speed + rnd.randint(-2000, 2000))
+        speeds.append(speed)
+    return speeds
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Check the Resampler speed input against a model')
+    host_harness.add_arguments(ap)
+    ap.add_argument('--seed', type=int, default=1, help='random seed')
+    args = ap.parse_args()
+
+    harness = host_harness.Harness(args, HARNESS, ['Audio/Resampler.cpp'])
+    rnd = random.Random(args.seed)
+
+    failed = 0
+    for name, interpolation in sorted(INTERPOLATIONS.items()):
+        interpolate = linear if name == 'linear' else hermite
+        for rate in (22050, 44100, 48000):
+            frames = 40
+            inputs = 8000
+            left = [rnd.randint(-32768, 32767) for _ in range(inputs)]
+            right = [rnd.randint(-20000, 20000) for _ in range(inputs)]
+            speeds = make_speeds(rnd, frames)
+
+            data = struct.pack('<%dI' % inputs, *[(l & 0xFFFF) | ((r & 0xFFFF) << 16) for l, r in zip(left, right)])
+            data += struct.pack('<%dI' % len(speeds), *speeds)
+            out = harness.run([interpolation, rate, inputs, frames], data)
+            got = [(s & 0xFFFF, s >> 16) for s in struct.unpack('<%dI' % (len(out) // 4), out)]
+            want = model(interpolate, rate, left, right, speeds)
+
+            label = '%s from %dHz' % (name, rate)
+            if got == want:
+                print('%s: %d outputs match' % (label, len(got)))
+                continue
+            failed += 1
+            bad = next((i for i, (g, w) in enumerate(zip(got, want)) if g != w), min(len(got), len(want)))
+            print('%s: FAILED at output %d of %d (got %d)' % (label, bad, len(want), len(got)))
+
+    harness.close()
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
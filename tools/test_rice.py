@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+#
+# Checks RiceDecoder (Audio/RiceLossless.cpp) by round trip: test signals
+# are compressed with tools/wav2rice.py and decoded by the firmware's
+# decoder built for the PC (see host_harness.py). It is fed four bytes at a
+# time and drained in frames of random sizes like the audio interrupt's,
+# round the data more than once like a loop, so the short last block is
+# followed straight on by the first one again. The output has to be the
+# samples that went in.
+#
+#     tools/test_rice.py
+#
+# The signals are made to need every part of the format: mono and stereo,
+# left and side coding, escaped samples and blocks stored as they are. The
+# test fails if the encoder didn't use one of them, as then it wouldn't
+# have been tested.
+
+import argparse
+import math
+import random
+import struct
+import sys
+
+import host_harness
+import wav2rice
+
+HARNESS = r'''
+#include "RiceLossless.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// harness channels blockAlign dataSize passes seed, data on stdin, frames
+// out on stdout.
+int main(int argc, char **argv)
+{
+	unsigned channels   = atoi(argv[1]);
+	unsigned blockAlign = atoi(argv[2]);
+	unsigned dataSize   = atoi(argv[3]);
+	unsigned passes     = atoi(argv[4]);
+	unsigned random     = atoi(argv[5]);
+
+	uint8_t *data = (uint8_t *)malloc(dataSize);
+	if(fread(data, 1, dataSize, stdin) != dataSize)
+		return 1;
+
+	RiceDecoder decoder;
+	decoder.init(channels, blockAlign, dataSize);
+
+	// Like WavSource::decodeWith(), feed it when it decodes fewer frames
+	// than asked for.
+	AUDIOSAMPLE frame[AudioSource::kFrameSize];
+	unsigned    pos = 0;
+	unsigned    in  = 0;
+	unsigned    size = decoder.getInputSize();
+	while(1) {
+		random = random * 1103515245 + 12345;
+		unsigned want = 1 + (random >> 8) % AudioSource::kFrameSize;
+		unsigned got  = decoder.drain(frame, want);
+		while(got < want && in < passes) {
+			decoder.decode(&data[pos]);
+			pos += size;
+			if(pos >= dataSize) {
+				pos = 0;
+				in++;
+			}
+			got += decoder.drain(&frame[got], want - got);
+		}
+		fwrite(frame, sizeof(AUDIOSAMPLE), got, stdout);
+		if(got < want)
+			break; // Everything fed in has come out.
+	}
+	return 0;
+}
+'''
+
+
+def clip(x):
+    return max(-32768, min(32767, int(x)))
+
+
+def make_signal(rnd, channels, frames, kind):
+    """Interleaved 16-bit samples. Each kind is a few sections, so the
+    encoder has to change its coding from block to block."""
+    out = []
+    phase = rnd.random() * 6.28
+    for i in range(frames):
+        section = i * 4 // frames
+        t = i / 44100.0
+        tone = 8000 * math.sin(2 * math.pi * 220 * t + phase)
+        if kind == 'quiet' or section == 0:
+            left = tone + rnd.randint(-3, 3)
+            right = tone * 0.9 + rnd.randint(-3, 3)
+        elif section == 1:
+            # Full scale noise, only storing it as it is will do.
+            left = rnd.randint(-32768, 32767)
+            right = rnd.randint(-32768, 32767)
+        elif section == 2:
+            # Quiet with clicks, which don't fit the block's Rice codes.
+            click = rnd.choice([-30000, 30000]) if rnd.random() < 0.02 else 0
+            left = tone / 16 + click
+            right = tone / 16 - click
+        else:
+            # Wide stereo, left and right apart.
+            left = tone
+            right = 6000 * math.sin(2 * math.pi * 331 * t)
+        if channels == 1:
+            out.append(clip(left))
+        else:
+            out.extend((clip(left), clip(right)))
+    return out
+
+
+def block_features(data, channels, block):
+    """Which parts of the format the data uses: a set of 'side', 'raw' and
+    'escape'. Reads it the same way as wav2rice.decode()."""
+    seen = set()
+    for b in range(0, len(data), block):
+        r = wav2rice.BitReader(data[b:b + block])
+        n = r.read(16)
+        side = r.read(1) and channels == 2
+        params = [(r.read(2), r.read(5)) for _ in range(2)]
+        if side:
+            seen.add('side')
+        for i in range(n):
+            for c in range(channels):
+                order, k = params[c]
+                raw = 17 if (c == 1 and side) else 16
+                if order == wav2rice.ORDER_RAW or i < order:
+                    if order == wav2rice.ORDER_RAW:
+                        seen.add('raw')
+                    r.read(raw)
+                    continue
+                q = 0
+                while q < wav2rice.ESCAPE and r.read(1):
+                    q += 1
+                if q == wav2rice.ESCAPE:
+                    seen.add('escape')
+                    r.read(wav2rice.ESCAPE_BITS)
+                else:
+                    r.read(k)
+    return seen
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Check RiceDecoder against wav2rice.py by round trip')
+    host_harness.add_arguments(ap)
+    ap.add_argument('--seed', type=int, default=1, help='random seed')
+    args = ap.parse_args()
+
+    harness = host_harness.Harness(args, HARNESS, ['Audio/RiceLossless.cpp'])
+    rnd = random.Random(args.seed)
+
+    # (channels, blockAlign, frames, signal). None of them are a whole
+    # number of blocks, so each ends on a short block.
+    cases = [(1, 512, 6000, 'mixed'), (2, 512, 5000, 'mixed'), (2, 512, 3001, 'quiet'),
+             (2, 64, 1500, 'mixed'), (1, 16, 700, 'mixed')]
+    failed = 0
+    features = set()
+    for channels, block, frames, kind in cases:
+        samples = make_signal(rnd, channels, frames, kind)
+        blocks = wav2rice.encode(samples, channels, block)
+        data = b''.join(b[0] for b in blocks)
+        features |= block_features(data, channels, block)
+
+        passes = 3
+        out = harness.run([channels, block, len(data), passes, rnd.getrandbits(16)], data)
+        got = [(s & 0xFFFF, s >> 16) for s in struct.unpack('<%dI' % (len(out) // 4), out)]
+        chans = [samples[c::channels] for c in range(channels)]
+        want = [(l & 0xFFFF, r & 0xFFFF) for l, r in zip(chans[0], chans[-1])] * passes
+
+        name = '%s %s, blockAlign %d, %d frames in %d blocks' % (
+            'stereo' if channels == 2 else 'mono', kind, block, frames, len(blocks))
+        if got == want:
+            print('%s: %d frames match' % (name, len(got)))
+            continue
+        failed += 1
+        bad = next((i for i, (g, w) in enumerate(zip(got, want)) if g != w), min(len(got), len(want)))
+        print('%s: FAILED at frame %d of %d (got %d frames)' % (name, bad, len(want), len(got)))
+
+    missing = {'side', 'raw', 'escape'} - features
+    if missing:
+        print('FAILED: the signals never used %s' % ', '.join(sorted(missing)))
+        failed += 1
+
+    harness.close()
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
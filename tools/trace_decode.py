@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+#
+# Decode a WAVBoard trace capture into a timeline.
+#
+# 1. Uncomment TRACE_ENABLE in platform/board.h, build and flash.
+# 2. Capture the RTT channel while the board runs:
+#        JLinkRTTLogger -Device MKL17Z32xxx4 -If SWD -Speed 4000 -RTTChannel 0 trace.bin
+# 3. Decode it:
+#        tools/trace_decode.py trace.bin
+#
+# Event names are read from drivers/Trace.h (and benchmark names from
+# Audio/Benchmark.h) so they always match the firmware.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+CORE_CLOCK = 48000000
+FRAME_SIZE = 128
+SAMPLE_RATE = 44117
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TRACE_H = os.path.join(HERE, '..', 'drivers', 'Trace.h')
+BENCHMARK_H = os.path.join(HERE, '..', 'Audio', 'Benchmark.h')
+
+
+def load_event_names(path, prefix='kTrace'):
+    names = {}
+    if not os.path.exists(path):
+        return names
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'\s*%s(\w+)\s*=\s*(\d+)\s*,' % prefix, line)
+            if m:
+                names[int(m.group(2))] = m.group(1)
+    return names
+
+
+def read_events(path):
+    """Yield (cycles, id, arg) with the 32-bit cycle counter unwrapped."""
+    data = open(path, 'rb').read()
+    upper = 0
+    last = None
+    for off in range(0, len(data) - 7, 8):
+        time, info = struct.unpack_from('<II', data, off)
+        if last is not None and time < last:
+            upper += 1 << 32
+        last = time
+        yield upper + time, info & 0xFF, info >> 8
+
+
+def main():
+    ap = argparse.ArgumentParser(description='WAVBoard trace decoder')
+    ap.add_argument('capture', help='raw RTT channel capture')
+    ap.add_argument('--header', default=TRACE_H, help='Trace.h to take event names from')
+    ap.add_argument('--rate', type=int, default=SAMPLE_RATE, help='audio sample rate in Hz')
+    ap.add_argument('--summary', action='store_true', help='only print the summary')
+    args = ap.parse_args()
+
+    names = load_event_names(args.header)
+    bench_names = load_event_names(BENCHMARK_H, 'kBench')
+    frame_cycles = CORE_CLOCK * FRAME_SIZE / args.rate
+
+    start = None
+    prev = None
+    irq_start = None
+    last_irq = None
+    sd_start = None
+    fills = []
+    sd_reads = []
+    bench = None
+    benchmarks = []
+    triggered = {}
+    latencies = []
+    underruns = 0
+    late = 0
+    lost = 0
+
+    for cycles, ev, arg in read_events(args.capture):
+        if start is None:
+            start = prev = cycles
+        name = names.get(ev, 'Event%d' % ev)
+        note = ''
+
+        if name == 'AudioIrqStart':
+            if last_irq is not None and cycles - last_irq > frame_cycles * 1.5:
+                late += 1
+                note = '  <-- DROPOUT, %.2fms since last frame' % ((cycles - last_irq) * 1000.0 / CORE_CLOCK)
+            irq_start = last_irq = cycles
+        elif name == 'AudioIrqEnd' and irq_start is not None:
+            fills.append(cycles - irq_start)
+            note = '  fill took %.0fus (%.0f%% of a frame)' % ((cycles - irq_start) * 1e6 / CORE_CLOCK,
+                                                          100.0 * (cycles - irq_start) / frame_cycles)
+        elif name == 'SdReadStart':
+            sd_start = cycles
+        elif name == 'SdReadEnd' and sd_start is not None:
+            sd_reads.append((cycles - sd_start, arg))
+            note = '  %.0fus' % ((cycles - sd_start) * 1e6 / CORE_CLOCK)
+        elif name == 'VoiceTrigger':
+            triggered[arg] = cycles
+        elif name == 'VoiceSound' and arg in triggered:
+            latencies.append(cycles - triggered.pop(arg))
+            note = '  %.2fms after the trigger' % (latencies[-1] * 1000.0 / CORE_CLOCK)
+        elif name == 'StreamUnderrun':
+            underruns += 1
+        elif name == 'Overflow':
+            lost += arg
+        elif name == 'Benchmark':
+            bench = bench_names.get(arg, 'Benchmark%d' % arg)
+            note = '  ' + bench
+        elif name == 'BenchCycles' and bench is not None:
+            benchmarks.append((bench, arg))
+            note = '  %.1f%% of a frame' % (100.0 * arg / frame_cycles)
+            bench = None
+
+        if not args.summary:
+            print('%12.1fus %+10.1fus  %-14s %8d%s' % ((cycles - start) * 1e6 / CORE_CLOCK,
+                                                  (cycles - prev) * 1e6 / CORE_CLOCK, name, arg, note))
+        prev = cycles
+
+    if start is None:
+        raise SystemExit('no events in capture')
+
+    print()
+    print('Frame period %.0fus' % (frame_cycles * 1e6 / CORE_CLOCK))
+    if fills:
+        print('Audio ISR: %d frames, average %.0fus, worst %.0fus (%.0f%% CPU average), %d dropouts'
+              % (len(fills), sum(fills) * 1e6 / CORE_CLOCK / len(fills), max(fills) * 1e6 / CORE_CLOCK,
+                 100.0 * sum(fills) / len(fills) / frame_cycles, late))
+    if sd_reads:
+        sectors = sum(n for _, n in sd_reads)
+        busy = sum(c for c, _ in sd_reads)
+        print('SD reads: %d sectors in %d reads, worst read %.0fus, %.0f kB/s while reading'
+              % (sectors, len(sd_reads), max(c for c, _ in sd_reads) * 1e6 / CORE_CLOCK,
+                 sectors * 512.0 / (busy / CORE_CLOCK) / 1024 if busy else 0))
+    if latencies:
+        # The frame then waits in the DMA double buffer for one more frame
+        # period before it reaches the DAC.
+        print('Trigger to first frame: %d triggers, best %.2fms, average %.2fms, worst %.2fms (plus %.1fms to the DAC)'
+              % (len(latencies), min(latencies) * 1000.0 / CORE_CLOCK,
+                 sum(latencies) * 1000.0 / CORE_CLOCK / len(latencies), max(latencies) * 1000.0 / CORE_CLOCK,
+                 frame_cycles * 1000.0 / CORE_CLOCK))
+    if underruns:
+        print('%d stream underruns' % underruns)
+    if benchmarks:
+        # "Fit" is how many of each would take the whole frame period, an
+        # upper bound on voices before anything else is counted.
+        print('Benchmarks (cycles per frame):')
+        for bench, cycles in benchmarks:
+            print('  %-24s %8d  %5.1f%% CPU  fit %d' % (bench, cycles, 100.0 * cycles / frame_cycles,
+                                                        int(frame_cycles // cycles) if cycles else 0))
+    if lost:
+        print('%d events were lost because the host could not keep up' % lost)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
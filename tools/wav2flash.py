@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+#
+# Build WAV files into the firmware as a flash sample bank.
+#
+# Writes a C++ source file with each sample as a const array in the
+# .samplebank section (see the linker script) and a table FlashSampleSource
+# looks them up in. Normally run from the Makefile:
+#
+#     make samplebank SAMPLE_BANK="samples/CLICK.WAV samples/RIM.WAV"
+#
+# or by hand:
+#
+#     tools/wav2flash.py -o Audio/SampleBank.cpp samples/CLICK.WAV
+#
+# Each sample is named "/" plus its file name in upper case, the same as the
+# path of that file on the SD card, so it can stand in for the card copy.
+#
+# Samples are stored as signed 16-bit, mono or stereo as the WAV file is
+# (--mono mixes stereo down to halve the flash used). 8-bit and 24-bit files
+# are converted. There is no resampling, samples play at the I2S rate. That
+# can only be switched to within 0.1% of the 11.025kHz family of rates (see
+# AudioKinetisI2S::isInTune()), anything else plays out of tune at 44117Hz.
+
+import argparse
+import os
+import struct
+import sys
+import wave
+
+I2S_CLOCK = 48000000 // 64  # FlexIO clock over the bits in a frame, see AudioKinetisI2S.cpp.
+I2S_DEFAULT_RATE = 44117
+
+
+def in_tune(rate):
+    """AudioKinetisI2S::isInTune()."""
+    divider = min(max((I2S_CLOCK + rate // 2) // rate, 2), 256)
+    return abs(I2S_CLOCK // divider - rate) * 1000 <= rate
+
+
+def load(path, mono):
+    """Returns (name, channels, rate, list of 16-bit samples)."""
+    w = wave.open(path, 'rb')
+    channels = w.getnchannels()
+    width = w.getsampwidth()
+    rate = w.getframerate()
+    raw = w.readframes(w.getnframes())
+    w.close()
+
+    if channels not in (1, 2):
+        raise SystemExit('%s: %d channels, only mono and stereo are supported' % (path, channels))
+
+    if width == 1:
+        samples = [(b - 128) << 8 for b in raw]
+    elif width == 2:
+        samples = list(struct.unpack('<%dh' % (len(raw) // 2), raw))
+    elif width == 3:
+        samples = [struct.unpack('<i', b'\0' + raw[i:i + 3])[0] >> 16 for i in range(0, len(raw), 3)]
+    else:
+        raise SystemExit('%s: %d-bit samples are not supported' % (path, width * 8))
+
+    if mono and channels == 2:
+        samples = [(samples[i] + samples[i + 1]) >> 1 for i in range(0, len(samples), 2)]
+        channels = 1
+
+    if not in_tune(rate):
+        print('warning: %s is %dHz, which the I2S can\'t run at in tune, it will play at %dHz'
+              % (path, rate, I2S_DEFAULT_RATE), file=sys.stderr)
+
+    name = '/' + os.path.basename(path).upper()
+    return name, channels, rate, samples
+
+
+def write(out, samples, budget):
+    total = sum(len(s[3]) * 2 for s in samples)
+    if budget and total > budget:
+        raise SystemExit('sample bank is %d bytes, over the budget of %d' % (total, budget))
+
+    out.write('/*\n')
+    out.write(' * SampleBank.cpp - Samples built into flash.\n')
+    out.write(' *\n')
+    out.write(' * Generated by tools/wav2flash.py, don\'t edit. List the WAV files in\n')
+    out.write(' * SAMPLE_BANK in the Makefile and run "make samplebank" instead.\n')
+    out.write(' */\n\n')
+    out.write('#include "FlashSampleSource.h"\n\n')
+    out.write('#define SAMPLEBANK __attribute__((section(".samplebank"), aligned(4)))\n\n')
+
+    for i, (name, channels, rate, data) in enumerate(samples):
+        out.write('// %s, %s, %d frames (%d bytes).\n' % (name, 'stereo' if channels == 2 else 'mono',
+                                                       len(data) // channels, len(data) * 2))
+        out.write('static const int16_t s_sample%d[] SAMPLEBANK =\n{\n' % i)
+        for j in range(0, len(data), 12):
+            out.write('\t' + ', '.join('%d' % v for v in data[j:j + 12]) + ',\n')
+        out.write('};\n\n')
+
+    out.write('const FlashSample g_sampleBank[] =\n{\n')
+    for i, (name, channels, rate, data) in enumerate(samples):
+        out.write('\t{ "%s", s_sample%d, %d, %d, %d },\n' % (name, i, len(data) // channels, rate, channels))
+    if not samples:
+        out.write('\t{ 0, 0, 0, 0, 0 }, // Empty, but C++ doesn\'t allow an array of none.\n')
+    out.write('};\n\n')
+    out.write('const unsigned g_sampleBankSize = %d;\n' % len(samples))
+    return total
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Build WAV files into a flash sample bank')
+    ap.add_argument('wavs', nargs='*', help='WAV files to include')
+    ap.add_argument('-o', '--output', required=True, help='C++ file to write')
+    ap.add_argument('--mono', action='store_true', help='mix stereo files down to mono')
+    ap.add_argument('--budget', type=int, default=0, help='fail if the samples need more bytes of flash than this')
+    args = ap.parse_args()
+
+    samples = [load(p, args.mono) for p in args.wavs]
+    names = [s[0] for s in samples]
+    for n in set(names):
+        if names.count(n) > 1:
+            raise SystemExit('%s is in the list more than once' % n)
+
+    with open(args.output, 'w') as out:
+        total = write(out, samples, args.budget)
+    print('%s: %d samples, %d bytes of flash' % (args.output, len(samples), total))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
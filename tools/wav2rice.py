@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+#
+# Compress WAV files without loss for streaming from the SD card.
+#
+# The output is a WAV file with format tag 0x5249 which WavSource decodes
+# with RiceDecoder (see Audio/RiceLossless.h for the format). Music usually
+# comes out at half to two thirds of the size, and a stream needs that much
+# less card bandwidth than the PCM file. Usage:
+#
+#     tools/wav2rice.py samples/LOOP001.WAV -o card/LOOP001.WAV
+#
+# The data starts on a sector boundary and each block is --block bytes
+# (512 by default), so every block is whole sectors on the card. The byte
+# rate in the header is that of the worst block, which is what the
+# StreamScheduler has to be able to deliver. A block that won't compress
+# stores its samples as they are. With its header that's a frame fewer than
+# PCM would fit in the block (127 frames of 16-bit stereo in 512 bytes), so
+# the worst is 0.8% over PCM's byte rate: 177789 bytes/s against 176400 for
+# stereo at 44.1kHz. That's well within what WavFile::startStream() allows
+# for the ring, so it won't turn the file down.
+#
+# The audio interrupt decodes a whole frame (128 samples) at a time out of
+# the stream's ring buffer, so the ring has to hold the most compressed data
+# any frame needs, which is printed out. For 16-bit stereo PCM that is 512
+# of the 1024 bytes the ring has by default. --ring warns when a file needs
+# more than the ring has.
+#
+# --check decodes the result again and makes sure it matches.
+
+import argparse
+import struct
+import sys
+
+import wav2flash
+
+FORMAT_RICE = 0x5249
+SECTOR = 512
+ESCAPE = 15
+ESCAPE_BITS = 20
+ORDER_RAW = 3
+MAX_K = 20
+HEADER_BITS = 16 + 1 + 2 * 7
+FRAME_SIZE = 128         # AudioSource::kFrameSize
+DECODER_LOOKAHEAD = 12   # Bytes RiceDecoder may hold before decoding a frame.
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def write(self, value, bits):
+        self.acc = (self.acc << bits) | (value & ((1 << bits) - 1))
+        self.n += bits
+        while self.n >= 8:
+            self.n -= 8
+            self.out.append((self.acc >> self.n) & 0xFF)
+        self.acc &= (1 << self.n) - 1
+
+    def bits(self):
+        return len(self.out) * 8 + self.n
+
+    def flush(self, size):
+        if self.n:
+            self.write(0, 8 - self.n)
+        self.out.extend(b'\0' * (size - len(self.out)))
+        return bytes(self.out)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, bits):
+        v = 0
+        for _ in range(bits):
+            byte = self.data[self.pos >> 3] if (self.pos >> 3) < len(self.data) else 0
+            v = (v << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return v
+
+
+def zigzag(e):
+    return -2 * e - 1 if e < 0 else 2 * e
+
+
+def rice_bits(u, k):
+    q = u >> k
+    return q + 1 + k if q < ESCAPE else ESCAPE + ESCAPE_BITS
+
+
+def residuals(x, order):
+    """Prediction errors of order 1 or 2, for x[order:]."""
+    if order == 0:
+        return x[:]
+    if order == 1:
+        return [x[i] - x[i - 1] for i in range(1, len(x))]
+    return [x[i] - 2 * x[i - 1] + x[i - 2] for i in range(2, len(x))]
+
+
+def best_coding(x, raw):
+    """Returns (bits, order, k) of the cheapest way to code channel x."""
+    best = (len(x) * raw, ORDER_RAW, 0)
+    for order in (0, 1, 2):
+        if len(x) <= order:
+            continue
+        u = [zigzag(e) for e in residuals(x, order)]
+        mean = sum(u) // len(u)
+        k0 = max(mean.bit_length() - 1, 0)
+        for k in range(max(k0 - 1, 0), min(k0 + 2, MAX_K) + 1):
+            bits = order * raw + sum(rice_bits(v, k) for v in u)
+            if bits < best[0]:
+                best = (bits, order, k)
+    return best
+
+
+def plan(chans):
+    """Pick the stereo mode and each channel's (order, k) for a run of frames."""
+    if len(chans) == 1:
+        return 0, [best_coding(chans[0], 16)[1:], (0, 0)]
+    left, right = chans
+    side = [l - r for l, r in zip(left, right)]
+    lr = best_coding(left, 16)
+    rr = best_coding(right, 16)
+    sr = best_coding(side, 17)
+    if sr[0] < rr[0]:
+        return 1, [lr[1:], sr[1:]]
+    return 0, [lr[1:], rr[1:]]
+
+
+def sample_bits(x, i, order, k, raw):
+    if order == ORDER_RAW or i < order:
+        return raw
+    if order == 0:
+        e = x[i]
+    elif order == 1:
+        e = x[i] - x[i - 1]
+    else:
+        e = x[i] - 2 * x[i - 1] + x[i - 2]
+    return rice_bits(zigzag(e), k)
+
+
+def fit(chans, start, side, params, avail):
+    """How many frames from start fit in avail bits coded with params.
+    Returns (coded channels, raw bits of each, frames)."""
+    total = len(chans[0])
+    coded = [chans[0][start:]]
+    raws = [16]
+    if len(chans) == 2:
+        coded.append([l - r for l, r in zip(chans[0][start:], chans[1][start:])] if side else chans[1][start:])
+        raws.append(17 if side else 16)
+
+    used = 0
+    n = 0
+    while start + n < total and n < 0xFFFF:
+        bits = sum(sample_bits(coded[c], n, params[c][0], params[c][1], raws[c]) for c in range(len(coded)))
+        if used + bits > avail:
+            break
+        used += bits
+        n += 1
+    return coded, raws, n
+
+
+def encode_block(chans, start, guess, block):
+    """Encode as many frames from start as will fit in a block. Returns
+    (block bytes, frames, bit offset of the end of each frame)."""
+    total = len(chans[0])
+    side, params = plan([c[start:start + guess] for c in chans])
+
+    # Now fit in as many frames as we can with those parameters.
+    avail = block * 8 - HEADER_BITS
+    coded, raws, n = fit(chans, start, side, params, avail)
+
+    # The plan only looks at as many frames as the last block held, so it
+    # can be well off for what really goes in this one (noise after
+    # something quiet, say) and escape most of the samples. Never hold
+    # fewer frames than storing the samples as they are would, so no block
+    # needs more of the card or the ring than PCM does, bar the header.
+    raw = min(avail // (16 * len(chans)), total - start, 0xFFFF)
+    if n < raw:
+        side, params = 0, [(ORDER_RAW, 0), (ORDER_RAW, 0)]
+        coded, raws, n = fit(chans, start, side, params, avail)
+
+    w = BitWriter()
+    w.write(n, 16)
+    w.write(side, 1)
+    for c in range(2):
+        order, k = params[c] if c < len(coded) else (0, 0)
+        w.write(order, 2)
+        w.write(k, 5)
+    ends = []
+    for i in range(n):
+        for c in range(len(coded)):
+            order, k = params[c]
+            x = coded[c]
+            if order == ORDER_RAW or i < order:
+                w.write(x[i], raws[c])
+                continue
+            if order == 0:
+                e = x[i]
+            elif order == 1:
+                e = x[i] - x[i - 1]
+            else:
+                e = x[i] - 2 * x[i - 1] + x[i - 2]
+            u = zigzag(e)
+            q = u >> k
+            if q < ESCAPE:
+                w.write((1 << (q + 1)) - 2, q + 1)
+                w.write(u, k)
+            else:
+                w.write((1 << ESCAPE) - 1, ESCAPE)
+                w.write(u, ESCAPE_BITS)
+        ends.append(w.bits())
+
+    # The last block stops at the end of its last word.
+    size = block if start + n < total else (w.bits() + 31) // 32 * 4
+    return w.flush(size), n, ends
+
+
+def encode(samples, channels, block):
+    chans = [samples[c::channels] for c in range(channels)]
+    frames = len(chans[0])
+    blocks = []
+    pos = 0
+    guess = block // channels
+    while pos < frames:
+        data, n, ends = encode_block(chans, pos, guess, block)
+        if n == 0:
+            raise SystemExit('block size %d is too small' % block)
+        blocks.append((data, n, ends))
+        pos += n
+        guess = n
+    return blocks
+
+
+def ring_needed(blocks, loop):
+    """The most bytes of data any FRAME_SIZE frames need, plus what the
+    decoder reads ahead. Round the loop too if the sample loops."""
+    ends = []
+    start = 0
+    for data, n, e in blocks:
+        ends.extend(start + (b + 7) // 8 for b in e)
+        start += len(data)
+    if loop:
+        ends.extend(start + x for x in ends[:FRAME_SIZE])
+    starts = [0] + ends
+    worst = max((ends[i + FRAME_SIZE - 1] - starts[i] for i in range(len(ends) - FRAME_SIZE + 1)), default=start)
+    return worst + DECODER_LOOKAHEAD
+
+
+def decode(data, channels, block):
+    """The same as RiceDecoder, for --check."""
+    out = []
+    for b in range(0, len(data), block):
+        r = BitReader(data[b:b + block])
+        n = r.read(16)
+        side = r.read(1) and channels == 2
+        params = [(r.read(2), r.read(5)) for _ in range(2)]
+        hist = [[0, 0], [0, 0]]
+        for i in range(n):
+            frame = []
+            for c in range(channels):
+                order, k = params[c]
+                raw = 17 if (c == 1 and side) else 16
+                h = hist[c]
+                if order == ORDER_RAW or i < order:
+                    x = r.read(raw)
+                    if x >= 1 << (raw - 1):
+                        x -= 1 << raw
+                else:
+                    q = 0
+                    while q < ESCAPE and r.read(1):
+                        q += 1
+                    u = r.read(ESCAPE_BITS) if q == ESCAPE else (q << k) | r.read(k)
+                    e = (u >> 1) ^ -(u & 1)
+                    x = e if order == 0 else h[0] + e if order == 1 else 2 * h[0] - h[1] + e
+                h[1], h[0] = h[0], x
+                frame.append(x)
+            if side:
+                frame[1] = frame[0] - frame[1]
+            out.extend(frame)
+    return out
+
+
+def write(path, blocks, channels, rate, block):
+    data = b''.join(b[0] for b in blocks)
+    # The last block is usually short so doesn't count.
+    full = blocks[:-1] if len(blocks) > 1 else blocks
+    peak = max((block * rate + b[1] - 1) // b[1] for b in full) if full else 0
+
+    fmt = struct.pack('<HHIIHH', FORMAT_RICE, channels, rate, peak, block, 16)
+    head = 12 + 8 + len(fmt) + 8 + 8  # RIFF, fmt, JUNK and data headers.
+    pad = -head % SECTOR
+    riff = 4 + 8 + len(fmt) + 8 + pad + 8 + len(data)
+
+    with open(path, 'wb') as f:
+        f.write(b'RIFF' + struct.pack('<I', riff) + b'WAVE')
+        f.write(b'fmt ' + struct.pack('<I', len(fmt)) + fmt)
+        f.write(b'JUNK' + struct.pack('<I', pad) + b'\0' * pad)
+        f.write(b'data' + struct.pack('<I', len(data)) + data)
+    return len(data), peak
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Compress a WAV file without loss for streaming')
+    ap.add_argument('wav', help='WAV file to compress')
+    ap.add_argument('-o', '--output', required=True, help='WAV file to write')
+    ap.add_argument('--block', type=int, default=SECTOR, help='block size in bytes, a multiple of 4 (default 512)')
+    ap.add_argument('--ring', type=int, default=2 * SECTOR,
+                    help='stream ring buffer bytes, STREAM_RING_SECTORS x 512 (default 1024)')
+    ap.add_argument('--loop', action='store_true', help='the sample will be looped')
+    ap.add_argument('--check', action='store_true', help='decode the result and compare')
+    args = ap.parse_args()
+
+    if args.block < 16 or args.block % 4 or args.block > 0xFFFF:
+        raise SystemExit('block size must be a multiple of 4 from 16 to 65532')
+
+    name, channels, rate, samples = wav2flash.load(args.wav, False)
+    blocks = encode(samples, channels, args.block)
+    size, peak = write(args.output, blocks, channels, rate, args.block)
+
+    pcm = len(samples) * 2
+    print('%s: %d bytes, %.1f%% of %d bytes of PCM, worst block needs %d bytes/s (PCM %d)' %
+          (args.output, size, 100.0 * size / pcm if pcm else 0, pcm, peak, rate * channels * 2))
+
+    ring = ring_needed(blocks, args.loop)
+    print('%s: needs a stream ring of %d bytes' % (args.output, ring))
+    if ring > args.ring:
+        print('warning: %s needs more than the %d byte ring, it will drop out when streamed' %
+              (args.output, args.ring), file=sys.stderr)
+
+    if args.check:
+        data = b''.join(b[0] for b in blocks)
+        if decode(data, channels, args.block) != samples:
+            raise SystemExit('%s: decoded data does not match' % args.output)
+        print('%s: checked' % args.output)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())